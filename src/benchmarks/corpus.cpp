@@ -0,0 +1,198 @@
+// system headers
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+extern "C" {
+    #include <appimage/appimage.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+}
+
+// library headers
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+
+// local headers
+#include "corpus.h"
+#include "digest.h"
+
+namespace {
+    // the same seed is used for every run, so that the corpus is the same across runs
+    std::mt19937 randomGenerator(42);
+
+    bool fail(const QString& message) {
+        std::cerr << "Failed to generate corpus: " << message.toStdString() << std::endl;
+        return false;
+    }
+
+    // appends random data until the file has the given size
+    bool padFile(const QString& path, qint64 size) {
+        QFile file(path);
+
+        if (!file.open(QIODevice::Append))
+            return fail("could not open " + path + ": " + file.errorString());
+
+        std::vector<char> buffer(1024 * 1024);
+
+        for (auto remaining = size - file.size(); remaining > 0;) {
+            for (auto& c : buffer) {
+                c = static_cast<char>(randomGenerator());
+            }
+
+            const auto chunkSize = std::min<qint64>(remaining, static_cast<qint64>(buffer.size()));
+
+            if (file.write(buffer.data(), chunkSize) != chunkSize)
+                return fail("could not write " + path + ": " + file.errorString());
+
+            remaining -= chunkSize;
+        }
+
+        return true;
+    }
+
+    bool copyAndPad(const QString& source, const QString& destination, qint64 size) {
+        if (!QFile::copy(source, destination))
+            return fail("could not copy " + source + " to " + destination);
+
+        if (!padFile(destination, size))
+            return false;
+
+        QFile(destination).setPermissions(QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+        return true;
+    }
+
+    bool writeAt(const QString& path, const QByteArray& data, off_t offset) {
+        const auto fd = open(path.toStdString().c_str(), O_WRONLY | O_CLOEXEC);
+
+        if (fd < 0)
+            return fail("could not open " + path + ": " + strerror(errno));
+
+        const auto rv = pwrite(fd, data.constData(), static_cast<size_t>(data.size()), offset);
+        close(fd);
+
+        if (rv != data.size())
+            return fail("could not write " + path);
+
+        return true;
+    }
+
+    // fills the .digest_md5 section with the correct digest, or null bytes, so the digest has to be calculated
+    bool setEmbeddedDigest(const QString& path, bool embed) {
+        unsigned long offset = 0, length = 0;
+
+        if (!appimage_get_elf_section_offset_and_length(path.toStdString().c_str(), ".digest_md5", &offset, &length) ||
+            offset == 0 || length < 16) {
+            // the AppImage doesn't have the section, hence there's no digest embedded anyway
+            if (!embed)
+                return true;
+
+            return fail("template doesn't have a .digest_md5 section");
+        }
+
+        QByteArray digest(16, '\0');
+
+        // the calculation ignores the section's contents
+        if (embed && !calculateAppImageDigestMd5(path, digest))
+            return fail("could not calculate digest of " + path);
+
+        return writeAt(path, digest, static_cast<off_t>(offset));
+    }
+
+    // without a template, the benchmark binary itself is used: it's a valid ELF binary, and bytes 8 to 10 of the
+    // ELF header are padding, so the AppImage magic bytes can be put there
+    bool generateFakeType2AppImage(const QString& path, qint64 size) {
+        if (!copyAndPad("/proc/self/exe", path, size))
+            return false;
+
+        return writeAt(path, QByteArray("AI\x02", 3), 8);
+    }
+
+    bool generateDesktopFiles(int count) {
+        const QDir applicationsDir(QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/applications");
+
+        if (!QDir().mkpath(applicationsDir.path()))
+            return fail("could not create " + applicationsDir.path());
+
+        for (int i = 0; i < count; ++i) {
+            QFile file(applicationsDir.filePath(QString("benchmark-app-%1.desktop").arg(i)));
+
+            if (!file.open(QIODevice::WriteOnly))
+                return fail("could not write " + file.fileName());
+
+            // names are shared by several files, so there are collisions to be found
+            file.write(QString(
+                "[Desktop Entry]\n"
+                "Type=Application\n"
+                "Name=Benchmark App %1\n"
+                "Exec=/bin/true\n"
+                "Icon=benchmark-app\n"
+            ).arg(i % 50).toUtf8());
+        }
+
+        return true;
+    }
+}
+
+bool generateCorpus(const CorpusOptions& options, const QString& directory, Corpus& corpus) {
+    corpus = Corpus{};
+    corpus.directory = directory;
+    corpus.integratable = !options.type2Template.isEmpty();
+
+    if (!QDir().mkpath(directory))
+        return fail("could not create " + directory);
+
+    const QDir dir(directory);
+
+    for (int i = 0; i < options.count; ++i) {
+        if (!options.type1Template.isEmpty()) {
+            const auto path = dir.filePath(QString("type1-%1.AppImage").arg(i));
+
+            if (!copyAndPad(options.type1Template, path, options.size))
+                return false;
+
+            corpus.type1AppImages << path;
+        }
+
+        if (corpus.integratable) {
+            const auto withDigest = dir.filePath(QString("type2-digest-%1.AppImage").arg(i));
+
+            // the digest must be calculated after padding, as the padding is part of the file
+            if (!copyAndPad(options.type2Template, withDigest, options.size) || !setEmbeddedDigest(withDigest, true))
+                return false;
+
+            corpus.type2AppImagesWithDigest << withDigest;
+        }
+
+        const auto withoutDigest = dir.filePath(QString("type2-%1.AppImage").arg(i));
+
+        if (corpus.integratable) {
+            if (!copyAndPad(options.type2Template, withoutDigest, options.size) || !setEmbeddedDigest(withoutDigest, false))
+                return false;
+        } else if (!generateFakeType2AppImage(withoutDigest, options.size)) {
+            return false;
+        }
+
+        corpus.type2AppImagesWithoutDigest << withoutDigest;
+
+        // files ending up in the applications directories which are no AppImages, e.g., disk images and downloads
+        // which are still in progress
+        const auto randomFile = dir.filePath(QString("random-%1.iso").arg(i));
+
+        if (!padFile(randomFile, options.size))
+            return false;
+
+        corpus.otherFiles << randomFile;
+
+        const auto download = dir.filePath(QString("download-%1.AppImage.part").arg(i));
+
+        if (!copyAndPad(withoutDigest, download, options.size))
+            return false;
+
+        corpus.otherFiles << download;
+    }
+
+    return generateDesktopFiles(options.desktopFiles);
+}
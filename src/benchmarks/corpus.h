@@ -0,0 +1,47 @@
+#pragma once
+
+// library headers
+#include <QString>
+#include <QStringList>
+
+// parameters of the synthetic corpus the benchmarks run on
+struct CorpusOptions {
+    // number of AppImages per kind
+    int count = 50;
+
+    // size of every generated AppImage, the files are padded with random data (AppImages don't mind trailing data)
+    qint64 size = 16 * 1024 * 1024;
+
+    // number of unrelated desktop files in the applications directory, used to benchmark collision lookups
+    int desktopFiles = 500;
+
+    // real AppImages the generated ones are copied from
+    // without a type 2 template, ELF files with the AppImage magic bytes are generated, which can be searched and
+    // hashed, but not integrated
+    QString type1Template;
+    QString type2Template;
+};
+
+struct Corpus {
+    // directory containing all the generated files
+    QString directory;
+
+    QStringList type1AppImages;
+    // type 2 AppImages with a valid .digest_md5 section, requires a type 2 template
+    QStringList type2AppImagesWithDigest;
+    // type 2 AppImages whose digest has to be calculated
+    QStringList type2AppImagesWithoutDigest;
+    // files which must be rejected (random data, incomplete downloads, ...)
+    QStringList otherFiles;
+
+    // whether the AppImages are real ones, i.e., can be integrated and launched
+    bool integratable = false;
+
+    QStringList appImages() const {
+        return type1AppImages + type2AppImagesWithDigest + type2AppImagesWithoutDigest;
+    }
+};
+
+// generates the corpus in the given directory, and populates the user's applications directory with desktop files
+// returns false on errors, which are printed to stderr
+bool generateCorpus(const CorpusOptions& options, const QString& directory, Corpus& corpus);
@@ -0,0 +1,329 @@
+// system headers
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <vector>
+extern "C" {
+    #include <fcntl.h>
+    #include <spawn.h>
+    #include <sys/wait.h>
+    #include <unistd.h>
+}
+
+// library headers
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+// local headers
+#include "corpus.h"
+#include "initialsearch.h"
+#include "metadataindex.h"
+#include "shared.h"
+#include "worker.h"
+
+/*
+ * Benchmarks for the integration pipeline.
+ *
+ * A synthetic corpus is generated in a temporary home directory, so the user's actual desktop integration is never
+ * touched. The results are printed as JSON, so they can be tracked across releases.
+ */
+
+extern char** environ;
+
+namespace {
+    QJsonObject summarize(std::vector<double> samplesMs) {
+        if (samplesMs.empty())
+            return QJsonObject{{"skipped", "no samples"}};
+
+        std::sort(samplesMs.begin(), samplesMs.end());
+
+        const auto total = std::accumulate(samplesMs.begin(), samplesMs.end(), 0.0);
+
+        return QJsonObject{
+            {"samples", static_cast<int>(samplesMs.size())},
+            {"min_ms", samplesMs.front()},
+            {"median_ms", samplesMs[samplesMs.size() / 2]},
+            {"mean_ms", total / static_cast<double>(samplesMs.size())},
+            {"max_ms", samplesMs.back()},
+            {"total_ms", total},
+        };
+    }
+
+    double measureOnce(const std::function<void()>& function) {
+        QElapsedTimer timer;
+        timer.start();
+
+        function();
+
+        return static_cast<double>(timer.nsecsElapsed()) / 1e6;
+    }
+
+    std::vector<double> measure(int iterations, const std::function<void()>& function) {
+        std::vector<double> samples;
+
+        for (int i = 0; i < iterations; ++i) {
+            samples.push_back(measureOnce(function));
+        }
+
+        return samples;
+    }
+
+    std::vector<double> measureForEach(const QStringList& paths, const std::function<void(const QString&)>& function) {
+        std::vector<double> samples;
+
+        for (const auto& path : paths) {
+            samples.push_back(measureOnce([&function, &path]() { function(path); }));
+        }
+
+        return samples;
+    }
+
+    QJsonObject skipped(const QString& reason) {
+        return QJsonObject{{"skipped", reason}};
+    }
+
+    // runs the command with stdout and stderr redirected to /dev/null, returns the exit code (or -1 on errors)
+    int runSilently(const std::vector<std::string>& args) {
+        std::vector<char*> argv;
+
+        for (const auto& arg : args) {
+            argv.push_back(const_cast<char*>(arg.c_str()));
+        }
+
+        argv.push_back(nullptr);
+
+        posix_spawn_file_actions_t fileActions;
+        posix_spawn_file_actions_init(&fileActions);
+        posix_spawn_file_actions_addopen(&fileActions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        posix_spawn_file_actions_addopen(&fileActions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+        pid_t pid;
+        const auto rv = posix_spawn(&pid, argv[0], &fileActions, nullptr, argv.data(), environ);
+
+        posix_spawn_file_actions_destroy(&fileActions);
+
+        if (rv != 0)
+            return -1;
+
+        int status = 0;
+
+        while (waitpid(pid, &status, 0) < 0) {
+            if (errno != EINTR)
+                return -1;
+        }
+
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    // make sure shared won't try to use the UI
+    setenv("_FORCE_HEADLESS", "1", 1);
+
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationVersion(APPIMAGELAUNCHER_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QObject::tr(
+        "Benchmarks AppImageLauncher's integration pipeline on a synthetic corpus, and prints the results as JSON"
+    ));
+    parser.addHelpOption();
+
+    QCommandLineOption countOption("count", QObject::tr("Number of AppImages per kind"), "n", "20");
+    QCommandLineOption sizeOption("size-mib", QObject::tr("Size of every generated file in MiB"), "size", "4");
+    QCommandLineOption desktopFilesOption(
+        "desktop-files", QObject::tr("Number of unrelated desktop files in the applications directory"), "n", "500"
+    );
+    QCommandLineOption iterationsOption("iterations", QObject::tr("Repetitions of the benchmarks"), "n", "5");
+    QCommandLineOption type1TemplateOption(
+        "type1-template", QObject::tr("Type 1 AppImage used to generate type 1 AppImages"), "path"
+    );
+    QCommandLineOption type2TemplateOption(
+        "type2-template", QObject::tr("Type 2 AppImage used to generate type 2 AppImages, required to benchmark "
+                                      "the integration and binfmt-bypass"), "path"
+    );
+    QCommandLineOption binfmtBypassOption("binfmt-bypass", QObject::tr("Path to the binfmt-bypass binary"), "path",
+#ifdef BINFMT_BYPASS_PATH
+        BINFMT_BYPASS_PATH
+#else
+        ""
+#endif
+    );
+    QCommandLineOption outputOption("output", QObject::tr("Write results to file instead of stdout"), "path");
+
+    parser.addOptions({countOption, sizeOption, desktopFilesOption, iterationsOption, type1TemplateOption,
+                       type2TemplateOption, binfmtBypassOption, outputOption});
+
+    parser.process(app);
+
+    CorpusOptions corpusOptions;
+    corpusOptions.count = std::max(1, parser.value(countOption).toInt());
+    corpusOptions.size = std::max(1, parser.value(sizeOption).toInt()) * 1024ll * 1024ll;
+    corpusOptions.desktopFiles = std::max(0, parser.value(desktopFilesOption).toInt());
+    corpusOptions.type1Template = parser.value(type1TemplateOption);
+    corpusOptions.type2Template = parser.value(type2TemplateOption);
+
+    const auto iterations = std::max(1, parser.value(iterationsOption).toInt());
+    const auto binfmtBypassPath = parser.value(binfmtBypassOption);
+
+    // everything happens in a temporary home directory, the user's desktop integration must not be touched
+    QTemporaryDir workspace;
+
+    if (!workspace.isValid()) {
+        std::cerr << "Failed to create temporary directory" << std::endl;
+        return 1;
+    }
+
+    const auto home = workspace.path() + "/home";
+    QDir().mkpath(home);
+
+    setenv("HOME", home.toStdString().c_str(), 1);
+    setenv("XDG_DATA_HOME", (home + "/.local/share").toStdString().c_str(), 1);
+    setenv("XDG_CONFIG_HOME", (home + "/.config").toStdString().c_str(), 1);
+    setenv("XDG_CACHE_HOME", (home + "/.cache").toStdString().c_str(), 1);
+
+    std::cerr << "Generating corpus in " << workspace.path().toStdString() << std::endl;
+
+    Corpus corpus;
+
+    if (!generateCorpus(corpusOptions, home + "/Applications", corpus))
+        return 1;
+
+    // the functions benchmarked print lots of messages, which would end up in the results
+    std::ofstream devNull("/dev/null");
+    auto* const stdoutBuffer = std::cout.rdbuf(devNull.rdbuf());
+
+    AppImageMetadataIndex::instance()->setAutoSave(false);
+
+    QJsonObject results;
+
+    std::cerr << "Benchmarking initial search" << std::endl;
+    {
+        Worker worker;
+        const QDirSet dirs{QDir(corpus.directory)};
+
+        // in the first run, every file has to be inspected, later runs can use the metadata index
+        results["initial_search_cold"] = summarize({measureOnce([&]() { initialSearchForAppImages(dirs, worker); })});
+        results["initial_search_warm"] = summarize(measure(iterations, [&]() {
+            initialSearchForAppImages(dirs, worker);
+        }));
+    }
+
+    std::cerr << "Benchmarking digest calculation" << std::endl;
+    {
+        auto digest = [](const QString& path) { getAppImageDigestMd5(path); };
+
+        if (corpus.type2AppImagesWithDigest.empty()) {
+            results["digest_md5_embedded"] = skipped("requires --type2-template");
+        } else {
+            results["digest_md5_embedded"] = summarize(measureForEach(corpus.type2AppImagesWithDigest, digest));
+        }
+
+        results["digest_md5_calculated"] = summarize(measureForEach(corpus.type2AppImagesWithoutDigest, digest));
+        results["digest_md5_cached"] = summarize(measureForEach(corpus.type2AppImagesWithoutDigest, digest));
+    }
+
+    std::cerr << "Benchmarking collision lookups" << std::endl;
+    {
+        QStringList names;
+
+        for (int i = 0; i < 50; ++i) {
+            names << QString("Benchmark App %1").arg(i);
+        }
+
+        auto lookup = [](const QString& name) { findCollisions(name); };
+
+        // the first lookup builds the index of the desktop files
+        results["find_collisions_cold"] = summarize({measureOnce([&]() { lookup(names.front()); })});
+        results["find_collisions_warm"] = summarize(measureForEach(names, lookup));
+    }
+
+    if (!corpus.integratable) {
+        results["install_desktop_file_and_icons"] = skipped("requires --type2-template");
+        results["clean_up_old_desktop_integration_resources"] = skipped("requires --type2-template");
+    } else {
+        std::cerr << "Benchmarking integration" << std::endl;
+
+        const auto appImages = corpus.appImages();
+
+        results["install_desktop_file_and_icons"] = summarize(measureForEach(appImages, [](const QString& path) {
+            installDesktopFileAndIcons(path);
+        }));
+
+        std::cerr << "Benchmarking cleanup" << std::endl;
+
+        // half of the AppImages disappear, their desktop integration must be removed
+        for (int i = 0; i < appImages.size(); i += 2) {
+            QFile::remove(appImages[i]);
+        }
+
+        results["clean_up_old_desktop_integration_resources"] = summarize({measureOnce([]() {
+            cleanUpOldDesktopIntegrationResources();
+        })});
+        results["clean_up_old_desktop_integration_resources_noop"] = summarize(measure(iterations, []() {
+            cleanUpOldDesktopIntegrationResources();
+        }));
+    }
+
+    if (!corpus.integratable || binfmtBypassPath.isEmpty()) {
+        results["binfmt_bypass_launch"] = skipped("requires --type2-template and --binfmt-bypass");
+    } else {
+        std::cerr << "Benchmarking binfmt-bypass" << std::endl;
+
+        // the runtime exits right after handling --appimage-version, so this measures how long it takes to get there,
+        // which is dominated by binfmt-bypass' setup
+        const std::vector<std::string> args{
+            binfmtBypassPath.toStdString(),
+            corpus.type2AppImagesWithoutDigest.back().toStdString(),
+            "--appimage-version",
+        };
+
+        bool failed = false;
+
+        const auto samples = measure(iterations, [&args, &failed]() {
+            failed = runSilently(args) != 0 || failed;
+        });
+
+        results["binfmt_bypass_launch"] = failed ? skipped("binfmt-bypass failed") : summarize(samples);
+    }
+
+    std::cout.rdbuf(stdoutBuffer);
+
+    const QJsonObject report{
+        {"version", QCoreApplication::applicationVersion()},
+        {"corpus", QJsonObject{
+            {"count", corpusOptions.count},
+            {"size_bytes", corpusOptions.size},
+            {"desktop_files", corpusOptions.desktopFiles},
+            {"type1", !corpus.type1AppImages.empty()},
+            {"integratable", corpus.integratable},
+        }},
+        {"iterations", iterations},
+        {"results", results},
+    };
+
+    const auto json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if (parser.isSet(outputOption)) {
+        QFile outputFile(parser.value(outputOption));
+
+        if (!outputFile.open(QIODevice::WriteOnly) || outputFile.write(json) != json.size()) {
+            std::cerr << "Failed to write results to " << outputFile.fileName().toStdString() << std::endl;
+            return 1;
+        }
+    } else {
+        std::cout << json.toStdString();
+    }
+
+    return 0;
+}
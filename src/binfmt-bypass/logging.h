@@ -40,8 +40,19 @@ static int log_message(const char* const format, ...) {
     return result;
 }
 
+// debug messages are compiled away in release builds, as they're used in the preload library's hot paths
+#ifdef NDEBUG
+#define log_debug(...) do {} while (0)
+#else
 static void log_debug(const char* const format, ...) {
-    if (getenv("DEBUG") == NULL) {
+    // looking up the environment every time is quite expensive
+    static int debug_enabled = -1;
+
+    if (debug_enabled < 0) {
+        debug_enabled = getenv("DEBUG") != NULL;
+    }
+
+    if (!debug_enabled) {
         return;
     }
 
@@ -52,6 +63,7 @@ static void log_debug(const char* const format, ...) {
 
     va_end(args);
 }
+#endif
 
 static void log_error(const char* const format, ...) {
     va_list args;
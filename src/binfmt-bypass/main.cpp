@@ -1,7 +1,10 @@
 // system headers
+#include <algorithm>
+#include <cerrno>
 #include <cstdio>
 #include <iostream>
 #include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <wait.h>
@@ -10,28 +13,150 @@
 #include <libgen.h>
 
 // own headers
-#include "elf.h"
+#include "elfsize.h"
 #include "logging.h"
+#include "runtime_cache.h"
 
 #define EXIT_CODE_FAILURE 0xff
 
+// copies data using the kernel's in-kernel copy mechanisms, so it doesn't need to pass through user space
+// works on the range [*copied, count) of in_fd, and writes to out_fd's current position, updating *copied
+// returns false if the kernel refuses the copy, in which case the caller should continue with another method
+// errors other than "not supported" are reported through errno with *copied < count
+bool copy_in_kernel(int in_fd, int out_fd, off_t count, off_t* copied) {
+    auto is_unsupported = [](int error) {
+        return error == ENOSYS || error == EXDEV || error == EINVAL || error == EOPNOTSUPP;
+    };
+
+#ifdef HAVE_COPY_FILE_RANGE
+    while (*copied < count) {
+        loff_t in_offset = *copied;
+        const auto rv = copy_file_range(in_fd, &in_offset, out_fd, nullptr, count - *copied, 0);
+
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (is_unsupported(errno)) {
+                log_debug("copy_file_range not supported (%s), trying sendfile\n", strerror(errno));
+                break;
+            }
+
+            return true;
+        }
+
+        // unexpected end of file
+        if (rv == 0) {
+            errno = EIO;
+            return true;
+        }
+
+        *copied += rv;
+    }
+
+    if (*copied >= count)
+        return true;
+#endif
+
+    while (*copied < count) {
+        off_t in_offset = *copied;
+        const auto rv = sendfile(out_fd, in_fd, &in_offset, count - *copied);
+
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+
+            if (is_unsupported(errno)) {
+                log_debug("sendfile not supported (%s), falling back to buffered copy\n", strerror(errno));
+                return false;
+            }
+
+            return true;
+        }
+
+        if (rv == 0) {
+            errno = EIO;
+            return true;
+        }
+
+        *copied += rv;
+    }
+
+    return true;
+}
+
+// classic copy through a user space buffer
+// works like copy_in_kernel, but never refuses the copy
+void copy_with_buffer(int in_fd, int out_fd, off_t count, off_t* copied) {
+    std::vector<char> buffer(64 * 1024);
+
+    while (*copied < count) {
+        const auto to_read = std::min(static_cast<off_t>(buffer.size()), count - *copied);
+        const auto bytes_read = pread(in_fd, buffer.data(), to_read, *copied);
+
+        if (bytes_read < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return;
+        }
+
+        if (bytes_read == 0) {
+            errno = EIO;
+            return;
+        }
+
+        // write() may write fewer bytes than requested, too
+        for (ssize_t written = 0; written < bytes_read;) {
+            const auto rv = write(out_fd, buffer.data() + written, bytes_read - written);
+
+            if (rv < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                return;
+            }
+
+            written += rv;
+        }
+
+        *copied += bytes_read;
+    }
+}
+
 bool copy_and_patch_runtime(int fd, const char* const appimage_filename, const ssize_t elf_size) {
     // copy runtime header into memfd "file"
     {
-        const auto realfd = open(appimage_filename, O_RDONLY);
-        std::vector<char> buffer(elf_size);
-        // TODO: check for errors
-        read(realfd, buffer.data(), elf_size);
-        write(fd, buffer.data(), elf_size);
+        const auto realfd = open(appimage_filename, O_RDONLY | O_CLOEXEC);
+
+        if (realfd < 0) {
+            log_error("failed to open AppImage: %s\n", strerror(errno));
+            return false;
+        }
+
+        off_t copied = 0;
+
+        if (!copy_in_kernel(realfd, fd, elf_size, &copied)) {
+            copy_with_buffer(realfd, fd, elf_size, &copied);
+        }
+
+        const auto error = errno;
         close(realfd);
+
+        if (copied < elf_size) {
+            log_error("failed to copy runtime: %s\n", strerror(error));
+            return false;
+        }
     }
 
     // erase magic bytes
-    lseek(fd, 8, SEEK_SET);
-    char null_buf[]{0, 0, 0};
-    write(fd, null_buf, 3);
+    static const char null_buf[]{0, 0, 0};
+
+    if (pwrite(fd, null_buf, sizeof(null_buf), 8) != sizeof(null_buf)) {
+        log_error("failed to patch out magic bytes: %s\n", strerror(errno));
+        return false;
+    }
 
-    // TODO: handle errors properly
     return true;
 }
 
@@ -41,8 +166,8 @@ bool copy_and_patch_runtime(int fd, const char* const appimage_filename, const s
 // shm_open or classic tempfiles
 
 int create_memfd_with_patched_runtime(const char* const appimage_filename, const ssize_t elf_size) {
-    // as we call exec() after fork() to create a child process (the parent keeps it alive, the child doesn't require
-    // access anyway), we enable close-on-exec
+    // once the kernel has loaded the runtime, the mapping keeps the memfd alive, so the fd itself is not needed after
+    // exec(); therefore, we enable close-on-exec, which also prevents the fd from leaking into the runtime
     const auto memfd = memfd_create("runtime", MFD_CLOEXEC);
 
     if (memfd < 0) {
@@ -76,8 +201,8 @@ int create_shm_fd_with_patched_runtime(const char* const appimage_filename, cons
         return -1;
     }
 
-    // shm_open doesn't survive over exec(), so we _have to_ keep this process alive and create a child for the runtime
-    // the good news is: we don't have to worry about setting flags to close-on-exec
+    // shm_open sets close-on-exec on the fd, which is fine, as the kernel keeps the file alive while it's mapped into
+    // the runtime process (see main())
     int writable_fd = shm_open(runtime_filename, O_RDWR | O_CREAT, 0700);
 
     if (writable_fd < 0) {
@@ -135,76 +260,116 @@ char* find_preload_library() {
     return result;
 }
 
-int main(int argc, char** argv) {
-    if (argc <= 1) {
-        log_message("Usage: %s <AppImage file> [...]\n", argv[0]);
+// replaces the current process with the patched runtime
+// returns only if the exec failed
+int exec_patched_runtime(int runtime_fd, const char* const appimage_filename, int argc, char** argv) {
+    // create new argv array, using passed filename as argv[0]
+    std::vector<char*> new_argv;
+
+    new_argv.push_back(strdup(appimage_filename));
+
+    // insert remaining args, if any
+    for (int i = 2; i < argc; ++i) {
+        new_argv.push_back(argv[i]);
+    }
+
+    // needs to be null terminated, of course
+    new_argv.push_back(nullptr);
+
+    // preload our library
+    char* preload_lib_path = find_preload_library();
+
+    if (preload_lib_path == nullptr) {
+        log_error("could not find preload library path");
         return EXIT_CODE_FAILURE;
     }
 
-    const auto* appimage_filename = argv[1];
-    log_debug("AppImage filename: %s\n", appimage_filename);
+    setenv("LD_PRELOAD", preload_lib_path, true);
 
-    // read size of AppImage runtime (i.e., detect size of ELF binary)
-    const auto size = elf_binary_size(appimage_filename);
+    // calculate absolute path to AppImage, for use in the preloaded lib
+    char* abs_appimage_path = realpath(appimage_filename, nullptr);
 
-    if (size < 0) {
-        std::cerr << "failed to detect runtime size" << std::endl;
+    if (abs_appimage_path == nullptr) {
+        log_error("could not resolve absolute AppImage path: %s\n", strerror(errno));
         return EXIT_CODE_FAILURE;
     }
 
+    log_debug("absolute AppImage path: %s\n", abs_appimage_path);
+    setenv("REDIRECT_APPIMAGE", abs_appimage_path, true);
+
+    // launch memfd directly, no path needed
+    log_debug("fexecve(...)\n");
+    fexecve(runtime_fd, new_argv.data(), environ);
+
+    log_error("failed to execute patched runtime: %s\n", strerror(errno));
+    return EXIT_CODE_FAILURE;
+}
+
+// creates an in-memory file containing the patched runtime
+int create_fd_with_patched_runtime(const char* const appimage_filename, const ssize_t elf_size) {
 #ifdef HAVE_MEMFD_CREATE
     // create "file" in memory, copy runtime there and patch out magic bytes
-    int runtime_fd = create_memfd_with_patched_runtime(appimage_filename, size);
+    return create_memfd_with_patched_runtime(appimage_filename, elf_size);
 #else
-    int runtime_fd = create_shm_fd_with_patched_runtime(appimage_filename, size);
+    return create_shm_fd_with_patched_runtime(appimage_filename, elf_size);
 #endif
+}
 
-    if (runtime_fd < 0) {
-        log_error("failed to set up in-memory file with patched runtime\n");
-        return EXIT_CODE_FAILURE;
-    }
-
-    // to keep alive the memfd, we launch the AppImage as a subprocess
-    if (fork() == 0) {
-        // create new argv array, using passed filename as argv[0]
-        std::vector<char*> new_argv;
+// like exec_patched_runtime, but if a cached runtime can't be executed (e.g., exec is refused with EACCES or EPERM by
+// a security module), the runtime is patched in memory and executed from there
+int exec_patched_runtime_with_fallback(int runtime_fd, bool cached, const char* const appimage_filename,
+                                       int argc, char** argv) {
+    const auto rv = exec_patched_runtime(runtime_fd, appimage_filename, argc, argv);
 
-        new_argv.push_back(strdup(appimage_filename));
+    if (!cached)
+        return rv;
 
-        // insert remaining args, if any
-        for (int i = 2; i < argc; ++i) {
-            new_argv.push_back(argv[i]);
-        }
+    log_warning("could not execute cached runtime, falling back to in-memory copy\n");
+    close(runtime_fd);
 
-        // needs to be null terminated, of course
-        new_argv.push_back(nullptr);
+    // on cache hits, the runtime size has not been calculated
+    const auto elf_size = elf_binary_size(appimage_filename);
 
-        // preload our library
-        char* preload_lib_path = find_preload_library();
+    if (elf_size < 0) {
+        log_error("failed to detect runtime size: %s\n", strerror(errno));
+        return EXIT_CODE_FAILURE;
+    }
 
-        if (preload_lib_path == nullptr) {
-            log_error("could not find preload library path");
-            return EXIT_CODE_FAILURE;
-        }
+    const auto memory_fd = create_fd_with_patched_runtime(appimage_filename, elf_size);
 
-        setenv("LD_PRELOAD", preload_lib_path, true);
+    if (memory_fd < 0) {
+        log_error("failed to set up in-memory file with patched runtime\n");
+        return EXIT_CODE_FAILURE;
+    }
 
-        // calculate absolute path to AppImage, for use in the preloaded lib
-        char* abs_appimage_path = realpath(appimage_filename, nullptr);
-        log_debug("absolute AppImage path: %s\n", abs_appimage_path);
-        setenv("REDIRECT_APPIMAGE", abs_appimage_path, true);
+    return exec_patched_runtime(memory_fd, appimage_filename, argc, argv);
+}
 
-        // launch memfd directly, no path needed
-        log_debug("fexecve(...)\n");
-        fexecve(runtime_fd, new_argv.data(), environ);
+// launches the runtime in a child process, and keeps the fd alive until it exits
+// this used to be the only launch mode, it's kept as a fallback for environments where the runtime cannot be
+// executed directly
+int launch_in_child_process(int runtime_fd, bool cached, const char* const appimage_filename, int argc, char** argv) {
+    const auto pid = fork();
 
-        log_error("failed to execute patched runtime: %s\n", strerror(errno));
+    if (pid < 0) {
+        log_error("fork failed: %s\n", strerror(errno));
         return EXIT_CODE_FAILURE;
     }
 
+    if (pid == 0) {
+        // in case the exec fails, the child must not return into the parent's code
+        _exit(exec_patched_runtime_with_fallback(runtime_fd, cached, appimage_filename, argc, argv));
+    }
+
     // wait for child process to exit, and exit with its return code
     int status;
-    wait(&status);
+
+    while (waitpid(pid, &status, 0) < 0) {
+        if (errno != EINTR) {
+            log_error("waitpid failed: %s\n", strerror(errno));
+            return EXIT_CODE_FAILURE;
+        }
+    }
 
     // clean up
     close(runtime_fd);
@@ -216,7 +381,7 @@ int main(int argc, char** argv) {
         child_retcode = WTERMSIG(status);
         log_error("child exited with code %d\n", child_retcode);
     } else if (WIFEXITED(status) != 0) {
-        child_retcode = status;
+        child_retcode = WEXITSTATUS(status);
         log_debug("child exited normally with code %d\n", child_retcode);
     } else {
         log_error("unknown error: child didn't exit with signal or regular exit code\n");
@@ -225,3 +390,56 @@ int main(int argc, char** argv) {
 
     return child_retcode;
 }
+
+// the runtime is executed in place of this process unless the forking launch mode is requested
+bool fork_requested() {
+    const char* value = getenv("APPIMAGELAUNCHER_BINFMT_BYPASS_FORK");
+    return value != nullptr && value[0] != '\0' && strcmp(value, "0") != 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc <= 1) {
+        log_message("Usage: %s <AppImage file> [...]\n", argv[0]);
+        return EXIT_CODE_FAILURE;
+    }
+
+    const auto* appimage_filename = argv[1];
+    log_debug("AppImage filename: %s\n", appimage_filename);
+
+    // most AppImages have been launched before, so chances are we have patched their runtime already
+    int runtime_fd = open_cached_patched_runtime(appimage_filename);
+    auto cached = runtime_fd >= 0;
+
+    if (!cached) {
+        // read size of AppImage runtime (i.e., detect size of ELF binary)
+        const auto size = elf_binary_size(appimage_filename);
+
+        if (size < 0) {
+            log_error("failed to detect runtime size: %s\n", strerror(errno));
+            return EXIT_CODE_FAILURE;
+        }
+
+        // most AppImages share a runtime with other AppImages, so the cache might contain it under a different name
+        runtime_fd = add_patched_runtime_to_cache(appimage_filename, size);
+        cached = runtime_fd >= 0;
+
+        if (!cached) {
+            runtime_fd = create_fd_with_patched_runtime(appimage_filename, size);
+        }
+    }
+
+    if (runtime_fd < 0) {
+        log_error("failed to set up in-memory file with patched runtime\n");
+        return EXIT_CODE_FAILURE;
+    }
+
+    // the kernel keeps the file alive as long as it is mapped into the new process image, so there is no need for a
+    // parent process to hold on to the fd, and we can exec() the runtime directly
+    // this saves a process per running AppImage, and signals and the exit code reach the runtime directly
+    if (fork_requested()) {
+        log_debug("launching runtime in child process\n");
+        return launch_in_child_process(runtime_fd, cached, appimage_filename, argc, argv);
+    }
+
+    return exec_patched_runtime_with_fallback(runtime_fd, cached, appimage_filename, argc, argv);
+}
@@ -1,4 +1,8 @@
+// the fortified variants of open() & co. are defined as inline functions, which would collide with our hooks
+#undef _FORTIFY_SOURCE
+
 // system headers
+#include <stdarg.h>
 #include <stdio.h>
 #include <dlfcn.h>
 #include <unistd.h>
@@ -7,6 +11,7 @@
 #include <fcntl.h>
 #include <limits.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 
 // own headers
@@ -23,68 +28,108 @@
 #define EXIT_CODE_FAILURE 0xff
 
 // pointers to actual implementations in libc
-// will be initialized by __init()
+// will be initialized by __do_init()
 // TODO: create a macro for this pattern (DRY)
 static char* (*__libc_realpath)(const char*, char*) = NULL;
-static int (*__libc_open)(const char*, int) = NULL;
 static ssize_t (*__libc_readlink)(const char*, void*, size_t) = NULL;
 
-// TODO: write __init() and call that from all functions, loading all required symbols, the AppImage path etc. once
-// to improve performance
+// the open family
+// the *64 and fortified (__*_2) variants are glibc specific, therefore they're optional
+// if they're not available, the hooks fall back to the respective standard function
+static int (*__libc_open)(const char*, int, ...) = NULL;
+static int (*__libc_open64)(const char*, int, ...) = NULL;
+static int (*__libc_openat)(int, const char*, int, ...) = NULL;
+static int (*__libc_openat64)(int, const char*, int, ...) = NULL;
+static int (*__libc___open_2)(const char*, int) = NULL;
+static int (*__libc___open64_2)(const char*, int) = NULL;
+static int (*__libc___openat_2)(int, const char*, int) = NULL;
+static int (*__libc___openat64_2)(int, const char*, int) = NULL;
 
 // DRY
 static const char proc_self_exe[] = "/proc/self/exe";
 
+// absolute path to the AppImage, resolved once by __do_init()
+// empty if $REDIRECT_APPIMAGE is not set, which is reported once the path is actually needed
+static char abs_appimage_path[PATH_MAX];
+static size_t abs_appimage_path_len = 0;
 
-void __init() {
-    static bool initialized = false;
+static void __resolve_abs_appimage_path() {
+    static const char env_var_name[] = "REDIRECT_APPIMAGE";
 
-    if (!initialized) {
-        initialized = true;
+    const char* appimage_var = getenv(env_var_name);
 
-        // get rid of $LD_PRELOAD in the first binary which this library is preloaded into (should be the runtime)
-        // the easiest way is to wait for one of these functions to be used, then unset it
-        unsetenv("LD_PRELOAD");
+    if (appimage_var == NULL || appimage_var[0] == '\0') {
+        return;
+    }
 
-        // load symbols from libc
-        __libc_readlink = (ssize_t (*) (const char*, void*, size_t)) dlsym(REAL_LIBC, "readlink");
-        __libc_realpath = (char* (*) (const char*, char*)) dlsym(REAL_LIBC, "realpath");
-        __libc_open = (int (*) (const char*, int)) dlsym(REAL_LIBC, "open");
+    // make path absolute if needed (best effort, it's better to pass an absolute value)
+    if (appimage_var[0] != '/') {
+        log_warning("$%s value is not absolute, trying to make it absolute\n", env_var_name);
 
-        if (__libc_readlink == NULL || __libc_realpath == NULL || __libc_open == NULL) {
-            log_error("failed to load symbol from libc\n");
-            exit(EXIT_CODE_FAILURE);
+        if (__libc_realpath(appimage_var, abs_appimage_path) == NULL) {
+            log_error("realpath failed on %s: %s\n", appimage_var, strerror(errno));
+            abs_appimage_path[0] = '\0';
+            return;
+        }
+    } else {
+        if (strlen(appimage_var) >= sizeof(abs_appimage_path)) {
+            log_error("$%s value is too long\n", env_var_name);
+            return;
         }
+
+        strcpy(abs_appimage_path, appimage_var);
     }
-}
 
-char* __abs_appimage_path() {
-    __init();
+    abs_appimage_path_len = strlen(abs_appimage_path);
+}
 
-    static const char env_var_name[] = "REDIRECT_APPIMAGE";
+static void __do_init() {
+    // get rid of $LD_PRELOAD in the first binary which this library is preloaded into (should be the runtime)
+    unsetenv("LD_PRELOAD");
 
-    char* appimage_var = getenv(env_var_name);
+    // load symbols from libc
+    __libc_readlink = (ssize_t (*) (const char*, void*, size_t)) dlsym(REAL_LIBC, "readlink");
+    __libc_realpath = (char* (*) (const char*, char*)) dlsym(REAL_LIBC, "realpath");
+    __libc_open = (int (*) (const char*, int, ...)) dlsym(REAL_LIBC, "open");
+    __libc_openat = (int (*) (int, const char*, int, ...)) dlsym(REAL_LIBC, "openat");
 
-    if (appimage_var == NULL || appimage_var[0] == '\0') {
-        log_error("$%s not set\n", env_var_name);
+    if (__libc_readlink == NULL || __libc_realpath == NULL || __libc_open == NULL || __libc_openat == NULL) {
+        log_error("failed to load symbol from libc\n");
         exit(EXIT_CODE_FAILURE);
     }
 
-    // make path absolute if needed (best effort, it's better to pass an absolute value)
-    if (appimage_var[0] != '/') {
-        log_warning("$%s value is not absolute, trying to make it absolute\n", env_var_name);
+    __libc_open64 = (int (*) (const char*, int, ...)) dlsym(REAL_LIBC, "open64");
+    __libc_openat64 = (int (*) (int, const char*, int, ...)) dlsym(REAL_LIBC, "openat64");
+    __libc___open_2 = (int (*) (const char*, int)) dlsym(REAL_LIBC, "__open_2");
+    __libc___open64_2 = (int (*) (const char*, int)) dlsym(REAL_LIBC, "__open64_2");
+    __libc___openat_2 = (int (*) (int, const char*, int)) dlsym(REAL_LIBC, "__openat_2");
+    __libc___openat64_2 = (int (*) (int, const char*, int)) dlsym(REAL_LIBC, "__openat64_2");
 
-        char* abspath = calloc(PATH_MAX, sizeof(char));
+    __resolve_abs_appimage_path();
+}
 
-        if (readlink(appimage_var, abspath, sizeof(abspath)) == -1) {
-            log_error("readlink failed on %s: %s\n", appimage_var, strerror(errno));
-            exit(EXIT_CODE_FAILURE);
-        }
+// runs when the library is loaded, i.e., before the program's main()
+// the hooks call this function, too, in case they are used by other libraries' constructors (or other threads) before
+// ours has run
+// pthread_once() makes sure no hook can use the pointers above before they have been initialized
+__attribute__((constructor))
+static void __init() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, __do_init);
+}
 
-        return abspath;
+// like the original implementation, we redirect all paths starting with /proc/self/exe
+static inline bool __is_proc_self_exe(const char* path) {
+    return path != NULL && strncmp(path, proc_self_exe, sizeof(proc_self_exe) - 1) == 0;
+}
+
+static const char* __abs_appimage_path() {
+    if (abs_appimage_path_len == 0) {
+        log_error("$REDIRECT_APPIMAGE not set\n");
+        exit(EXIT_CODE_FAILURE);
     }
 
-    return strdup(appimage_var);
+    return abs_appimage_path;
 }
 
 __attribute__((visibility ("default")))
@@ -93,18 +138,16 @@ extern ssize_t readlink(const char* path, char* buf, size_t len) {
 
     log_debug("readlink %s, len %ld\n", path, len);
 
-    if (strncmp(path, proc_self_exe, strlen(proc_self_exe)) == 0) {
-        char* abspath = __abs_appimage_path();
+    if (__is_proc_self_exe(path)) {
+        const char* abspath = __abs_appimage_path();
 
         log_debug("redirecting readlink to %s\n", abspath);
 
-        size_t ret = strlen(abspath);
-
-        strncpy(buf, abspath, ret);
+        // like readlink(), we truncate the result silently and don't append a null byte
+        size_t ret = abs_appimage_path_len < len ? abs_appimage_path_len : len;
 
-        log_debug("buf: %s, len: %ld\n", buf, ret);
+        memcpy(buf, abspath, ret);
 
-        free(abspath);
         return ret;
     }
 
@@ -117,18 +160,19 @@ extern char* realpath(const char* name, char* resolved) {
 
     log_debug("realpath %s, %s\n", name, resolved);
 
-    if (strncmp(name, proc_self_exe, strlen(proc_self_exe)) == 0) {
-        char* appimage = __abs_appimage_path();
+    if (__is_proc_self_exe(name)) {
+        const char* appimage = __abs_appimage_path();
 
         log_debug("changing realpath destination to %s\n", appimage);
 
+        // the caller is responsible for freeing the buffer in this case
         if (resolved == NULL) {
-            resolved = appimage;
-        } else {
-            strncpy(resolved, appimage, PATH_MAX);
-            free(appimage);
+            return strdup(appimage);
         }
 
+        // the buffer must be at least PATH_MAX bytes large, and we made sure our path fits into such a buffer
+        memcpy(resolved, appimage, abs_appimage_path_len + 1);
+
         return resolved;
     }
 
@@ -139,26 +183,141 @@ extern char* realpath(const char* name, char* resolved) {
     return retval;
 }
 
+// the mode argument is only passed (and may only be read) if the flags require it, see open(2)
+#ifdef O_TMPFILE
+#define __NEEDS_MODE(flags) (((flags) & O_CREAT) != 0 || ((flags) & O_TMPFILE) == O_TMPFILE)
+#else
+#define __NEEDS_MODE(flags) (((flags) & O_CREAT) != 0)
+#endif
+
+// declares and initializes a variable "mode", using the variadic arguments after last_arg
+// mode_t is promoted to int when passed through variadic arguments
+#define __READ_MODE(flags, last_arg) \
+    int mode = 0; \
+    if (__NEEDS_MODE(flags)) { \
+        va_list args; \
+        va_start(args, last_arg); \
+        mode = va_arg(args, int); \
+        va_end(args); \
+    }
+
+// returns the path to open instead of the given one
+// absolute paths don't depend on the directory fd, so openat() & co. can use this function, too
+static inline const char* __redirect_path(const char* function, const char* file) {
+    if (__is_proc_self_exe(file)) {
+        const char* abspath = __abs_appimage_path();
+        log_debug("redirecting %s to %s\n", function, abspath);
+        return abspath;
+    }
+
+    return file;
+}
+
 // used by squashfuse, specifically util.c/sqfs_fd_open
 __attribute__((visibility ("default")))
 extern int open(const char* file, int flags, ...) {
     __init();
+    __READ_MODE(flags, flags);
 
     log_debug("open(%s, %d)\n", file, flags);
 
-    char* abspath = NULL;
+    return __libc_open(__redirect_path("open", file), flags, mode);
+}
 
-    if (strncmp(file, proc_self_exe, strlen(proc_self_exe)) == 0) {
-        abspath = __abs_appimage_path();
-        log_debug("redirecting open to %s\n", abspath);
-        file = abspath;
-    }
+__attribute__((visibility ("default")))
+extern int open64(const char* file, int flags, ...) {
+    __init();
+    __READ_MODE(flags, flags);
 
-    int result = __libc_open(file, flags);
+    log_debug("open64(%s, %d)\n", file, flags);
 
-    if (abspath != NULL) {
-        free(abspath);
-    }
+    file = __redirect_path("open64", file);
+
+    if (__libc_open64 == NULL)
+        return __libc_open(file, flags, mode);
+
+    return __libc_open64(file, flags, mode);
+}
+
+__attribute__((visibility ("default")))
+extern int openat(int dirfd, const char* file, int flags, ...) {
+    __init();
+    __READ_MODE(flags, flags);
+
+    log_debug("openat(%d, %s, %d)\n", dirfd, file, flags);
+
+    return __libc_openat(dirfd, __redirect_path("openat", file), flags, mode);
+}
+
+__attribute__((visibility ("default")))
+extern int openat64(int dirfd, const char* file, int flags, ...) {
+    __init();
+    __READ_MODE(flags, flags);
+
+    log_debug("openat64(%d, %s, %d)\n", dirfd, file, flags);
+
+    file = __redirect_path("openat64", file);
+
+    if (__libc_openat64 == NULL)
+        return __libc_openat(dirfd, file, flags, mode);
+
+    return __libc_openat64(dirfd, file, flags, mode);
+}
+
+// glibc calls the following functions instead of open() & co. when building with _FORTIFY_SOURCE
+// they abort if O_CREAT or O_TMPFILE are passed, as those require a mode argument, so there's no mode to handle here
+__attribute__((visibility ("default")))
+extern int __open_2(const char* file, int flags) {
+    __init();
+
+    log_debug("__open_2(%s, %d)\n", file, flags);
+
+    file = __redirect_path("__open_2", file);
+
+    if (__libc___open_2 == NULL)
+        return __libc_open(file, flags);
+
+    return __libc___open_2(file, flags);
+}
+
+__attribute__((visibility ("default")))
+extern int __open64_2(const char* file, int flags) {
+    __init();
+
+    log_debug("__open64_2(%s, %d)\n", file, flags);
+
+    file = __redirect_path("__open64_2", file);
+
+    if (__libc___open64_2 == NULL)
+        return __libc_open(file, flags);
+
+    return __libc___open64_2(file, flags);
+}
+
+__attribute__((visibility ("default")))
+extern int __openat_2(int dirfd, const char* file, int flags) {
+    __init();
+
+    log_debug("__openat_2(%d, %s, %d)\n", dirfd, file, flags);
+
+    file = __redirect_path("__openat_2", file);
+
+    if (__libc___openat_2 == NULL)
+        return __libc_openat(dirfd, file, flags);
+
+    return __libc___openat_2(dirfd, file, flags);
+}
+
+__attribute__((visibility ("default")))
+extern int __openat64_2(int dirfd, const char* file, int flags) {
+    __init();
+
+    log_debug("__openat64_2(%d, %s, %d)\n", dirfd, file, flags);
+
+    file = __redirect_path("__openat64_2", file);
+
+    if (__libc___openat64_2 == NULL)
+        return __libc_openat(dirfd, file, flags);
 
-    return result;
+    return __libc___openat64_2(dirfd, file, flags);
 }
@@ -0,0 +1,340 @@
+// system headers
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+
+// own headers
+#include "runtime_cache.h"
+#include "logging.h"
+
+// the runtime's magic bytes are located at offset 8, and we have to replace them with null bytes
+static constexpr off_t MAGIC_BYTES_OFFSET = 8;
+static constexpr off_t MAGIC_BYTES_SIZE = 3;
+
+// read-only mapping of a file's first bytes, unmapped automatically
+class mapped_file {
+private:
+    void* data_;
+    size_t size_;
+
+public:
+    mapped_file(int fd, size_t size) : size_(size) {
+        data_ = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+
+    ~mapped_file() {
+        if (data_ != MAP_FAILED)
+            munmap(data_, size_);
+    }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+
+    bool valid() const {
+        return data_ != MAP_FAILED;
+    }
+
+    const char* data() const {
+        return static_cast<const char*>(data_);
+    }
+};
+
+// 64-bit FNV-1a, which is more than good enough to tell a handful of runtimes apart
+// collisions are harmless anyway, as the contents are compared before a cache entry is used
+static uint64_t fnv1a_hash(const char* data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 0x100000001b3ULL;
+    }
+
+    return hash;
+}
+
+static bool cache_enabled() {
+    return getenv("APPIMAGELAUNCHER_DISABLE_RUNTIME_CACHE") == nullptr;
+}
+
+static std::string cache_dir_path() {
+    const char* xdg_cache_home = getenv("XDG_CACHE_HOME");
+
+    if (xdg_cache_home != nullptr && xdg_cache_home[0] == '/')
+        return std::string(xdg_cache_home) + "/appimagelauncher/runtimes";
+
+    const char* home = getenv("HOME");
+
+    if (home == nullptr || home[0] != '/')
+        return "";
+
+    return std::string(home) + "/.cache/appimagelauncher/runtimes";
+}
+
+// makes sure nobody else can modify the directory, otherwise, other users could replace the runtimes we're about to
+// execute
+static bool is_private_directory(const std::string& path) {
+    struct stat st{};
+
+    if (lstat(path.c_str(), &st) != 0)
+        return false;
+
+    if (!S_ISDIR(st.st_mode) || st.st_uid != getuid() || (st.st_mode & 022) != 0) {
+        log_warning("runtime cache directory %s is not private, not using it\n", path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// creates the directory (including its parents) if necessary
+static bool ensure_private_directory(const std::string& path) {
+    for (size_t pos = path.find('/', 1); ; pos = path.find('/', pos + 1)) {
+        const auto component = path.substr(0, pos);
+
+        if (mkdir(component.c_str(), 0700) != 0 && errno != EEXIST) {
+            log_debug("could not create runtime cache directory %s: %s\n", component.c_str(), strerror(errno));
+            return false;
+        }
+
+        if (pos == std::string::npos)
+            break;
+    }
+
+    return is_private_directory(path);
+}
+
+// the entry of an AppImage is invalidated by replacing or modifying the AppImage
+static std::string appimage_entry_name(const struct stat& st) {
+    char name[128];
+    snprintf(name, sizeof(name), "appimage-%llx-%llx-%lld-%lld.%09ld",
+             static_cast<unsigned long long>(st.st_dev), static_cast<unsigned long long>(st.st_ino),
+             static_cast<long long>(st.st_size), static_cast<long long>(st.st_mtim.tv_sec), st.st_mtim.tv_nsec);
+    return name;
+}
+
+static bool same_file_version(const struct stat& a, const struct stat& b) {
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+           a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec;
+}
+
+// checks whether the cache entry contains the patched version of the given runtime
+static bool cache_entry_matches(int fd, const char* runtime, ssize_t elf_size) {
+    struct stat st{};
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size != elf_size)
+        return false;
+
+    mapped_file cached(fd, elf_size);
+
+    if (!cached.valid())
+        return false;
+
+    static const char null_buf[MAGIC_BYTES_SIZE]{};
+
+    const auto patched_end = MAGIC_BYTES_OFFSET + MAGIC_BYTES_SIZE;
+
+    return memcmp(cached.data(), runtime, MAGIC_BYTES_OFFSET) == 0 &&
+           memcmp(cached.data() + MAGIC_BYTES_OFFSET, null_buf, MAGIC_BYTES_SIZE) == 0 &&
+           memcmp(cached.data() + patched_end, runtime + patched_end, elf_size - patched_end) == 0;
+}
+
+static int open_cache_entry(const std::string& path, const char* runtime, ssize_t elf_size) {
+    const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+
+    if (!cache_entry_matches(fd, runtime, elf_size)) {
+        log_debug("cache entry %s does not match runtime\n", path.c_str());
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static bool write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        const auto rv = write(fd, data, size);
+
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return false;
+        }
+
+        data += rv;
+        size -= rv;
+    }
+
+    return true;
+}
+
+// writes the patched runtime into a temporary file and renames it into place
+// if another process does the same at the same time, one of the (identical) files wins
+static bool populate_cache_entry(const std::string& path, const char* runtime, ssize_t elf_size) {
+    std::string temp_path = path + ".XXXXXX";
+
+    const auto fd = mkostemp(&temp_path[0], O_CLOEXEC);
+
+    if (fd < 0) {
+        log_debug("could not create temporary runtime cache file: %s\n", strerror(errno));
+        return false;
+    }
+
+    static const char null_buf[MAGIC_BYTES_SIZE]{};
+
+    const auto patched_end = MAGIC_BYTES_OFFSET + MAGIC_BYTES_SIZE;
+
+    const auto success = write_all(fd, runtime, MAGIC_BYTES_OFFSET) &&
+                         write_all(fd, null_buf, MAGIC_BYTES_SIZE) &&
+                         write_all(fd, runtime + patched_end, elf_size - patched_end) &&
+                         fchmod(fd, 0700) == 0;
+
+    // the file must not be open for writing anymore when it's executed, otherwise fexecve() fails with ETXTBSY
+    if (close(fd) != 0 || !success || rename(temp_path.c_str(), path.c_str()) != 0) {
+        log_debug("could not populate runtime cache entry: %s\n", strerror(errno));
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+// hard links the AppImage's entry to the runtime entry, replacing existing entries atomically
+static bool link_appimage_entry(const std::string& runtime_entry_path, const std::string& appimage_entry_path) {
+    const auto temp_path = appimage_entry_path + "." + std::to_string(getpid());
+
+    // might be left over from a crashed process
+    unlink(temp_path.c_str());
+
+    if (link(runtime_entry_path.c_str(), temp_path.c_str()) != 0 ||
+        rename(temp_path.c_str(), appimage_entry_path.c_str()) != 0) {
+        log_debug("could not link AppImage to runtime cache entry: %s\n", strerror(errno));
+        unlink(temp_path.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+int open_cached_patched_runtime(const char* appimage_filename) {
+    if (!cache_enabled())
+        return -1;
+
+    const auto cache_dir = cache_dir_path();
+
+    if (cache_dir.empty() || !is_private_directory(cache_dir))
+        return -1;
+
+    struct stat appimage_st{};
+
+    if (stat(appimage_filename, &appimage_st) != 0)
+        return -1;
+
+    const auto entry_path = cache_dir + "/" + appimage_entry_name(appimage_st);
+
+    const auto fd = open(entry_path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+
+    if (fd < 0)
+        return -1;
+
+    // the directory is private, but the entry's permissions might have been changed anyway
+    struct stat entry_st{};
+
+    if (fstat(fd, &entry_st) != 0 || !S_ISREG(entry_st.st_mode) || entry_st.st_uid != getuid() ||
+        (entry_st.st_mode & 022) != 0) {
+        log_warning("runtime cache entry %s is not private, not using it\n", entry_path.c_str());
+        close(fd);
+        return -1;
+    }
+
+    log_debug("using runtime cache entry: %s\n", entry_path.c_str());
+    return fd;
+}
+
+int add_patched_runtime_to_cache(const char* appimage_filename, ssize_t elf_size) {
+    if (!cache_enabled())
+        return -1;
+
+    if (elf_size <= MAGIC_BYTES_OFFSET + MAGIC_BYTES_SIZE)
+        return -1;
+
+    const auto cache_dir = cache_dir_path();
+
+    if (cache_dir.empty() || !ensure_private_directory(cache_dir))
+        return -1;
+
+    // the cached runtimes couldn't be executed anyway
+    {
+        struct statvfs st{};
+
+        if (statvfs(cache_dir.c_str(), &st) == 0 && (st.f_flag & ST_NOEXEC) != 0) {
+            log_debug("runtime cache directory %s is on a noexec mount, not using it\n", cache_dir.c_str());
+            return -1;
+        }
+    }
+
+    const auto appimage_fd = open(appimage_filename, O_RDONLY | O_CLOEXEC);
+
+    if (appimage_fd < 0)
+        return -1;
+
+    struct stat appimage_st{};
+
+    if (fstat(appimage_fd, &appimage_st) != 0) {
+        close(appimage_fd);
+        return -1;
+    }
+
+    // the mapping remains valid after closing the fd
+    mapped_file runtime(appimage_fd, elf_size);
+
+    if (!runtime.valid()) {
+        log_debug("could not map runtime: %s\n", strerror(errno));
+        close(appimage_fd);
+        return -1;
+    }
+
+    char entry_name[64];
+    snprintf(entry_name, sizeof(entry_name), "runtime-%016llx-%lld",
+             static_cast<unsigned long long>(fnv1a_hash(runtime.data(), elf_size)), static_cast<long long>(elf_size));
+
+    const auto entry_path = cache_dir + "/" + entry_name;
+    log_debug("runtime cache entry: %s\n", entry_path.c_str());
+
+    auto fd = open_cache_entry(entry_path, runtime.data(), elf_size);
+
+    if (fd < 0) {
+        if (!populate_cache_entry(entry_path, runtime.data(), elf_size)) {
+            close(appimage_fd);
+            return -1;
+        }
+
+        fd = open_cache_entry(entry_path, runtime.data(), elf_size);
+
+        if (fd < 0) {
+            close(appimage_fd);
+            return -1;
+        }
+    }
+
+    // if the AppImage has been modified while we were reading the runtime, the entry might not match its stat data
+    struct stat current_st{};
+
+    if (fstat(appimage_fd, &current_st) == 0 && same_file_version(appimage_st, current_st)) {
+        link_appimage_entry(entry_path, cache_dir + "/" + appimage_entry_name(appimage_st));
+    }
+
+    close(appimage_fd);
+
+    return fd;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+// system headers
+#include <sys/types.h>
+
+/**
+ * Look up the patched runtime of the given AppImage in the user's runtime cache.
+ *
+ * Entries are looked up by the AppImage's device, inode, size and modification time, so a cache hit costs a stat() and
+ * an open() only: neither the AppImage nor the runtime are read, and the ELF size doesn't need to be calculated.
+ *
+ * Entries are not used if the cache directory or the entry could have been modified by other users.
+ *
+ * @param appimage_filename path to AppImage
+ * @return read-only file descriptor of the patched runtime, suitable for fexecve(), or -1 if there is no entry
+ */
+int open_cached_patched_runtime(const char* appimage_filename);
+
+/**
+ * Add the patched runtime of the given AppImage to the user's runtime cache.
+ *
+ * Most AppImages share one of a few runtime builds, so the patched runtimes are stored once per runtime, named after a
+ * hash of the original runtime and its size. Their contents are compared to the AppImage's runtime before they are
+ * used. The AppImage's entry (see above) is a hard link to the matching runtime.
+ *
+ * Entries are written to temporary files which are renamed into place atomically, so concurrent launches of
+ * AppImages with the same runtime are safe.
+ *
+ * The cache is not used if its directory is on a noexec mount. If executing an entry fails anyway, the caller
+ * should fall back to an in-memory copy.
+ *
+ * The cache can be disabled by setting $APPIMAGELAUNCHER_DISABLE_RUNTIME_CACHE.
+ *
+ * @param appimage_filename path to AppImage
+ * @param elf_size size of the AppImage's runtime
+ * @return read-only file descriptor of the patched runtime, suitable for fexecve(), or -1 if the cache can't be used
+ */
+int add_patched_runtime_to_cache(const char* appimage_filename, ssize_t elf_size);
@@ -32,6 +32,9 @@ int main(int argc, char** argv) {
     parser.addHelpOption();
     parser.addVersionOption();
 
+    // everything after the command name belongs to the command, which parses its options on its own
+    parser.setOptionsAfterPositionalArgumentsMode(QCommandLineParser::ParseAsPositionalArguments);
+
     parser.process(app);
 
     auto posArgs = parser.positionalArguments();
@@ -41,7 +44,15 @@ int main(int argc, char** argv) {
 
         qerr() << "Available commands:" << endl;
         qerr() << "  integrate    Integrate AppImages passed as commandline arguments" << endl;
+        qerr() << "               (use --jobs <n> to integrate <n> AppImages at a time)" << endl;
         qerr() << "  unintegrate  Unintegrate AppImages passed as commandline arguments" << endl;
+        qerr() << "  list         List integrated AppImages (--json for machine-readable output, --verify to check" << endl;
+        qerr() << "               AppImages which have changed since they've been indexed)" << endl;
+#ifdef ENABLE_UPDATE_HELPER
+        qerr() << "  update       Update AppImages passed as commandline arguments, or all integrated AppImages" << endl;
+        qerr() << "               (--jobs <n> to update <n> AppImages at a time, --check-only to only check for" << endl;
+        qerr() << "               updates, --remove-old to remove the old AppImages once they've been updated)" << endl;
+#endif
 
         return 2;
     }
@@ -61,6 +72,9 @@ int main(int argc, char** argv) {
     } catch (const UsageError& e) {
         qerr() << "Usage error: " << e.what() << endl;
         return 3;
+    } catch (const CliError& e) {
+        qerr() << "Error: " << e.what() << endl;
+        return 1;
     }
 
     return 0;
@@ -1,7 +1,11 @@
 // local headers
 #include "CommandFactory.h"
 #include "IntegrateCommand.h"
+#include "ListCommand.h"
 #include "UnintegrateCommand.h"
+#ifdef ENABLE_UPDATE_HELPER
+#include "UpdateCommand.h"
+#endif
 #include "exceptions.h"
 
 
@@ -13,6 +17,12 @@ namespace appimagelauncher {
                     return std::shared_ptr<Command>(new IntegrateCommand);
                 } else if (commandName == "unintegrate") {
                     return std::make_shared<UnintegrateCommand>();
+                } else if (commandName == "list") {
+                    return std::make_shared<ListCommand>();
+#ifdef ENABLE_UPDATE_HELPER
+                } else if (commandName == "update") {
+                    return std::make_shared<UpdateCommand>();
+#endif
                 }
 
                 throw CommandNotFoundError(commandName);
@@ -1,82 +1,292 @@
+// system headers
+#include <algorithm>
+#include <vector>
+
 // library headers
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
 
 // local headers
 #include "IntegrateCommand.h"
+#include "arguments.h"
+#include "desktopintegrationbatch.h"
 #include "exceptions.h"
+#include "metadataindex.h"
 #include "shared.h"
 #include "logging.h"
 
 namespace appimagelauncher {
     namespace cli {
         namespace commands {
-            void IntegrateCommand::exec(QList<QString> arguments) {
-                if (arguments.empty()) {
-                    throw InvalidArgumentsError("No AppImages passed on commandline");
-                }
+            namespace {
+                enum IntegrationStatus {
+                    INTEGRATED = 0,
+                    SKIPPED,
+                    FAILED,
+                };
 
-                // make sure all AppImages exist on disk before further processing
-                for (auto& path : arguments) {
-                    if (!QFileInfo(path).exists()) {
-                        throw UsageError("could not find file " + path);
+                struct IntegrationResult {
+                    QString pathToAppImage;
+                    IntegrationStatus status = FAILED;
+                    qint64 elapsedMs = 0;
+
+                    // output is collected per AppImage and printed at once, so that the messages of concurrently
+                    // processed AppImages don't get mixed up
+                    QStringList messages;
+                    QStringList errors;
+                };
+
+                // destinations in the integration directory which are being written to by the current batch
+                // AppImages which would end up at the same location must not be processed concurrently, the first one
+                // to claim a destination wins
+                class DestinationClaims {
+                private:
+                    QMutex mutex;
+                    QSet<QString> claimed;
+
+                public:
+                    // returns false if the destination has been claimed already
+                    bool claim(const QString& destination) {
+                        QMutexLocker lock(&mutex);
+
+                        if (claimed.contains(destination))
+                            return false;
+
+                        claimed.insert(destination);
+                        return true;
                     }
+                };
 
-                    // make path absolute
-                    // that will just prevent mistakes in libappimage and shared etc.
-                    // (stuff like TryExec keys etc. being set to paths relative to CWD when running the command , ...)
-                    path = QFileInfo(path).absoluteFilePath();
-                }
+                // validates, moves and registers a single AppImage
+                // safe to be called from multiple threads at the same time for different AppImages
+                void integrateAppImage(IntegrationResult& result, DestinationClaims& destinationClaims) {
+                    const auto& pathToAppImage = result.pathToAppImage;
 
-                for (const auto& pathToAppImage : arguments) {
-                    qout() << "Processing " << pathToAppImage << endl;
+                    result.messages << "Processing " + pathToAppImage;
 
                     if (!QFileInfo(pathToAppImage).isFile()) {
-                        qerr() << "Warning: Not a file, skipping: " << pathToAppImage << endl;
-                        continue;
+                        result.errors << "Warning: Not a file, skipping: " + pathToAppImage;
+                        result.status = SKIPPED;
+                        return;
                     }
 
                     if (!isAppImage(pathToAppImage)) {
-                        qerr() << "Warning: Not an AppImage, skipping: " << pathToAppImage << endl;
-                        continue;
+                        result.errors << "Warning: Not an AppImage, skipping: " + pathToAppImage;
+                        result.status = SKIPPED;
+                        return;
                     }
 
                     if (hasAlreadyBeenIntegrated(pathToAppImage)) {
                         if (desktopFileHasBeenUpdatedSinceLastUpdate(pathToAppImage)) {
-                            qout() << "AppImage has been integrated already and doesn't need to be re-integrated, skipping" << endl;
-                            continue;
+                            result.messages << "AppImage has been integrated already and doesn't need to be re-integrated, skipping";
+                            result.status = SKIPPED;
+                            return;
                         }
 
-                        qout() << "AppImage has already been integrated, but needs to be reintegrated" << endl;
+                        result.messages << "AppImage has already been integrated, but needs to be reintegrated";
                     }
 
                     auto pathToIntegratedAppImage = buildPathToIntegratedAppImage(pathToAppImage);
 
-                    // make sure integration directory exists
-                    // (important for new installations)
-                    // pretty ugly, but well, one taketh what the Qt API giveth
-                    QDir().mkdir(integratedAppImagesDestination().path());
+                    if (!destinationClaims.claim(QFileInfo(pathToIntegratedAppImage).absoluteFilePath())) {
+                        result.errors << "Warning: another AppImage passed on the commandline is integrated as "
+                                         + pathToIntegratedAppImage + " already, skipping: " + pathToAppImage;
+                        result.status = SKIPPED;
+                        return;
+                    }
 
                     // check if it's already in the right place
                     if (QFileInfo(pathToAppImage).absoluteFilePath() != QFileInfo(pathToIntegratedAppImage).absoluteFilePath()) {
-                        qout() << "Moving AppImage to integration directory" << endl;
+                        result.messages << "Moving AppImage to integration directory";
 
                         if (QFile::exists(pathToIntegratedAppImage) && !QFile(pathToIntegratedAppImage).remove()) {
-                            qerr() << "Could not move AppImage into integration directory (error: failed to overwrite existing file)" << endl;
-                            continue;
+                            result.errors << "Could not move AppImage into integration directory (error: failed to overwrite existing file)";
+                            return;
                         }
 
                         if (!QFile(pathToAppImage).rename(pathToIntegratedAppImage)) {
-                            qerr() << "Cannot move AppImage to integration directory (permission problem?), attempting to copy instead" << endl;
+                            result.errors << "Cannot move AppImage to integration directory (permission problem?), attempting to copy instead";
 
-                            if (!QFile(pathToAppImage).copy(pathToIntegratedAppImage)) {
-                                throw CliError("Failed to copy AppImage, giving up");
+                            if (!copyAppImage(pathToAppImage, pathToIntegratedAppImage)) {
+                                result.errors << "Failed to copy AppImage, giving up";
+                                return;
                             }
                         }
                     } else {
-                        qout() << "AppImage already in integration directory" << endl;
+                        result.messages << "AppImage already in integration directory";
+                    }
+
+                    if (!installDesktopFileAndIcons(pathToIntegratedAppImage)) {
+                        result.errors << "Failed to register AppImage in system";
+                        return;
+                    }
+
+                    result.status = INTEGRATED;
+                }
+
+                class IntegrationTask : public QRunnable {
+                private:
+                    IntegrationResult& result;
+                    DestinationClaims& destinationClaims;
+                    QMutex& outputMutex;
+
+                public:
+                    IntegrationTask(IntegrationResult& result, DestinationClaims& destinationClaims, QMutex& outputMutex) :
+                        result(result), destinationClaims(destinationClaims), outputMutex(outputMutex) {}
+
+                    void run() override {
+                        QElapsedTimer timer;
+                        timer.start();
+
+                        integrateAppImage(result, destinationClaims);
+
+                        result.elapsedMs = timer.elapsed();
+
+                        QMutexLocker lock(&outputMutex);
+
+                        for (const auto& message : result.messages) {
+                            qout() << message << endl;
+                        }
+
+                        for (const auto& error : result.errors) {
+                            qerr() << error << endl;
+                        }
+                    }
+                };
+            }
+
+            void IntegrateCommand::exec(QList<QString> arguments) {
+                const auto jobs = extractJobsCount(arguments);
+
+                if (arguments.empty()) {
+                    throw InvalidArgumentsError("No AppImages passed on commandline");
+                }
+
+                // make sure all AppImages exist on disk before further processing
+                for (auto& path : arguments) {
+                    if (!QFileInfo(path).exists()) {
+                        throw UsageError("could not find file " + path);
+                    }
+
+                    // make path absolute
+                    // that will just prevent mistakes in libappimage and shared etc.
+                    // (stuff like TryExec keys etc. being set to paths relative to CWD when running the command , ...)
+                    path = QFileInfo(path).absoluteFilePath();
+                }
+
+                // the same AppImage might be passed more than once, e.g., through symlinks
+                // the destinations are resolved by the tasks, calculating the digests here would serialize all the work
+                std::vector<IntegrationResult> results;
+
+                {
+                    QSet<QString> canonicalPaths;
+
+                    for (const auto& pathToAppImage : arguments) {
+                        const auto canonicalPath = QFileInfo(pathToAppImage).canonicalFilePath();
+
+                        if (canonicalPaths.contains(canonicalPath)) {
+                            qerr() << "Warning: " << pathToAppImage << " has been passed more than once, skipping" << endl;
+                            continue;
+                        }
+
+                        canonicalPaths.insert(canonicalPath);
+
+                        IntegrationResult result;
+                        result.pathToAppImage = pathToAppImage;
+                        results.push_back(result);
+                    }
+                }
+
+                // make sure integration directory exists
+                // (important for new installations)
+                // pretty ugly, but well, one taketh what the Qt API giveth
+                QDir().mkdir(integratedAppImagesDestination().path());
+
+                // the index is written once after the batch rather than after every single AppImage
+                const auto index = AppImageMetadataIndex::instance();
+                index->setAutoSave(false);
+
+                // the written files are synced, and the desktop environment is notified, once for the entire batch
+                // the batch also keeps track of the modified trees, so only their caches need to be updated
+                DesktopIntegrationBatch integrationBatch;
+
+                QElapsedTimer totalTimer;
+                totalTimer.start();
+
+                {
+                    QMutex outputMutex;
+                    DestinationClaims destinationClaims;
+
+                    QThreadPool threadPool;
+                    threadPool.setMaxThreadCount(std::min(jobs, static_cast<int>(results.size())));
+
+                    for (auto& result : results) {
+                        threadPool.start(new IntegrationTask(result, destinationClaims, outputMutex));
+                    }
+
+                    threadPool.waitForDone();
+                }
+
+                if (!index->save()) {
+                    qerr() << "Warning: failed to save AppImage metadata index" << endl;
+                }
+
+                index->setAutoSave(true);
+
+                const auto integratedCount = std::count_if(results.begin(), results.end(), [](const IntegrationResult& result) {
+                    return result.status == INTEGRATED;
+                });
+
+                const auto failedCount = std::count_if(results.begin(), results.end(), [](const IntegrationResult& result) {
+                    return result.status == FAILED;
+                });
+
+                if (integratedCount > 0) {
+                    qout() << "Cleaning up old desktop integration files" << endl;
+                    if (!cleanUpOldDesktopIntegrationResources()) {
+                        qerr() << "Warning: failed to clean up old desktop integration files" << endl;
+                    }
+
+                    const auto changedTrees = integrationBatch.changedTrees();
+
+                    if (changedTrees != 0) {
+                        qout() << "Updating desktop database and icon caches" << endl;
+                        if (!updateDesktopDatabaseAndIconCaches(changedTrees)) {
+                            qerr() << "Warning: failed to update desktop database and icon caches" << endl;
+                        }
+                    }
+                }
+
+                if (!integrationBatch.commit()) {
+                    qerr() << "Warning: failed to sync desktop integration files to disk" << endl;
+                }
+
+                // summary, including the time spent on every single AppImage
+                if (results.size() > 1) {
+                    static const char* const statusNames[] = {"integrated", "skipped", "failed"};
+
+                    qout() << endl << "Summary:" << endl;
+
+                    for (const auto& result : results) {
+                        qout() << "  " << QString(statusNames[result.status]).leftJustified(10) << " "
+                               << QString("%1 ms").arg(result.elapsedMs).rightJustified(9) << "  "
+                               << result.pathToAppImage << endl;
                     }
 
-                    installDesktopFileAndIcons(pathToIntegratedAppImage);
+                    qout() << integratedCount << " integrated, "
+                           << (static_cast<long>(results.size()) - integratedCount - failedCount) << " skipped, "
+                           << failedCount << " failed in " << totalTimer.elapsed() << " ms "
+                           << "(" << jobs << (jobs == 1 ? " job" : " jobs") << ")" << endl;
+                }
+
+                if (failedCount > 0) {
+                    throw CliError(QString("Failed to integrate %1 AppImage(s)").arg(failedCount));
                 }
             }
         }
@@ -0,0 +1,170 @@
+// system headers
+#include <algorithm>
+#include <vector>
+
+// library headers
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <appimage/appimage.h>
+
+// local headers
+#include "ListCommand.h"
+#include "exceptions.h"
+#include "metadataindex.h"
+#include "shared.h"
+#include "logging.h"
+
+namespace appimagelauncher {
+    namespace cli {
+        namespace commands {
+            namespace {
+                enum EntryState {
+                    // the file matches the index entry
+                    CURRENT = 0,
+                    // the file has been modified since the entry has been recorded, the values might be outdated
+                    MODIFIED,
+                    // the file doesn't exist any more
+                    MISSING,
+                };
+
+                const char* const entryStateNames[] = {"current", "modified", "missing"};
+
+                struct ListEntry {
+                    AppImageMetadata metadata;
+                    EntryState state = CURRENT;
+                    bool verified = false;
+                    bool desktopFileUpToDate = false;
+                };
+
+                // checks a modified AppImage again, and updates the index accordingly
+                // this is the only place in which this command opens AppImages
+                void verifyEntry(ListEntry& entry, AppImageMetadataIndex& index) {
+                    auto& metadata = entry.metadata;
+                    const auto stdPath = metadata.path.toStdString();
+
+                    metadata.type = appimage_get_type(stdPath.c_str(), false);
+
+                    // the type has been detected already, no need to let isAppImage() open the file again
+                    const auto isAppImage = 0 < metadata.type && metadata.type <= 2;
+                    metadata.registered = isAppImage && hasAlreadyBeenIntegrated(metadata.path);
+                    metadata.digestMd5.clear();
+                    metadata.hasUpdateInformation = -1;
+
+                    if (metadata.registered) {
+                        const auto* desktopFilePath = appimage_registered_desktop_file_path(stdPath.c_str(), nullptr, false);
+                        metadata.desktopFilePath = desktopFilePath == nullptr ? QString() : QString(desktopFilePath);
+                    } else {
+                        metadata.desktopFilePath.clear();
+                    }
+
+                    // updates the stat data, too, so the next run doesn't have to check the file again
+                    index.update(metadata);
+
+                    entry.state = CURRENT;
+                    entry.verified = true;
+                }
+
+                QJsonObject entryToJson(const ListEntry& entry) {
+                    QJsonObject rv;
+
+                    rv["path"] = entry.metadata.path;
+                    rv["state"] = entryStateNames[entry.state];
+                    rv["verified"] = entry.verified;
+                    rv["integrated"] = entry.metadata.registered;
+                    rv["type"] = entry.metadata.type;
+                    rv["digest_md5"] = entry.metadata.digestMd5;
+                    rv["desktop_file"] = entry.metadata.desktopFilePath;
+                    rv["desktop_file_up_to_date"] = entry.desktopFileUpToDate;
+
+                    return rv;
+                }
+            }
+
+            void ListCommand::exec(QList<QString> arguments) {
+                bool json = false;
+                bool verify = false;
+
+                for (const auto& argument : arguments) {
+                    if (argument == "--json") {
+                        json = true;
+                    } else if (argument == "--verify") {
+                        verify = true;
+                    } else {
+                        throw InvalidArgumentsError("unknown argument: " + argument);
+                    }
+                }
+
+                const auto index = AppImageMetadataIndex::instance();
+
+                // verified entries are written back in one go
+                index->setAutoSave(false);
+
+                std::vector<ListEntry> entries;
+
+                for (const auto& metadata : index->entries()) {
+                    ListEntry entry;
+
+                    AppImageMetadata current;
+
+                    if (!AppImageMetadataIndex::readStatData(metadata.path, current)) {
+                        entry.state = MISSING;
+                    } else if (current.inode != metadata.inode || current.size != metadata.size || current.mtime != metadata.mtime) {
+                        entry.state = MODIFIED;
+                    }
+
+                    entry.metadata = metadata;
+
+                    if (verify && entry.state == MODIFIED)
+                        verifyEntry(entry, *index);
+
+                    // the index also contains files which turned out not to be (integrated) AppImages
+                    if (!entry.metadata.registered)
+                        continue;
+
+                    entry.desktopFileUpToDate = desktopFileIsUpToDate(entry.metadata.desktopFilePath);
+
+                    entries.push_back(entry);
+                }
+
+                if (!index->save()) {
+                    qerr() << "Warning: failed to save AppImage metadata index" << endl;
+                }
+
+                index->setAutoSave(true);
+
+                std::sort(entries.begin(), entries.end(), [](const ListEntry& a, const ListEntry& b) {
+                    return a.metadata.path < b.metadata.path;
+                });
+
+                if (json) {
+                    QJsonArray array;
+
+                    for (const auto& entry : entries) {
+                        array.append(entryToJson(entry));
+                    }
+
+                    QJsonObject root;
+                    root["appimages"] = array;
+
+                    qout() << QJsonDocument(root).toJson(QJsonDocument::Indented);
+                    return;
+                }
+
+                for (const auto& entry : entries) {
+                    QString status;
+
+                    if (entry.state != CURRENT) {
+                        status = entryStateNames[entry.state];
+                    } else if (!entry.desktopFileUpToDate) {
+                        status = "outdated";
+                    } else {
+                        status = "integrated";
+                    }
+
+                    qout() << status.leftJustified(16) << entry.metadata.path << endl;
+                }
+            }
+        }
+    }
+}
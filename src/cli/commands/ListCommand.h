@@ -0,0 +1,20 @@
+#pragma once
+
+// local headers
+#include "Command.h"
+
+namespace appimagelauncher {
+    namespace cli {
+        namespace commands {
+            /**
+             * Lists the integrated AppImages, based on the metadata index.
+             *
+             * The AppImages themselves are not opened unless --verify is passed, in which case only the ones whose
+             * stat data doesn't match the index any more are checked again.
+             */
+            class ListCommand : public Command {
+                void exec(QList<QString> arguments) final;
+            };
+        }
+    }
+}
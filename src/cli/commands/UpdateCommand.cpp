@@ -0,0 +1,363 @@
+// system headers
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// library headers
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <appimage/appimage.h>
+#include <appimage/update.h>
+
+// local headers
+#include "UpdateCommand.h"
+#include "arguments.h"
+#include "desktopintegrationbatch.h"
+#include "exceptions.h"
+#include "metadataindex.h"
+#include "shared.h"
+#include "logging.h"
+
+namespace appimagelauncher {
+    namespace cli {
+        namespace commands {
+            namespace {
+                // every update opens a few connections to the server, so the default is kept rather low
+                const int DEFAULT_JOBS = 4;
+
+                // interval in which running updates are polled for status messages and completion
+                const auto POLL_INTERVAL = std::chrono::milliseconds(100);
+
+                enum UpdateStatus {
+                    UPDATED = 0,
+                    UPDATE_AVAILABLE,
+                    UP_TO_DATE,
+                    NO_UPDATE_INFORMATION,
+                    FAILED,
+                };
+
+                const char* const statusNames[] = {"updated", "available", "up to date", "no update info", "failed"};
+
+                struct UpdateResult {
+                    QString pathToAppImage;
+                    QString pathToNewFile;
+                    UpdateStatus status = FAILED;
+                    qint64 elapsedMs = 0;
+
+                    // see IntegrateCommand
+                    QStringList messages;
+                    QStringList errors;
+                };
+
+                void collectStatusMessages(appimage::update::Updater& updater, UpdateResult& result) {
+                    std::string message;
+
+                    while (updater.nextStatusMessage(message)) {
+                        result.messages << "  " + QString::fromStdString(message);
+                    }
+                }
+
+                // checks for and downloads an update for a single AppImage
+                // safe to be called from multiple threads at the same time for different AppImages
+                void updateAppImage(UpdateResult& result, bool checkOnly) {
+                    const auto& pathToAppImage = result.pathToAppImage;
+
+                    result.messages << "Processing " + pathToAppImage;
+
+                    // the integration records whether there's update information, so there's no need to construct an
+                    // Updater for AppImages which turned out not to have any
+                    {
+                        AppImageMetadata metadata;
+
+                        if (AppImageMetadataIndex::instance()->lookup(pathToAppImage, metadata) &&
+                            metadata.hasUpdateInformation == 0) {
+                            result.messages << "No update information found, skipping";
+                            result.status = NO_UPDATE_INFORMATION;
+                            return;
+                        }
+                    }
+
+                    appimage::update::Updater updater(pathToAppImage.toStdString(), false);
+
+                    if (updater.updateInformation().empty()) {
+                        result.messages << "No update information found, skipping";
+                        result.status = NO_UPDATE_INFORMATION;
+                        return;
+                    }
+
+                    bool updateAvailable = false;
+
+                    if (!updater.checkForChanges(updateAvailable)) {
+                        collectStatusMessages(updater, result);
+                        result.errors << "Error: failed to check for updates: " + pathToAppImage;
+                        return;
+                    }
+
+                    collectStatusMessages(updater, result);
+
+                    if (!updateAvailable) {
+                        result.messages << "AppImage is up to date";
+                        result.status = UP_TO_DATE;
+                        return;
+                    }
+
+                    if (checkOnly) {
+                        result.messages << "Update available";
+                        result.status = UPDATE_AVAILABLE;
+                        return;
+                    }
+
+                    if (!updater.start()) {
+                        result.errors << "Error: failed to start update: " + pathToAppImage;
+                        return;
+                    }
+
+                    while (!updater.isDone()) {
+                        std::this_thread::sleep_for(POLL_INTERVAL);
+                        collectStatusMessages(updater, result);
+                    }
+
+                    collectStatusMessages(updater, result);
+
+                    std::string pathToNewFile;
+
+                    if (updater.hasError() || !updater.pathToNewFile(pathToNewFile)) {
+                        result.errors << "Error: failed to update AppImage: " + pathToAppImage;
+                        return;
+                    }
+
+                    result.pathToNewFile = QFileInfo(QString::fromStdString(pathToNewFile)).absoluteFilePath();
+
+                    if (!QFile::exists(result.pathToNewFile)) {
+                        result.errors << "Error: file reported as updated does not exist: " + result.pathToNewFile;
+                        return;
+                    }
+
+                    result.messages << "Updated AppImage: " + result.pathToNewFile;
+                    result.status = UPDATED;
+                }
+
+                class UpdateTask : public QRunnable {
+                private:
+                    UpdateResult& result;
+                    QMutex& outputMutex;
+                    bool checkOnly;
+
+                public:
+                    UpdateTask(UpdateResult& result, QMutex& outputMutex, bool checkOnly) :
+                        result(result), outputMutex(outputMutex), checkOnly(checkOnly) {}
+
+                    void run() override {
+                        QElapsedTimer timer;
+                        timer.start();
+
+                        updateAppImage(result, checkOnly);
+
+                        result.elapsedMs = timer.elapsed();
+
+                        QMutexLocker lock(&outputMutex);
+
+                        for (const auto& message : result.messages) {
+                            qout() << message << endl;
+                        }
+
+                        for (const auto& error : result.errors) {
+                            qerr() << error << endl;
+                        }
+                    }
+                };
+
+                // integrated AppImages, according to the metadata index and the integration directory
+                // the index makes sure only the AppImages which haven't been indexed yet need to be checked
+                QStringList findIntegratedAppImages() {
+                    const auto index = AppImageMetadataIndex::instance();
+
+                    QSet<QString> paths;
+
+                    for (const auto& metadata : index->entries()) {
+                        if (metadata.registered && QFileInfo(metadata.path).isFile())
+                            paths.insert(metadata.path);
+                    }
+
+                    const QDir integrationDirectory(integratedAppImagesDestination());
+
+                    for (const auto& entry : integrationDirectory.entryInfoList(QDir::Files)) {
+                        const auto path = entry.absoluteFilePath();
+
+                        // files with a current entry have been handled above already
+                        AppImageMetadata metadata;
+
+                        if (paths.contains(path) || index->lookup(path, metadata))
+                            continue;
+
+                        if (isAppImage(path) && hasAlreadyBeenIntegrated(path))
+                            paths.insert(path);
+                    }
+
+                    auto rv = QStringList(paths.begin(), paths.end());
+                    std::sort(rv.begin(), rv.end());
+                    return rv;
+                }
+
+                // integrates the updated AppImage, and removes the old one if requested
+                bool integrateUpdate(const UpdateResult& result, bool removeOld) {
+                    const auto& pathToAppImage = result.pathToAppImage;
+                    const auto& pathToNewFile = result.pathToNewFile;
+
+                    if (!appimage_shall_not_be_integrated(pathToNewFile.toStdString().c_str())) {
+                        if (!installDesktopFileAndIcons(pathToNewFile)) {
+                            qerr() << "Error: failed to register updated AppImage in system: " << pathToNewFile << endl;
+                            return false;
+                        }
+                    }
+
+                    // make sure not to delete the updated(!) AppImage if the filenames of the new and old file are
+                    // equal, see update_main.cpp
+                    if (!removeOld || buildPathToIntegratedAppImage(pathToAppImage) == buildPathToIntegratedAppImage(pathToNewFile))
+                        return true;
+
+                    // unlike appimage_unregister_in_system(), this records the modified trees in the batch
+                    if (!unregisterAppImage(pathToAppImage)) {
+                        qerr() << "Error: failed to unregister old AppImage in system: " << pathToAppImage << endl;
+                        return false;
+                    }
+
+                    if (!QFile::remove(pathToAppImage)) {
+                        qerr() << "Error: failed to remove old AppImage: " << pathToAppImage << endl;
+                        return false;
+                    }
+
+                    return true;
+                }
+            }
+
+            void UpdateCommand::exec(QList<QString> arguments) {
+                const auto jobs = extractJobsCount(arguments, DEFAULT_JOBS);
+                const auto checkOnly = extractFlag(arguments, "--check-only");
+                const auto removeOld = extractFlag(arguments, "--remove-old");
+
+                for (const auto& argument : arguments) {
+                    if (argument.startsWith("-")) {
+                        throw InvalidArgumentsError("unknown argument: " + argument);
+                    }
+                }
+
+                for (auto& path : arguments) {
+                    if (!QFileInfo(path).isFile()) {
+                        throw UsageError("could not find file " + path);
+                    }
+
+                    path = QFileInfo(path).absoluteFilePath();
+                }
+
+                const auto index = AppImageMetadataIndex::instance();
+
+                // the index is written once after the batch rather than after every single AppImage
+                index->setAutoSave(false);
+
+                const auto paths = arguments.empty() ? findIntegratedAppImages() : QStringList(arguments);
+
+                if (paths.empty()) {
+                    qout() << "No AppImages to update" << endl;
+                    index->setAutoSave(true);
+                    return;
+                }
+
+                std::vector<UpdateResult> results;
+
+                for (const auto& path : paths) {
+                    UpdateResult result;
+                    result.pathToAppImage = path;
+                    results.push_back(result);
+                }
+
+                QElapsedTimer totalTimer;
+                totalTimer.start();
+
+                // the checks and transfers are mostly waiting for the network, so they're run concurrently
+                // AppImageUpdate doesn't provide a way to limit the bandwidth, the number of jobs is the only knob
+                {
+                    QMutex outputMutex;
+
+                    QThreadPool threadPool;
+                    threadPool.setMaxThreadCount(std::min(jobs, static_cast<int>(results.size())));
+
+                    for (auto& result : results) {
+                        threadPool.start(new UpdateTask(result, outputMutex, checkOnly));
+                    }
+
+                    threadPool.waitForDone();
+                }
+
+                const auto updatedCount = std::count_if(results.begin(), results.end(), [](const UpdateResult& result) {
+                    return result.status == UPDATED;
+                });
+
+                auto failedCount = std::count_if(results.begin(), results.end(), [](const UpdateResult& result) {
+                    return result.status == FAILED;
+                });
+
+                // all updated AppImages are integrated in one batch, like the integrate command does
+                if (updatedCount > 0) {
+                    qout() << "Integrating updated AppImages" << endl;
+
+                    DesktopIntegrationBatch integrationBatch;
+
+                    for (auto& result : results) {
+                        if (result.status != UPDATED)
+                            continue;
+
+                        if (!integrateUpdate(result, removeOld)) {
+                            result.status = FAILED;
+                            ++failedCount;
+                        }
+                    }
+
+                    if (!cleanUpOldDesktopIntegrationResources()) {
+                        qerr() << "Warning: failed to clean up old desktop integration files" << endl;
+                    }
+
+                    const auto changedTrees = integrationBatch.changedTrees();
+
+                    if (changedTrees != 0 && !updateDesktopDatabaseAndIconCaches(changedTrees)) {
+                        qerr() << "Warning: failed to update desktop database and icon caches" << endl;
+                    }
+
+                    if (!integrationBatch.commit()) {
+                        qerr() << "Warning: failed to sync desktop integration files to disk" << endl;
+                    }
+                }
+
+                if (!index->save()) {
+                    qerr() << "Warning: failed to save AppImage metadata index" << endl;
+                }
+
+                index->setAutoSave(true);
+
+                qout() << endl << "Summary:" << endl;
+
+                for (const auto& result : results) {
+                    qout() << "  " << QString(statusNames[result.status]).leftJustified(14) << " "
+                           << QString("%1 ms").arg(result.elapsedMs).rightJustified(9) << "  "
+                           << result.pathToAppImage << endl;
+                }
+
+                qout() << updatedCount << " updated, " << failedCount << " failed, " << results.size() << " total in "
+                       << totalTimer.elapsed() << " ms "
+                       << "(" << jobs << (jobs == 1 ? " job" : " jobs") << ")" << endl;
+
+                if (failedCount > 0) {
+                    throw CliError(QString("Failed to update %1 AppImage(s)").arg(failedCount));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+// local headers
+#include "Command.h"
+
+namespace appimagelauncher {
+    namespace cli {
+        namespace commands {
+            /**
+             * Updates AppImages using AppImageUpdate, without any user interaction (e.g., for nightly cron jobs).
+             *
+             * Without arguments, all integrated AppImages are updated. The update checks and transfers run
+             * concurrently, the updated AppImages are integrated in a single batch once all of them have finished.
+             */
+            class UpdateCommand : public Command {
+                void exec(QList<QString> arguments) final;
+            };
+        }
+    }
+}
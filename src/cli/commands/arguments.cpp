@@ -0,0 +1,50 @@
+// system headers
+#include <cstring>
+
+// local headers
+#include "arguments.h"
+#include "exceptions.h"
+
+namespace appimagelauncher {
+    namespace cli {
+        namespace commands {
+            int extractJobsCount(QList<QString>& arguments, int defaultValue) {
+                int jobs = defaultValue;
+
+                for (auto it = arguments.begin(); it != arguments.end();) {
+                    QString value;
+
+                    if (*it == "--jobs" || *it == "-j") {
+                        it = arguments.erase(it);
+
+                        if (it == arguments.end()) {
+                            throw InvalidArgumentsError("--jobs requires a value");
+                        }
+
+                        value = *it;
+                    } else if (it->startsWith("--jobs=")) {
+                        value = it->mid(static_cast<int>(strlen("--jobs=")));
+                    } else {
+                        ++it;
+                        continue;
+                    }
+
+                    it = arguments.erase(it);
+
+                    bool ok = false;
+                    jobs = value.toInt(&ok);
+
+                    if (!ok || jobs < 1) {
+                        throw InvalidArgumentsError("invalid number of jobs: " + value);
+                    }
+                }
+
+                return jobs;
+            }
+
+            bool extractFlag(QList<QString>& arguments, const QString& flag) {
+                return arguments.removeAll(flag) > 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+// library headers
+#include <QList>
+#include <QString>
+
+namespace appimagelauncher {
+    namespace cli {
+        namespace commands {
+            // removes "--jobs N", "--jobs=N" and "-j N" from the arguments, and returns N (or defaultValue if the
+            // option hasn't been passed)
+            int extractJobsCount(QList<QString>& arguments, int defaultValue = 1);
+
+            // removes all occurrences of the given flag from the arguments, and returns whether it has been passed
+            bool extractFlag(QList<QString>& arguments, const QString& flag);
+        }
+    }
+}
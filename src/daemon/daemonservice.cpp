@@ -0,0 +1,86 @@
+// system includes
+#include <iostream>
+
+// library includes
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusReply>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+// local includes
+#include "daemonservice.h"
+#include "digestcache.h"
+#include "filesystemwatcher.h"
+#include "metrics.h"
+#include "shared.h"
+#include "trashreclaimer.h"
+
+DaemonService::DaemonService(FileSystemWatcher* watcher, TrashReclaimer* trashReclaimer, QObject* parent) :
+    QObject(parent), watcher(watcher), trashReclaimer(trashReclaimer) {}
+
+bool DaemonService::registerOnSessionBus() {
+    auto bus = QDBusConnection::sessionBus();
+
+    if (!bus.isConnected()) {
+        std::cerr << "Warning: not connected to session bus, D-Bus interface won't be available" << std::endl;
+        return false;
+    }
+
+    if (!bus.registerObject(APPIMAGELAUNCHERD_DBUS_PATH, this, QDBusConnection::ExportScriptableSlots)) {
+        std::cerr << "Warning: failed to register daemon object on session bus" << std::endl;
+        return false;
+    }
+
+    if (!bus.registerService(APPIMAGELAUNCHERD_DBUS_SERVICE)) {
+        std::cerr << "Warning: failed to register " << APPIMAGELAUNCHERD_DBUS_SERVICE
+                  << " on session bus, is another instance running?" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+int DaemonService::printStatsOfRunningDaemon() {
+    QDBusInterface interface(
+        APPIMAGELAUNCHERD_DBUS_SERVICE, APPIMAGELAUNCHERD_DBUS_PATH, APPIMAGELAUNCHERD_DBUS_INTERFACE,
+        QDBusConnection::sessionBus()
+    );
+
+    if (!interface.isValid()) {
+        std::cerr << "Could not connect to appimagelauncherd, is it running?" << std::endl;
+        return 1;
+    }
+
+    QDBusReply<QString> reply = interface.call("Stats");
+
+    if (!reply.isValid()) {
+        std::cerr << "Failed to fetch stats: " << reply.error().message().toStdString() << std::endl;
+        return 1;
+    }
+
+    std::cout << reply.value().toStdString() << std::endl;
+    return 0;
+}
+
+QString DaemonService::Stats() {
+    auto stats = Metrics::instance()->toJson();
+
+    // some components keep their own counters, which are added to the snapshot
+    auto counters = stats["counters"].toObject();
+
+    counters.insert("inotify.events", static_cast<qint64>(watcher->eventsCount()));
+    counters.insert("inotify.overflows", static_cast<qint64>(watcher->overflowCount()));
+    counters.insert("digest.cache_hits", static_cast<qint64>(AppImageDigestCache::hits()));
+    counters.insert("digest.cache_misses", static_cast<qint64>(AppImageDigestCache::misses()));
+
+    stats.insert("counters", counters);
+    stats.insert("version", QCoreApplication::applicationVersion());
+
+    return QString::fromUtf8(QJsonDocument(stats).toJson(QJsonDocument::Indented));
+}
+
+void DaemonService::ReclaimTrash() {
+    trashReclaimer->reclaim();
+}
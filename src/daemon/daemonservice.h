@@ -0,0 +1,37 @@
+// library includes
+#include <QObject>
+#include <QString>
+
+#pragma once
+
+class FileSystemWatcher;
+class TrashReclaimer;
+
+// the daemon's interface on the session bus
+// exposes the daemon's metrics (see appimagelauncherd --stats), and allows other tools to have work done in the
+// background
+class DaemonService : public QObject {
+    Q_OBJECT
+    // moc doesn't expand APPIMAGELAUNCHERD_DBUS_INTERFACE reliably, hence the literal
+    Q_CLASSINFO("D-Bus Interface", "org.appimagelauncher.Daemon")
+
+private:
+    FileSystemWatcher* watcher;
+    TrashReclaimer* trashReclaimer;
+
+public:
+    DaemonService(FileSystemWatcher* watcher, TrashReclaimer* trashReclaimer, QObject* parent = nullptr);
+
+    // registers the service on the session bus, returns false if that fails (e.g., when another instance runs)
+    bool registerOnSessionBus();
+
+    // fetches the stats from the running daemon and prints them to stdout, returns the exit code for the process
+    static int printStatsOfRunningDaemon();
+
+public slots:
+    // metrics as JSON document
+    Q_SCRIPTABLE QString Stats();
+
+    // cleans up the trash bin in the background, used by the tools which move AppImages into the trash bin
+    Q_SCRIPTABLE void ReclaimTrash();
+};
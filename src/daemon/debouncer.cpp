@@ -0,0 +1,40 @@
+// system includes
+#include <algorithm>
+
+// local includes
+#include "debouncer.h"
+
+Debouncer::Debouncer(int quietPeriod, int maxLatency, QObject* parent) : QObject(parent) {
+    quietPeriodTimer.setSingleShot(true);
+    maxLatencyTimer.setSingleShot(true);
+
+    setIntervals(quietPeriod, maxLatency);
+
+    connect(&quietPeriodTimer, &QTimer::timeout, this, &Debouncer::timerFired);
+    connect(&maxLatencyTimer, &QTimer::timeout, this, &Debouncer::timerFired);
+}
+
+void Debouncer::setIntervals(int quietPeriod, int maxLatency) {
+    quietPeriodTimer.setInterval(quietPeriod);
+    maxLatencyTimer.setInterval(std::max(quietPeriod, maxLatency));
+}
+
+void Debouncer::trigger() {
+    quietPeriodTimer.start();
+
+    // the max latency is counted from the first trigger after the last timeout
+    if (!maxLatencyTimer.isActive())
+        maxLatencyTimer.start();
+}
+
+void Debouncer::stop() {
+    quietPeriodTimer.stop();
+    maxLatencyTimer.stop();
+}
+
+void Debouncer::timerFired() {
+    // whichever timer fires first, the other one must not fire later on for no reason
+    stop();
+
+    emit timeout();
+}
@@ -0,0 +1,40 @@
+// library includes
+#include <QObject>
+#include <QTimer>
+
+#pragma once
+
+/**
+ * Debounces bursts of events.
+ *
+ * timeout() is emitted once trigger() hasn't been called for <quietPeriod> ms, but no later than <maxLatency> ms after
+ * the first call of trigger() since timeout() has been emitted last. This way, single events are handled quickly,
+ * whereas long bursts are handled in as few runs as possible, without postponing them indefinitely.
+ */
+class Debouncer : public QObject {
+    Q_OBJECT
+
+private:
+    QTimer quietPeriodTimer;
+    QTimer maxLatencyTimer;
+
+public:
+    Debouncer(int quietPeriod, int maxLatency, QObject* parent = nullptr);
+
+public:
+    // the max latency must not be shorter than the quiet period, otherwise the latter is pointless
+    void setIntervals(int quietPeriod, int maxLatency);
+
+public slots:
+    // every call extends the quiet period
+    void trigger();
+
+    // cancels the pending timeout, e.g., because the events have been handled by other means
+    void stop();
+
+private slots:
+    void timerFired();
+
+signals:
+    void timeout();
+};
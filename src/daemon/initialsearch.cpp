@@ -0,0 +1,143 @@
+// system includes
+#include <iostream>
+#include <memory>
+
+// library includes
+#include <QDebug>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <appimage/appimage.h>
+
+// local includes
+#include "initialsearch.h"
+#include "metadataindex.h"
+#include "shared.h"
+#include "worker.h"
+
+// collects the directories and their subdirectories up to the given depth, like the file system watcher does
+static QList<QDir> directoriesToSearch(const QDirSet& dirs, int depth) {
+    QList<QDir> rv;
+    QList<QDir> currentLevel;
+
+    for (const auto& dir : dirs) {
+        currentLevel << dir;
+    }
+
+    for (int level = 0; !currentLevel.empty(); ++level) {
+        rv << currentLevel;
+
+        if (level >= depth)
+            break;
+
+        QList<QDir> nextLevel;
+
+        for (const auto& dir : currentLevel) {
+            for (const auto& entry : dir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden)) {
+                nextLevel << QDir(entry.absoluteFilePath());
+            }
+        }
+
+        currentLevel.swap(nextLevel);
+    }
+
+    return rv;
+}
+
+void initialSearchForAppImages(const QDirSet& dirsToSearch, Worker& worker, int depth) {
+    // initial search for AppImages; if AppImages are found, they will be integrated, unless they already are
+    std::cout << "Searching for existing AppImages" << std::endl;
+
+    const auto index = AppImageMetadataIndex::instance();
+
+    for (const auto& dir : directoriesToSearch(dirsToSearch, depth)) {
+        std::cout << "Searching directory: " << dir.absolutePath().toStdString() << std::endl;
+
+        for (QDirIterator it(dir); it.hasNext();) {
+            const auto& path = it.next();
+
+            if (QFileInfo(path).isFile()) {
+                if (isIncompleteDownload(path)) {
+                    qDebug() << "Skipping incomplete download:" << path;
+                    continue;
+                }
+
+                // files which have not changed since the last search don't need to be opened again
+                // this way, only new or modified files and AppImages whose integration is outdated are inspected
+                // as long as the stat data matches, the entry is kept even if the AppImage needs to be (re-)integrated,
+                // so that e.g., its digest and whether it contains update information don't have to be determined again
+                AppImageMetadata metadata;
+
+                const auto entryIsValid = index->lookup(path, metadata);
+
+                if (entryIsValid) {
+                    const auto isAppImage = 0 < metadata.type && metadata.type <= 2;
+
+                    if (!isAppImage) {
+                        continue;
+                    }
+
+                    if (metadata.registered && desktopFileIsUpToDate(metadata.desktopFilePath)) {
+                        qDebug() << "AppImage unchanged since last search and integrated already, skipping:" << path;
+                        continue;
+                    }
+                } else {
+                    // the file is new or has been modified, so none of the values recorded before can be reused
+                    metadata = AppImageMetadata{};
+                    metadata.path = path;
+                }
+
+                // the handle rejects most files by reading their first few bytes
+                AppImageHandle appImage(path);
+
+                // the file is not recorded in the index, so it's inspected again once the writer is done
+                if (appImage.isOpenForWriting()) {
+                    std::cout << "File is still being written, skipping for now: " << path.toStdString() << std::endl;
+                    continue;
+                }
+
+                const auto appImageType = entryIsValid ? metadata.type : appImage.type();
+                const auto isAppImage = 0 < appImageType && appImageType <= 2;
+
+                metadata.type = appImageType;
+
+                if (isAppImage) {
+                    // at application startup, we don't want to integrate AppImages that have been integrated already,
+                    // as that it slows down very much
+                    // the integration will be updated as soon as any of these AppImages is run with AppImageLauncher
+                    std::cout << "Found AppImage: " << path.toStdString() << std::endl;
+
+                    if (!appimage_is_registered_in_system(path.toStdString().c_str())) {
+                        std::cout << "AppImage is not integrated yet, integrating" << std::endl;
+                        metadata.registered = false;
+                        metadata.desktopFilePath.clear();
+                        worker.scheduleForIntegration(path);
+                    } else if (!desktopFileHasBeenUpdatedSinceLastUpdate(path)) {
+                        std::cout << "AppImage has been integrated already but needs to be reintegrated" << std::endl;
+                        worker.scheduleForIntegration(path);
+                    } else {
+                        std::cout << "AppImage integrated already, skipping" << std::endl;
+
+                        // record the integration, so the AppImage can be skipped without opening it next time
+                        std::shared_ptr<char> desktopFilePath(
+                            appimage_registered_desktop_file_path(path.toStdString().c_str(), nullptr, false),
+                            [](char* p) { free(p); }
+                        );
+
+                        if (desktopFilePath != nullptr) {
+                            metadata.registered = true;
+                            metadata.desktopFilePath = desktopFilePath.get();
+                        }
+                    }
+                }
+
+                // scheduled AppImages will be recorded once they have been integrated
+                index->update(metadata);
+            }
+        }
+    }
+
+    // make sure the results survive a restart, even if nothing has to be integrated
+    if (!index->save()) {
+        std::cerr << "Warning: failed to save AppImage metadata index" << std::endl;
+    }
+}
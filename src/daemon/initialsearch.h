@@ -0,0 +1,14 @@
+// library includes
+#include <QDir>
+
+// local includes
+#include "types.h"
+
+#pragma once
+
+class Worker;
+
+// searches the directories (and their subdirectories up to the given depth) for AppImages, and schedules the ones
+// which are not integrated yet, or whose integration is outdated, for integration
+// the results are recorded in the metadata index, so files which haven't changed are skipped without opening them
+void initialSearchForAppImages(const QDirSet& dirsToSearch, Worker& worker, int depth = 0);
@@ -1,6 +1,7 @@
 // system includes
 #include <deque>
 #include <iostream>
+#include <memory>
 #include <set>
 #include <sstream>
 #include <sys/stat.h>
@@ -9,13 +10,17 @@
 #include <QCommandLineParser>
 #include <QCoreApplication>
 #include <QDebug>
-#include <QDirIterator>
 #include <QTimer>
 #include <appimage/appimage.h>
 
 // local includes
 #include "shared.h"
 #include "filesystemwatcher.h"
+#include "initialsearch.h"
+#include "mountwatcher.h"
+#include "metadataindex.h"
+#include "daemonservice.h"
+#include "trashreclaimer.h"
 #include "worker.h"
 
 #define UPDATE_WATCHED_DIRECTORIES_INTERVAL 30 * 1000
@@ -57,39 +62,31 @@ QTimer* setupBinaryUpdatesMonitor(char* const* argv) {
     return timer;
 }
 
-void initialSearchForAppImages(const QDirSet& dirsToSearch, Worker& worker) {
-    // initial search for AppImages; if AppImages are found, they will be integrated, unless they already are
-    std::cout << "Searching for existing AppImages" << std::endl;
-
-    for (const auto& dir : dirsToSearch) {
-        std::cout << "Searching directory: " << dir.absolutePath().toStdString() << std::endl;
-
-        for (QDirIterator it(dir); it.hasNext();) {
-            const auto& path = it.next();
-
-            if (QFileInfo(path).isFile()) {
-                const auto appImageType = appimage_get_type(path.toStdString().c_str(), false);
-                const auto isAppImage = 0 < appImageType && appImageType <= 2;
-
-                if (isAppImage) {
-                    // at application startup, we don't want to integrate AppImages that have been integrated already,
-                    // as that it slows down very much
-                    // the integration will be updated as soon as any of these AppImages is run with AppImageLauncher
-                    std::cout << "Found AppImage: " << path.toStdString() << std::endl;
-
-                    if (!appimage_is_registered_in_system(path.toStdString().c_str())) {
-                        std::cout << "AppImage is not integrated yet, integrating" << std::endl;
-                        worker.scheduleForIntegration(path);
-                    } else if (!desktopFileHasBeenUpdatedSinceLastUpdate(path)) {
-                        std::cout << "AppImage has been integrated already but needs to be reintegrated" << std::endl;
-                        worker.scheduleForIntegration(path);
-                    } else {
-                        std::cout << "AppImage integrated already, skipping" << std::endl;
-                    }
-                }
-            }
-        }
+/**
+ * Checks whether a file is located within one of the given directories or their subdirectories, like the ones
+ * searched by initialSearchForAppImages().
+ *
+ * @param filePath
+ * @param dirs
+ * @param depth number of subdirectory levels taken into account, 0 means the directories themselves only
+ * @return true if the file is within one of the directories
+ */
+bool isWithinDirectories(const QString& filePath, const QDirSet& dirs, int depth) {
+    const auto absoluteFilePath = QFileInfo(filePath).absoluteFilePath();
+
+    for (const auto& dir : dirs) {
+        const auto relativePath = dir.relativeFilePath(absoluteFilePath);
+
+        // files outside the directory result in paths starting with ../, or an absolute path if there is no common
+        // prefix at all
+        if (relativePath == ".." || relativePath.startsWith("../") || QDir::isAbsolutePath(relativePath))
+            continue;
+
+        if (relativePath.count('/') <= depth)
+            return true;
     }
+
+    return false;
 }
 
 int main(int argc, char* argv[]) {
@@ -113,6 +110,15 @@ int main(int argc, char* argv[]) {
         throw std::runtime_error("could not add Qt command line option for some reason");
     }
 
+    QCommandLineOption statsOption(
+        "stats",
+        QObject::tr("Prints the counters and timings of the running daemon as JSON and exit")
+    );
+
+    if (!parser.addOption(statsOption)) {
+        throw std::runtime_error("could not add Qt command line option for some reason");
+    }
+
     QCoreApplication app(argc, argv);
 
     {
@@ -126,9 +132,18 @@ int main(int argc, char* argv[]) {
     // parse arguments
     parser.process(app);
 
+    if (parser.isSet(statsOption)) {
+        return DaemonService::printStatsOfRunningDaemon();
+    }
+
     // load config file
+    // the generation is fetched first, so that a change in between results in the config being considered outdated
+    auto watchedDirectoriesConfigGeneration = configGeneration();
     const auto config = getConfig();
 
+    // the daemon modifies the metadata index in batches, saving after every single change would be a waste of time
+    AppImageMetadataIndex::instance()->setAutoSave(false);
+
     const auto listWatchedDirectories = parser.isSet(listWatchedDirectoriesOption);
 
     QDirSet watchedDirectories = daemonDirectoriesToWatch(config);
@@ -136,6 +151,9 @@ int main(int argc, char* argv[]) {
     // this option is for debugging the
     if (listWatchedDirectories) {
         for (const auto& watchedDir : watchedDirectories) {
+            if (!watchedDir.exists())
+                continue;
+
             std::cout << watchedDir.absolutePath().toStdString() << std::endl;
         }
         return 0;
@@ -144,20 +162,55 @@ int main(int argc, char* argv[]) {
     // time to create the watcher object
     FileSystemWatcher watcher(watchedDirectories);
 
+    if (config != nullptr) {
+        bool ok = false;
+        const auto readBufferSize = config->value("appimagelauncherd/inotify_read_buffer_size").toUInt(&ok);
+
+        if (ok) {
+            qDebug() << "inotify read buffer size:" << readBufferSize;
+            watcher.setReadBufferSize(readBufferSize);
+        }
+
+        // AppImages may be organized in subdirectories, which can be watched, too
+        const auto recursionDepth = config->value("appimagelauncherd/watch_subdirectories_depth", 0).toInt();
+
+        if (recursionDepth > 0) {
+            qDebug() << "watching subdirectories up to depth" << recursionDepth;
+            watcher.setRecursionDepth(recursionDepth);
+        }
+    }
+
     // create a daemon worker instance
     // it is used to integrate all AppImages initially, and to integrate files found via inotify
     Worker worker;
 
+    if (config != nullptr) {
+        const auto quietPeriod = config->value(
+            "appimagelauncherd/debounce_quiet_period_ms", Worker::DEFAULT_QUIET_PERIOD
+        ).toInt();
+        const auto maxLatency = config->value(
+            "appimagelauncherd/debounce_max_latency_ms", Worker::DEFAULT_MAX_LATENCY
+        ).toInt();
+
+        qDebug() << "debounce intervals:" << quietPeriod << "ms quiet period," << maxLatency << "ms max latency";
+        worker.setDebounceIntervals(quietPeriod, maxLatency);
+
+        const auto maxThreadCount = config->value(
+            "appimagelauncherd/max_worker_threads", Worker::DEFAULT_MAX_THREAD_COUNT
+        ).toInt();
+        worker.setMaxThreadCount(maxThreadCount);
+    }
+
     // we we update the watched directories, the file system watcher can calculate whether there's new directories
     // to watch
     // these
-    QObject::connect(&watcher, &FileSystemWatcher::newDirectoriesToWatch, &app, [&worker](const QDirSet& newDirs) {
+    QObject::connect(&watcher, &FileSystemWatcher::newDirectoriesToWatch, &app, [&watcher, &worker](const QDirSet& newDirs) {
         if (newDirs.empty()) {
             qDebug() << "No new directories to watch detected";
         } else {
             std::cout << "Discovered new directories to watch, integrating existing AppImages initially" << std::endl;
 
-            initialSearchForAppImages(newDirs, worker);
+            initialSearchForAppImages(newDirs, worker, watcher.recursionDepth());
 
             // (re-)integrate all AppImages at once
             worker.executeDeferredOperations();
@@ -182,28 +235,99 @@ int main(int argc, char* argv[]) {
         }
     });
 
+    // when the kernel drops events, e.g., because lots of files are copied at once, we need to catch up by rescanning
+    // the directories
+    // thanks to the metadata index, only files which have changed since they have been seen last are inspected again
+    QObject::connect(&watcher, &FileSystemWatcher::directoriesNeedRescan, &app,
+        [&watcher, &worker](const QDirSet& dirsToRescan) {
+
+        std::cout << "Rescanning watched directories, lost events so far: " << watcher.overflowCount()
+                  << " overflow(s) after " << watcher.eventsCount() << " event(s)" << std::endl;
+
+        initialSearchForAppImages(dirsToRescan, worker, watcher.recursionDepth());
+
+        // the search only finds new files, files removed in the meantime must be looked up in the index
+        for (const auto& entry : AppImageMetadataIndex::instance()->entries()) {
+            if (!isWithinDirectories(entry.path, dirsToRescan, watcher.recursionDepth()))
+                continue;
+
+            if (!QFileInfo(entry.path).exists())
+                worker.scheduleForUnintegration(entry.path);
+        }
+    });
+
     // search directories to watch once initially
     // we *have* to do this even though we connect this signal above, as the first update occurs in the constructor
     // and we cannot connect signals before construction has finished for obvious reasons
-    initialSearchForAppImages(watcher.directories(), worker);
+    initialSearchForAppImages(watcher.directories(), worker, watcher.recursionDepth());
 
     // (re-)integrate all AppImages at once
     worker.executeDeferredOperations();
 
     // we regularly want to update
+    // the list of directories to watch depends on the config only (changes of the mounted filesystems are handled by
+    // the mount watcher below), so it is calculated again only if the config has changed in the meantime
+    // the watcher checks which of the directories exist, on its own, so directories which are created later on are
+    // picked up nevertheless
     {
         auto* timer = new QTimer(&app);
         timer->setInterval(UPDATE_WATCHED_DIRECTORIES_INTERVAL);
         QTimer::connect(
-            timer, &QTimer::timeout, &app,[&watcher]() {
-                watcher.updateWatchedDirectories(daemonDirectoriesToWatch());
+            timer, &QTimer::timeout, &app, [&watcher, &watchedDirectories, &watchedDirectoriesConfigGeneration]() {
+                const auto currentConfigGeneration = configGeneration();
+                const auto currentConfig = getConfig();
+
+                if (currentConfigGeneration != watchedDirectoriesConfigGeneration) {
+                    qDebug() << "calculating directories to watch";
+                    watchedDirectories = daemonDirectoriesToWatch(currentConfig);
+                    watchedDirectoriesConfigGeneration = currentConfigGeneration;
+                }
+
+                watcher.updateWatchedDirectories(watchedDirectories);
             }
         );
         timer->start();
     }
 
-    // after (re-)integrating all AppImages, clean up old desktop integration resources before start
-    if (!cleanUpOldDesktopIntegrationResources()) {
+    // filesystems mounted or unmounted later on are picked up as soon as the kernel reports the change
+    // the watcher reports only the Applications directories which have actually been added or removed, and the file
+    // system watcher in turn reports only directories which it hasn't been watching before
+    // the mount table is watched only if monitoring mounted filesystems has been enabled on startup, the changes are
+    // then applied to the watched directories directly
+    // the watcher reads the mount table when it's started, so it's not even constructed if it's not needed
+    std::unique_ptr<MountWatcher> mountWatcher;
+
+    if (shallMonitorMountedFilesystems(config)) {
+        mountWatcher.reset(new MountWatcher);
+
+        QObject::connect(mountWatcher.get(), &MountWatcher::locationsChanged, &app,
+            [&watcher, &watchedDirectories](const QSet<QString>& addedLocations, const QSet<QString>& removedLocations) {
+
+            std::cout << "Mounted filesystems changed, updating watched directories" << std::endl;
+
+            for (const auto& location : removedLocations) {
+                const auto it = watchedDirectories.find(QDir(location));
+
+                if (it != watchedDirectories.end())
+                    watchedDirectories.erase(it);
+            }
+
+            for (const auto& location : addedLocations) {
+                watchedDirectories.insert(QDir(location).absolutePath());
+            }
+
+            watcher.updateWatchedDirectories(watchedDirectories);
+        });
+
+        if (!mountWatcher->startWatching()) {
+            std::cerr << "Warning: could not watch mount table, mounted filesystems will be picked up only on restart"
+                      << std::endl;
+        }
+    }
+
+    // clean up old desktop integration resources before start
+    // if AppImages are being (re-)integrated, the worker takes care of this once it's done
+    if (worker.isIdle() && !cleanUpOldDesktopIntegrationResources()) {
         std::cout << "Failed to clean up old desktop integration resources" << std::endl;
     }
 
@@ -213,10 +337,20 @@ int main(int argc, char* argv[]) {
     }
     std::cout << std::endl;
 
-    FileSystemWatcher::connect(&watcher, &FileSystemWatcher::fileChanged, &worker, &Worker::scheduleForIntegration,
-                               Qt::QueuedConnection);
-    FileSystemWatcher::connect(&watcher, &FileSystemWatcher::fileRemoved, &worker, &Worker::scheduleForUnintegration,
-                               Qt::QueuedConnection);
+    // the events are delivered in batches, one per read from the inotify fd, to keep the number of queued calls low
+    FileSystemWatcher::connect(&watcher, &FileSystemWatcher::eventsReceived, &worker,
+        [&worker](const FileSystemWatcherEvents& events) {
+            for (const auto& event : events) {
+                switch (event.type) {
+                    case FileSystemWatcherEvent::FILE_CHANGED:
+                        worker.scheduleForIntegration(event.path);
+                        break;
+                    case FileSystemWatcherEvent::FILE_REMOVED:
+                        worker.scheduleForUnintegration(event.path);
+                        break;
+                }
+            }
+        }, Qt::QueuedConnection);
 
     if (!watcher.startWatching()) {
         std::cerr << "Could not start watching directories" << std::endl;
@@ -225,6 +359,14 @@ int main(int argc, char* argv[]) {
 
     QObject::connect(&app, &QCoreApplication::aboutToQuit, &watcher, &FileSystemWatcher::stopWatching);
 
+    // removing AppImages from the trash bin can take a while, which is why the tools leave this to the daemon
+    TrashReclaimer trashReclaimer;
+    trashReclaimer.start();
+
+    // the daemon works fine without, so a failure is not fatal
+    DaemonService daemonService(&watcher, &trashReclaimer);
+    daemonService.registerOnSessionBus();
+
     auto* binaryUpdatesMonitor = setupBinaryUpdatesMonitor(argv);
     binaryUpdatesMonitor->start();
 
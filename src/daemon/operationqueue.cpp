@@ -0,0 +1,61 @@
+// local includes
+#include "operationqueue.h"
+#include "metadataindex.h"
+
+OperationQueue::OperationQueue(std::shared_ptr<AppImageMetadataIndex> index) : index(std::move(index)) {}
+
+bool OperationQueue::schedule(const Operation& operation) {
+    const auto& path = operation.first;
+
+    auto pending = pendingOperations.find(path);
+
+    if (pending == pendingOperations.end()) {
+        pendingOperations.insert(path, operations.insert(operations.end(), operation));
+        return true;
+    }
+
+    const auto pendingType = pending.value()->second;
+
+    if (pendingType == operation.second)
+        return false;
+
+    operations.erase(pending.value());
+    pendingOperations.erase(pending);
+
+    // a file that has been created and removed again before we got to integrate it doesn't need any work at all
+    // unless it has been integrated before, e.g., an integrated AppImage has been modified and then removed
+    if (pendingType == INTEGRATE) {
+        const auto currentIndex = index != nullptr ? index : AppImageMetadataIndex::instance();
+
+        AppImageMetadata metadata;
+
+        if (!currentIndex->lookupUnchecked(path, metadata) || !metadata.registered)
+            return false;
+    }
+
+    // the new operation takes the place of the old one, and is moved to the end of the queue to preserve the
+    // order in which the events have occurred
+    pendingOperations.insert(path, operations.insert(operations.end(), operation));
+    return true;
+}
+
+OperationQueue::const_iterator OperationQueue::erase(const_iterator it) {
+    pendingOperations.remove(it->first);
+    return operations.erase(it);
+}
+
+OperationQueue::const_iterator OperationQueue::begin() const {
+    return operations.begin();
+}
+
+OperationQueue::const_iterator OperationQueue::end() const {
+    return operations.end();
+}
+
+bool OperationQueue::empty() const {
+    return operations.empty();
+}
+
+size_t OperationQueue::size() const {
+    return operations.size();
+}
@@ -0,0 +1,56 @@
+// system includes
+#include <list>
+#include <memory>
+#include <utility>
+
+// library includes
+#include <QHash>
+#include <QString>
+
+#pragma once
+
+class AppImageMetadataIndex;
+
+enum OP_TYPE {
+    INTEGRATE = 0,
+    UNINTEGRATE = 1,
+};
+
+typedef std::pair<QString, OP_TYPE> Operation;
+
+/**
+ * Operations scheduled by the worker, in the order in which they have been scheduled.
+ *
+ * There is at most one pending operation per path, so a new operation either is a duplicate of, cancels or replaces
+ * the pending one. Operations are merged in constant time.
+ */
+class OperationQueue {
+public:
+    typedef std::list<Operation>::const_iterator const_iterator;
+
+private:
+    std::list<Operation> operations;
+
+    // pending operation per path
+    QHash<QString, std::list<Operation>::iterator> pendingOperations;
+
+    std::shared_ptr<AppImageMetadataIndex> index;
+
+public:
+    // the index is used to find out whether an AppImage has been integrated before, defaults to the process-wide one
+    explicit OperationQueue(std::shared_ptr<AppImageMetadataIndex> index = nullptr);
+
+public:
+    // merges the operation into the queue
+    // returns false if the operation doesn't need to be executed
+    bool schedule(const Operation& operation);
+
+    // removes the operation from the queue, returns the position of the next one
+    const_iterator erase(const_iterator it);
+
+    const_iterator begin() const;
+    const_iterator end() const;
+
+    bool empty() const;
+    size_t size() const;
+};
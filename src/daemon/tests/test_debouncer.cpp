@@ -0,0 +1,116 @@
+// library includes
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QtTest>
+
+// local includes
+#include "debouncer.h"
+
+// timers may fire late on busy machines, so the tests only check lower bounds
+static constexpr int QUIET_PERIOD = 100;
+static constexpr int MAX_LATENCY = 400;
+static constexpr int TIMEOUT = 5 * 1000;
+
+// coarse timers may fire up to 5 % early
+static qint64 atLeast(int interval) {
+    return interval * 95 / 100;
+}
+
+class DebouncerTest : public QObject {
+    Q_OBJECT
+
+private slots:
+    void testSingleTrigger() {
+        Debouncer debouncer(QUIET_PERIOD, MAX_LATENCY);
+        QSignalSpy spy(&debouncer, &Debouncer::timeout);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        debouncer.trigger();
+
+        QVERIFY(spy.wait(TIMEOUT));
+        QVERIFY(timer.elapsed() >= atLeast(QUIET_PERIOD));
+
+        // the max latency timer must have been stopped, too
+        QTest::qWait(MAX_LATENCY);
+        QCOMPARE(spy.count(), 1);
+    }
+
+    void testTriggerExtendsQuietPeriod() {
+        Debouncer debouncer(QUIET_PERIOD, 10 * MAX_LATENCY);
+        QSignalSpy spy(&debouncer, &Debouncer::timeout);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        for (int i = 0; i < 5; ++i) {
+            debouncer.trigger();
+            QTest::qWait(QUIET_PERIOD / 2);
+        }
+
+        const auto lastTrigger = timer.elapsed();
+        debouncer.trigger();
+
+        // a burst results in a single timeout, after the last trigger
+        QVERIFY(spy.wait(TIMEOUT));
+        QCOMPARE(spy.count(), 1);
+        QVERIFY(timer.elapsed() >= lastTrigger + atLeast(QUIET_PERIOD));
+    }
+
+    void testMaxLatency() {
+        Debouncer debouncer(QUIET_PERIOD, MAX_LATENCY);
+        QSignalSpy spy(&debouncer, &Debouncer::timeout);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // the quiet period never elapses during this burst
+        while (spy.count() == 0 && timer.elapsed() < TIMEOUT) {
+            debouncer.trigger();
+            QTest::qWait(QUIET_PERIOD / 4);
+        }
+
+        QCOMPARE(spy.count(), 1);
+        QVERIFY(timer.elapsed() >= atLeast(MAX_LATENCY));
+
+        // the max latency is counted from the first trigger after the timeout
+        timer.restart();
+
+        while (spy.count() == 1 && timer.elapsed() < TIMEOUT) {
+            debouncer.trigger();
+            QTest::qWait(QUIET_PERIOD / 4);
+        }
+
+        QCOMPARE(spy.count(), 2);
+        QVERIFY(timer.elapsed() >= atLeast(MAX_LATENCY));
+    }
+
+    void testStop() {
+        Debouncer debouncer(QUIET_PERIOD, MAX_LATENCY);
+        QSignalSpy spy(&debouncer, &Debouncer::timeout);
+
+        debouncer.trigger();
+        debouncer.stop();
+
+        QTest::qWait(2 * MAX_LATENCY);
+        QCOMPARE(spy.count(), 0);
+    }
+
+    void testMaxLatencyIsNotShorterThanQuietPeriod() {
+        Debouncer debouncer(QUIET_PERIOD, 0);
+        QSignalSpy spy(&debouncer, &Debouncer::timeout);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        debouncer.trigger();
+
+        QVERIFY(spy.wait(TIMEOUT));
+        QVERIFY(timer.elapsed() >= atLeast(QUIET_PERIOD));
+    }
+};
+
+QTEST_GUILESS_MAIN(DebouncerTest)
+
+#include "test_debouncer.moc"
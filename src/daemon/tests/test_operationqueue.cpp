@@ -0,0 +1,142 @@
+// system includes
+#include <memory>
+
+// library includes
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// local includes
+#include "metadataindex.h"
+#include "operationqueue.h"
+
+class OperationQueueTest : public QObject {
+    Q_OBJECT
+
+private:
+    QTemporaryDir tempDir;
+    std::shared_ptr<AppImageMetadataIndex> index;
+
+    // paths of AppImages which are integrated according to the index
+    QString registeredPath;
+    QString unregisteredPath;
+
+    static QList<Operation> operations(const OperationQueue& queue) {
+        QList<Operation> rv;
+
+        for (const auto& operation : queue) {
+            rv << operation;
+        }
+
+        return rv;
+    }
+
+private slots:
+    void initTestCase() {
+        QVERIFY(tempDir.isValid());
+
+        index = std::make_shared<AppImageMetadataIndex>(tempDir.filePath("index.json"));
+        index->setAutoSave(false);
+
+        registeredPath = tempDir.filePath("registered.AppImage");
+        unregisteredPath = tempDir.filePath("unregistered.AppImage");
+
+        for (const auto& path : {registeredPath, unregisteredPath}) {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+        }
+
+        AppImageMetadata metadata;
+        metadata.path = registeredPath;
+        metadata.type = 2;
+        metadata.registered = true;
+        QVERIFY(index->update(metadata));
+
+        metadata.path = unregisteredPath;
+        metadata.registered = false;
+        QVERIFY(index->update(metadata));
+    }
+
+    void testOperationsKeepTheirOrder() {
+        OperationQueue queue(index);
+
+        QVERIFY(queue.schedule({"/a", INTEGRATE}));
+        QVERIFY(queue.schedule({"/b", UNINTEGRATE}));
+        QVERIFY(queue.schedule({"/c", INTEGRATE}));
+
+        QCOMPARE(operations(queue), (QList<Operation>{{"/a", INTEGRATE}, {"/b", UNINTEGRATE}, {"/c", INTEGRATE}}));
+    }
+
+    void testDuplicatesAreDropped() {
+        OperationQueue queue(index);
+
+        QVERIFY(queue.schedule({"/a", INTEGRATE}));
+        QVERIFY(queue.schedule({"/b", INTEGRATE}));
+        QVERIFY(!queue.schedule({"/a", INTEGRATE}));
+
+        // the duplicate doesn't move the pending operation to the end
+        QCOMPARE(operations(queue), (QList<Operation>{{"/a", INTEGRATE}, {"/b", INTEGRATE}}));
+    }
+
+    void testRemovalCancelsIntegrationOfUnknownFile() {
+        OperationQueue queue(index);
+
+        QVERIFY(queue.schedule({unregisteredPath, INTEGRATE}));
+        QVERIFY(queue.schedule({"/other", INTEGRATE}));
+        QVERIFY(!queue.schedule({unregisteredPath, UNINTEGRATE}));
+
+        QCOMPARE(operations(queue), (QList<Operation>{{"/other", INTEGRATE}}));
+
+        // files which are not in the index at all haven't been integrated either
+        QVERIFY(queue.schedule({"/missing", INTEGRATE}));
+        QVERIFY(!queue.schedule({"/missing", UNINTEGRATE}));
+
+        QCOMPARE(queue.size(), size_t(1));
+    }
+
+    void testRemovalReplacesIntegrationOfRegisteredFile() {
+        OperationQueue queue(index);
+
+        QVERIFY(queue.schedule({registeredPath, INTEGRATE}));
+        QVERIFY(queue.schedule({"/other", INTEGRATE}));
+        QVERIFY(queue.schedule({registeredPath, UNINTEGRATE}));
+
+        // the replacement is moved to the end of the queue
+        QCOMPARE(operations(queue), (QList<Operation>{{"/other", INTEGRATE}, {registeredPath, UNINTEGRATE}}));
+    }
+
+    void testIntegrationReplacesRemoval() {
+        OperationQueue queue(index);
+
+        QVERIFY(queue.schedule({"/a", UNINTEGRATE}));
+        QVERIFY(queue.schedule({"/b", UNINTEGRATE}));
+        QVERIFY(queue.schedule({"/a", INTEGRATE}));
+
+        QCOMPARE(operations(queue), (QList<Operation>{{"/b", UNINTEGRATE}, {"/a", INTEGRATE}}));
+    }
+
+    void testErase() {
+        OperationQueue queue(index);
+
+        QVERIFY(queue.schedule({"/a", INTEGRATE}));
+        QVERIFY(queue.schedule({"/b", INTEGRATE}));
+
+        const auto next = queue.erase(queue.begin());
+        QVERIFY(next != queue.end());
+        QCOMPARE(*next, (Operation{"/b", INTEGRATE}));
+
+        // once an operation has been taken from the queue, the same operation can be scheduled again
+        QVERIFY(queue.schedule({"/a", INTEGRATE}));
+        QCOMPARE(operations(queue), (QList<Operation>{{"/b", INTEGRATE}, {"/a", INTEGRATE}}));
+
+        while (!queue.empty()) {
+            queue.erase(queue.begin());
+        }
+
+        QCOMPARE(queue.size(), size_t(0));
+    }
+};
+
+QTEST_GUILESS_MAIN(OperationQueueTest)
+
+#include "test_operationqueue.moc"
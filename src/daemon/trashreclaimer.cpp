@@ -0,0 +1,115 @@
+// system includes
+#include <atomic>
+#include <iostream>
+extern "C" {
+    #include <sched.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+}
+
+// library includes
+#include <QRunnable>
+#include <QThreadPool>
+#include <QTimer>
+
+// local includes
+#include "trashreclaimer.h"
+#include "metrics.h"
+#include "trashbin.h"
+
+// C++11 requires definitions for static constexpr members
+constexpr int TrashReclaimer::DEFAULT_INTERVAL;
+constexpr int TrashReclaimer::FILES_PER_RUN;
+constexpr int TrashReclaimer::CONTINUATION_DELAY;
+
+// glibc doesn't provide wrappers nor constants for ioprio_set, see ioprio_set(2)
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+
+class TrashReclaimer::PrivateData {
+public:
+    QTimer timer;
+
+    // a single thread is enough, removing files in parallel would just compete for the same disk
+    QThreadPool threadPool;
+
+    std::atomic<bool> running{false};
+    std::atomic<bool> rerunRequested{false};
+
+    class ReclaimTask : public QRunnable {
+    private:
+        TrashReclaimer* reclaimer;
+
+    public:
+        explicit ReclaimTask(TrashReclaimer* reclaimer) : reclaimer(reclaimer) {}
+
+        void run() override {
+            lowerPriorityOfCurrentThread();
+
+            int filesLeft;
+
+            {
+                MetricsTimer timer("trash.reclaim");
+
+                // the policy is read from the config every time, so changes apply without restarting the daemon
+                TrashBin bin;
+                filesLeft = bin.cleanUpIncrementally(FILES_PER_RUN);
+            }
+
+            // notify the reclaimer in its own thread
+            QMetaObject::invokeMethod(reclaimer, "runFinished", Qt::QueuedConnection, Q_ARG(int, filesLeft));
+        }
+
+    private:
+        // on Linux, both calls apply to the calling thread only, the rest of the daemon is not affected
+        // failures are not fatal, the files are removed either way
+        static void lowerPriorityOfCurrentThread() {
+            sched_param param{};
+            param.sched_priority = 0;
+
+            if (sched_setscheduler(0, SCHED_IDLE, &param) != 0)
+                std::cerr << "Warning: failed to set CPU scheduling policy of trash bin cleanup" << std::endl;
+
+            if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0)
+                std::cerr << "Warning: failed to set I/O priority of trash bin cleanup" << std::endl;
+        }
+    };
+
+public:
+    PrivateData() {
+        threadPool.setMaxThreadCount(1);
+        timer.setInterval(DEFAULT_INTERVAL);
+    }
+};
+
+TrashReclaimer::TrashReclaimer(QObject* parent) : QObject(parent), d(std::make_shared<PrivateData>()) {
+    connect(&d->timer, &QTimer::timeout, this, &TrashReclaimer::reclaim);
+}
+
+void TrashReclaimer::start() {
+    d->timer.start();
+    reclaim();
+}
+
+void TrashReclaimer::reclaim() {
+    if (d->running.exchange(true)) {
+        d->rerunRequested = true;
+        return;
+    }
+
+    d->threadPool.start(new PrivateData::ReclaimTask(this));
+}
+
+void TrashReclaimer::runFinished(int filesLeft) {
+    d->running = false;
+
+    const auto rerunRequested = d->rerunRequested.exchange(false);
+
+    // the remaining files are removed in subsequent runs, which gives other processes a chance to access the disk
+    if (filesLeft > 0) {
+        QTimer::singleShot(CONTINUATION_DELAY, this, &TrashReclaimer::reclaim);
+    } else if (rerunRequested) {
+        reclaim();
+    }
+}
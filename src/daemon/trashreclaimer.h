@@ -0,0 +1,39 @@
+// system includes
+#include <memory>
+
+// library includes
+#include <QObject>
+
+#pragma once
+
+// removes the expired files from the trash bin in the background
+// large AppImages can take a while to be removed, therefore this is done incrementally, at idle CPU and I/O priority
+class TrashReclaimer : public QObject {
+    Q_OBJECT
+
+private:
+    class PrivateData;
+    std::shared_ptr<PrivateData> d = nullptr;
+
+public:
+    // interval in which the trash bin is checked for expired files (in ms)
+    static constexpr int DEFAULT_INTERVAL = 10 * 60 * 1000;
+
+    // number of files removed per run, and the delay before the next run if there are files left (in ms)
+    static constexpr int FILES_PER_RUN = 5;
+    static constexpr int CONTINUATION_DELAY = 1000;
+
+public:
+    explicit TrashReclaimer(QObject* parent = nullptr);
+
+    // starts checking the trash bin regularly, the first run is started right away
+    void start();
+
+public slots:
+    // starts a run in the background, unless one is running already (in which case another run follows that one)
+    // returns immediately
+    void reclaim();
+
+private slots:
+    void runFinished(int filesLeft);
+};
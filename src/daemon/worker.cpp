@@ -1,54 +1,110 @@
 // system includes
+#include <algorithm>
 #include <atomic>
 #include <iostream>
-#include <deque>
+#include <memory>
 
 // library includes
 #include <QDebug>
 #include <QFile>
 #include <QObject>
+#include <QSet>
 #include <QSysInfo>
-#include <QTimer>
 #include <QThreadPool>
 #include <QMutexLocker>
 #include <appimage/appimage.h>
 
 // local includes
 #include "worker.h"
+#include "appimagehandle.h"
+#include "debouncer.h"
+#include "desktopintegrationbatch.h"
+#include "metadataindex.h"
+#include "metrics.h"
+#include "operationqueue.h"
 #include "shared.h"
 
-enum OP_TYPE {
-    INTEGRATE = 0,
-    UNINTEGRATE = 1,
-};
-
-typedef std::pair<QString, OP_TYPE> Operation;
+// C++11 requires definitions for static constexpr members
+constexpr int Worker::DEFAULT_QUIET_PERIOD;
+constexpr int Worker::DEFAULT_MAX_LATENCY;
+constexpr int Worker::DEFAULT_MAX_THREAD_COUNT;
 
 class Worker::PrivateData {
 public:
-    QTimer deferredOperationsTimer;
+    // deferred operations are executed once no new operations have been scheduled for a short time
+    // as long as new operations keep coming in, the execution is postponed, but at most until the max latency
+    // has been reached
+    // this way, single AppImages show up in the menu quickly, whereas batches are handled in as few runs as possible
+    Debouncer debouncer{DEFAULT_QUIET_PERIOD, DEFAULT_MAX_LATENCY};
+
+    // set while a startTimer() signal is queued already, so that scheduling a burst of operations posts a single event
+    // to the worker's thread instead of one per operation
+    std::atomic<bool> timerStartPending{false};
+
+    // operations in the order in which they have been scheduled, merged per path
+    OperationQueue deferredOperations;
+
+    // dedicated pool, the global instance's thread count depends on the number of CPU cores, which doesn't make sense
+    // for I/O bound work like ours
+    QThreadPool threadPool;
 
-    static constexpr int TIMEOUT = 15 * 1000;
+    // paths of the operations which are currently being executed by the thread pool
+    // only accessed from the worker's thread
+    QSet<QString> pathsInFlight;
 
-    // std::set is unordered, therefore using std::deque to keep the order of the operations
-    std::deque<Operation> deferredOperations;
+    // the work done at the end of every batch (saving the index, cleaning up, updating the caches, syncing) takes a
+    // while, too, so it's done by a thread of its own
+    QThreadPool finalizationThreadPool;
+
+    // set while a batch is being finalized, new operations are started only once that has finished
+    // only accessed from the worker's thread
+    bool finalizing = false;
+
+    // defers syncing the written files and notifying the desktop environment to the end of the current batch
+    // it also keeps track of the modified desktop integration trees, so that only their caches need to be updated
+    std::unique_ptr<DesktopIntegrationBatch> integrationBatch;
+
+    // serializes the output of the operation tasks
+    std::shared_ptr<QMutex> outputMutex;
 
     class OperationTask : public QRunnable {
     private:
         Operation operation;
         std::shared_ptr<QMutex> mutex;
+        Worker* worker;
 
     public:
-        OperationTask(const Operation& operation, std::shared_ptr<QMutex> mutex) : operation(operation),
-                                                                                   mutex(std::move(mutex)) {}
+        OperationTask(const Operation& operation, std::shared_ptr<QMutex> mutex, Worker* worker) :
+            operation(operation), mutex(std::move(mutex)), worker(worker) {}
 
         void run() override {
+            {
+                MetricsTimer timer(operation.second == INTEGRATE ? "worker.integrate" : "worker.unintegrate");
+                execute();
+            }
+
+            // notify the worker in its own thread
+            QMetaObject::invokeMethod(worker, "operationFinished", Qt::QueuedConnection,
+                                      Q_ARG(QString, operation.first));
+        }
+
+    private:
+        void execute() {
             const auto& path = operation.first;
             const auto& type = operation.second;
 
+            // the file will be renamed once the download is complete, which is reported as a new file
+            if (type == INTEGRATE && isIncompleteDownload(path)) {
+                QMutexLocker mutexLocker(mutex.get());
+                std::cout << "Skipping incomplete download: " << path.toStdString() << std::endl;
+                return;
+            }
+
+            // the information needed for the checks and the integration below is extracted at most once
+            AppImageHandle appImage(path);
+
             const auto exists = QFile::exists(path);
-            const auto appImageType = appimage_get_type(path.toStdString().c_str(), false);
-            const auto isAppImage = 0 < appImageType && appImageType <= 2;
+            const auto isAppImage = appImage.isAppImage();
 
             if (type == INTEGRATE) {
                 {   // Scope for Output Mutex Locker
@@ -60,6 +116,12 @@ public:
                         return;
                     }
 
+                    // as soon as the writer is done, the file system watcher reports the file again
+                    if (appImage.isOpenForWriting()) {
+                        std::cout << "file is still being written, skipping for now" << std::endl;
+                        return;
+                    }
+
                     if (!isAppImage) {
                         std::cout << "ERROR: not an AppImage, skipping" << std::endl;
                         return;
@@ -67,45 +129,79 @@ public:
                 }
 
                 // check for X-AppImage-Integrate=false
-                if (appimage_shall_not_be_integrated(path.toStdString().c_str())) {
+                if (appImage.shallNotBeIntegrated() != 0) {
                     QMutexLocker mutexLocker(mutex.get());
                     std::cout << "WARNING: AppImage shall not be integrated, skipping" << std::endl;
                     return;
                 }
 
-                if (!installDesktopFileAndIcons(path)) {
+                if (!installDesktopFileAndIcons(appImage)) {
                     QMutexLocker mutexLocker(mutex.get());
                     std::cout << "ERROR: Failed to register AppImage in system" << std::endl;
                     return;
                 }
             } else if (type == UNINTEGRATE) {
-                // nothing to do
+                // the desktop integration resources are cleaned up after all operations have been executed
+                // however, the file is gone, so we can forget about it
+                AppImageMetadataIndex::instance()->remove(path);
             }
         }
     };
 
-public:
-    PrivateData() {
-        deferredOperationsTimer.setSingleShot(true);
-        deferredOperationsTimer.setInterval(TIMEOUT);
-    }
+    class FinalizationTask : public QRunnable {
+    private:
+        std::unique_ptr<DesktopIntegrationBatch> integrationBatch;
+        Worker* worker;
 
-public:
-    // in addition to a simple duplicate check, this function is context sensitive
-    // it starts with the last element, and checks for duplicates until an opposite action is found
-    // for instance, when the element shall integrated, it will check for duplicates until an unintegration operation
-    // is found
-    bool isDuplicate(Operation operation) {
-        for (auto it = deferredOperations.rbegin(); it != deferredOperations.rend(); ++it) {
-            if ((*it).first == operation.first) {
-                // if operation type is different, then the operation is new, and should be added to the list
-                // if it is equal, it's a duplicate
-                // in either case, the loop can be aborted here
-                return (*it).second == operation.second;
+    public:
+        FinalizationTask(std::unique_ptr<DesktopIntegrationBatch> integrationBatch, Worker* worker) :
+            integrationBatch(std::move(integrationBatch)), worker(worker) {}
+
+        void run() override {
+            finalize();
+
+            // notify the worker in its own thread
+            QMetaObject::invokeMethod(worker, "batchFinalized", Qt::QueuedConnection);
+        }
+
+    private:
+        void finalize() {
+            if (!AppImageMetadataIndex::instance()->save()) {
+                std::cout << "Failed to save AppImage metadata index" << std::endl;
+            }
+
+            std::cout << "Cleaning up old desktop integration files" << std::endl;
+            if (!cleanUpOldDesktopIntegrationResources(true)) {
+                std::cout << "Failed to clean up old desktop integration files" << std::endl;
+            }
+
+            // make sure the icons in the launcher are refreshed
+            // if the batch didn't change anything (e.g., all AppImages were rejected), there's no need to run the tools
+            const auto changedTrees =
+                integrationBatch != nullptr ? integrationBatch->changedTrees() : ALL_DESKTOP_INTEGRATION_TREES;
+
+            if (changedTrees == 0) {
+                std::cout << "Desktop database and icon caches are up to date" << std::endl;
+            } else {
+                std::cout << "Updating desktop database and icon caches" << std::endl;
+                if (!updateDesktopDatabaseAndIconCaches(changedTrees))
+                    std::cout << "Failed to update desktop database and icon caches" << std::endl;
             }
+
+            // the desktop environment is notified once the caches are up to date
+            if (integrationBatch != nullptr && !integrationBatch->commit())
+                std::cout << "Failed to sync desktop integration files to disk" << std::endl;
+
+            integrationBatch.reset();
+
+            std::cout << "Done" << std::endl;
         }
+    };
 
-        return false;
+public:
+    PrivateData() : outputMutex(std::make_shared<QMutex>()) {
+        threadPool.setMaxThreadCount(DEFAULT_MAX_THREAD_COUNT);
+        finalizationThreadPool.setMaxThreadCount(1);
     }
 };
 
@@ -113,61 +209,115 @@ Worker::Worker() {
     d = std::make_shared<PrivateData>();
 
     connect(this, &Worker::startTimer, this, &Worker::startTimerIfNecessary, Qt::QueuedConnection);
-    connect(&d->deferredOperationsTimer, &QTimer::timeout, this, &Worker::executeDeferredOperations);
+    connect(&d->debouncer, &Debouncer::timeout, this, &Worker::executeDeferredOperations);
+}
+
+void Worker::setDebounceIntervals(int quietPeriod, int maxLatency) {
+    d->debouncer.setIntervals(quietPeriod, maxLatency);
+}
+
+void Worker::setMaxThreadCount(int maxThreadCount) {
+    d->threadPool.setMaxThreadCount(std::max(1, maxThreadCount));
+}
+
+bool Worker::isIdle() const {
+    return !d->finalizing && d->pathsInFlight.empty() && d->deferredOperations.empty();
 }
 
 void Worker::executeDeferredOperations() {
+    // operations might be executed by other means than the timers (e.g., after the initial search), so we have
+    // to make sure they don't fire later on for no reason
+    d->debouncer.stop();
+
     if (d->deferredOperations.empty()) {
         qDebug() << "No deferred operations to execute";
         return;
     }
 
-    std::cout << "Executing deferred operations" << std::endl;
+    // the previous batch's results must have been handled before a new batch is started, see batchFinalized()
+    if (d->finalizing) {
+        qDebug() << "Previous batch is being finalized, deferring operations";
+        return;
+    }
 
-    auto outputMutex = std::make_shared<QMutex>();
+    std::cout << "Executing deferred operations" << std::endl;
 
-    while (!d->deferredOperations.empty()) {
-        auto operation = d->deferredOperations.front();
-        d->deferredOperations.pop_front();
-        QThreadPool::globalInstance()->start(new PrivateData::OperationTask(operation, outputMutex));
+    // new operations may be started while others are still running, in which case they belong to the running batch
+    if (d->pathsInFlight.empty()) {
+        d->integrationBatch.reset(new DesktopIntegrationBatch);
     }
 
-    // wait until all AppImages have been integrated
-    QThreadPool::globalInstance()->waitForDone();
+    for (auto it = d->deferredOperations.begin(); it != d->deferredOperations.end();) {
+        const auto& path = it->first;
 
-    std::cout << "Cleaning up old desktop integration files" << std::endl;
-    if (!cleanUpOldDesktopIntegrationResources(true)) {
-        std::cout << "Failed to clean up old desktop integration files" << std::endl;
+        // two operations on the same path must never run concurrently
+        // the new one stays in the queue and will be executed after the running one has finished
+        if (d->pathsInFlight.contains(path)) {
+            qDebug() << "operation on path in progress already, deferring:" << path;
+            ++it;
+            continue;
+        }
+
+        d->pathsInFlight.insert(path);
+        d->threadPool.start(new PrivateData::OperationTask(*it, d->outputMutex, this));
+
+        it = d->deferredOperations.erase(it);
     }
 
-    // make sure the icons in the launcher are refreshed
-    std::cout << "Updating desktop database and icon caches" << std::endl;
-    if (!updateDesktopDatabaseAndIconCaches())
-        std::cout << "Failed to update desktop database and icon caches" << std::endl;
+    // the results are handled once all operations have finished, see operationFinished()
+}
+
+void Worker::operationFinished(const QString& path) {
+    d->pathsInFlight.remove(path);
+
+    // the desktop database and caches are updated when the last running operation has finished, so that this
+    // happens only once even if new operations are started while others are still running
+    if (!d->pathsInFlight.empty())
+        return;
+
+    Metrics::instance()->increment("worker.batches");
 
-    std::cout << "Done" << std::endl;
+    // the event loop keeps processing file system events and timers in the meantime
+    d->finalizing = true;
+    d->finalizationThreadPool.start(new PrivateData::FinalizationTask(std::move(d->integrationBatch), this));
+}
+
+void Worker::batchFinalized() {
+    d->finalizing = false;
+
+    // operations which had to wait for running ones on the same path, or have been scheduled in the meantime
+    if (!d->deferredOperations.empty())
+        startTimerIfNecessary();
 }
 
 void Worker::scheduleForIntegration(const QString& path) {
+    MetricsTimer timer("worker.schedule");
+
     auto operation = std::make_pair(path, INTEGRATE);
-    if (!d->isDuplicate(operation)) {
+    if (d->deferredOperations.schedule(operation)) {
         std::cout << "Scheduling for (re-)integration: " << path.toStdString() << std::endl;
-        d->deferredOperations.push_back(operation);
-        emit startTimer();
+
+        if (!d->timerStartPending.exchange(true))
+            emit startTimer();
     }
 
 }
 
 void Worker::scheduleForUnintegration(const QString& path) {
+    MetricsTimer timer("worker.schedule");
+
     auto operation = std::make_pair(path, UNINTEGRATE);
-    if (!d->isDuplicate(operation)) {
+    if (d->deferredOperations.schedule(operation)) {
         std::cout << "Scheduling for unintegration: " << path.toStdString() << std::endl;
-        d->deferredOperations.push_back(operation);
-        emit startTimer();
+
+        if (!d->timerStartPending.exchange(true))
+            emit startTimer();
     }
 }
 
 void Worker::startTimerIfNecessary() {
-    if (!d->deferredOperationsTimer.isActive())
-        QMetaObject::invokeMethod(&d->deferredOperationsTimer, "start");
+    d->timerStartPending = false;
+
+    // every new operation extends the quiet period, see Debouncer
+    d->debouncer.trigger();
 }
@@ -13,9 +13,27 @@ private:
     class PrivateData;
     std::shared_ptr<PrivateData> d = nullptr;
 
+public:
+    // default intervals used to debounce scheduled operations (in ms), see setDebounceIntervals()
+    static constexpr int DEFAULT_QUIET_PERIOD = 500;
+    static constexpr int DEFAULT_MAX_LATENCY = 5 * 1000;
+
+    // reading many AppImages in parallel slows down things (e.g., on USB drives), so the default is rather low
+    static constexpr int DEFAULT_MAX_THREAD_COUNT = 2;
+
 public:
     Worker();
 
+    // scheduled operations are executed once no further operations have been scheduled for <quietPeriod> ms,
+    // but no later than <maxLatency> ms after the first operation has been scheduled
+    void setDebounceIntervals(int quietPeriod, int maxLatency);
+
+    // maximum number of operations executed in parallel
+    void setMaxThreadCount(int maxThreadCount);
+
+    // returns true if there are neither scheduled nor running operations
+    bool isIdle() const;
+
 signals:
     void startTimer();
 
@@ -24,8 +42,13 @@ public slots:
     void scheduleForUnintegration(const QString& path);
 
 public slots:
+    // starts executing the scheduled operations in the background
+    // the method returns immediately, the operations' results are handled in the background, too, once all of them
+    // have finished
     void executeDeferredOperations();
 
 private slots:
     void startTimerIfNecessary();
+    void operationFinished(const QString& path);
+    void batchFinalized();
 };
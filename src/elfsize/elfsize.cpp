@@ -0,0 +1,155 @@
+// system headers
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <linux/elf.h>
+#include <byteswap.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+// own headers
+#include "elfsize.h"
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+#define NATIVE_BYTE_ORDER ELFDATA2LSB
+#elif __BYTE_ORDER == __BIG_ENDIAN
+#define NATIVE_BYTE_ORDER ELFDATA2MSB
+#else
+#error "Unknown machine endian"
+#endif
+
+namespace {
+    template<typename T>
+    T bswap(T val) = delete;
+
+    template<>
+    uint16_t bswap(uint16_t val) {
+        return bswap_16(val);
+    }
+
+    template<>
+    uint32_t bswap(uint32_t val) {
+        return bswap_32(val);
+    }
+
+    template<>
+    unsigned long long bswap(unsigned long long val) {
+        return bswap_64(val);
+    }
+
+    template<typename EhdrT, typename ValT>
+    void swap_data_if_necessary(const EhdrT& ehdr, ValT& val) {
+        static_assert(std::is_same<Elf64_Ehdr, EhdrT>::value || std::is_same<Elf32_Ehdr, EhdrT>::value,
+                      "must be Elf{32,64}_Ehdr");
+
+        if (ehdr.e_ident[EI_DATA] != NATIVE_BYTE_ORDER) {
+            val = bswap(val);
+        }
+    }
+
+    // reads exactly size bytes, or fails
+    bool pread_fully(int fd, void* buffer, size_t size, off_t offset) {
+        auto* p = static_cast<char*>(buffer);
+
+        while (size > 0) {
+            const auto rv = pread(fd, p, size, offset);
+
+            if (rv < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            // file too short
+            if (rv == 0) {
+                errno = EINVAL;
+                return false;
+            }
+
+            p += rv;
+            size -= rv;
+            offset += rv;
+        }
+
+        return true;
+    }
+
+    template<typename EhdrT, typename ShdrT>
+    ssize_t get_elf_size(int fd, const unsigned char* header_data) {
+        static_assert(std::is_same<Elf64_Ehdr, EhdrT>::value || std::is_same<Elf32_Ehdr, EhdrT>::value,
+                      "must be Elf{32,64}_Ehdr");
+        static_assert(std::is_same<Elf64_Shdr, ShdrT>::value || std::is_same<Elf32_Shdr, ShdrT>::value,
+                      "must be Elf{32,64}_Shdr");
+
+        EhdrT elf_header{};
+        memcpy(&elf_header, header_data, sizeof(elf_header));
+
+        swap_data_if_necessary(elf_header, elf_header.e_shoff);
+        swap_data_if_necessary(elf_header, elf_header.e_shentsize);
+        swap_data_if_necessary(elf_header, elf_header.e_shnum);
+
+        if (elf_header.e_shnum == 0 || elf_header.e_shentsize < sizeof(ShdrT)) {
+            errno = EINVAL;
+            return -1;
+        }
+
+        const off_t last_shdr_offset = elf_header.e_shoff + (elf_header.e_shentsize * (elf_header.e_shnum - 1));
+        ShdrT section_header{};
+
+        if (!pread_fully(fd, &section_header, sizeof(section_header), last_shdr_offset))
+            return -1;
+
+        swap_data_if_necessary(elf_header, section_header.sh_offset);
+        swap_data_if_necessary(elf_header, section_header.sh_size);
+
+        /* ELF ends either with the table of section headers (SHT) or with a section. */
+        const off_t sht_end = elf_header.e_shoff + (elf_header.e_shentsize * elf_header.e_shnum);
+        const off_t last_section_end = section_header.sh_offset + section_header.sh_size;
+        return sht_end > last_section_end ? sht_end : last_section_end;
+    }
+}
+
+ssize_t elf_binary_size(int fd) {
+    // the 64-bit header is larger than the 32-bit one, so we can read either variant in one go
+    // files too short for a 64-bit header can't contain a valid and useful 32-bit ELF file either
+    unsigned char header_data[sizeof(Elf64_Ehdr)];
+
+    if (!pread_fully(fd, header_data, sizeof(header_data), 0))
+        return -1;
+
+    if (memcmp(header_data, ELFMAG, SELFMAG) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    switch (header_data[EI_CLASS]) {
+        case ELFCLASS32: {
+            return get_elf_size<Elf32_Ehdr, Elf32_Shdr>(fd, header_data);
+        }
+        case ELFCLASS64: {
+            return get_elf_size<Elf64_Ehdr, Elf64_Shdr>(fd, header_data);
+        }
+        default: {
+            errno = EINVAL;
+            return -1;
+        }
+    }
+}
+
+ssize_t elf_binary_size(const char* filename) {
+    const auto fd = open(filename, O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return -1;
+
+    const auto rv = elf_binary_size(fd);
+
+    // make sure close() doesn't clobber the error
+    const auto error = errno;
+    close(fd);
+    errno = error;
+
+    return rv;
+}
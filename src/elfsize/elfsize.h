@@ -0,0 +1,21 @@
+#pragma once
+
+// system headers
+#include <sys/types.h>
+
+/**
+ * Calculate size of ELF binary. Useful e.g., to estimate the size of the runtime in an AppImage.
+ *
+ * Only the ELF header and the last section header are read, using pread(), so the file offset is not modified.
+ *
+ * @param fd file descriptor of ELF file
+ * @return size of ELF part in bytes, or -1 on errors (errno is set to EINVAL if the file is not a valid ELF file)
+ */
+ssize_t elf_binary_size(int fd);
+
+/**
+ * Convenience overload of the function above.
+ * @param filename path to ELF file
+ * @return size of ELF part in bytes, or -1 on errors
+ */
+ssize_t elf_binary_size(const char* filename);
@@ -1,26 +1,41 @@
 // system includes
+#include <algorithm>
+#include <climits>
 #include <iostream>
-#include <map>
+#include <memory>
+#include <vector>
 #include <unistd.h>
 
 // library includes
 #include <QDebug>
 #include <QDir>
+#include <QFileInfo>
+#include <QHash>
 #include <QMutex>
-#include <QTimer>
+#include <QSocketNotifier>
 #include <QThread>
 #include <sys/inotify.h>
 
 // local includes
 #include "filesystemwatcher.h"
+#include "metrics.h"
 
-class INotifyEvent {
+// state of a single inotify watch
+class WatchedDirectory {
 public:
-    uint32_t mask;
-    QString path;
+    // absolute path including the trailing slash, computed once, so that building an event's path takes a single
+    // concatenation
+    QString pathPrefix;
+    // key of the watched directory (in a QDirSet) this watch has been added for, compared when removing watches
+    // subdirectories share the key of the directory they've been found in
+    QString rootKey;
+    // number of levels below the watched directory, 0 for the watched directory itself
+    int depth = 0;
 
 public:
-    INotifyEvent(uint32_t mask, QString path) : mask(mask), path(std::move(path)) {}
+    WatchedDirectory() = default;
+    WatchedDirectory(const QDir& directory, QString rootKey, int depth) : pathPrefix(directory.absolutePath() + "/"),
+        rootKey(std::move(rootKey)), depth(depth) {}
 };
 
 class FileSystemWatcher::PrivateData {
@@ -35,74 +50,152 @@ public:
     // tracks whether the watcher is running
     bool isRunning;
 
+    // number of subdirectory levels to watch below the watched directories, protected by the mutex
+    int recursionDepth = 0;
+
+    // statistics, protected by the mutex
+    quint64 eventsCount = 0;
+    quint64 overflowCount = 0;
+
+    // buffer events are read into, protected by the mutex
+    // it must be able to hold at least a single event with a maximum length name
+    std::vector<char> readBuffer;
+
 public:
     QDirSet watchedDirectories;
-    QTimer eventsLoopTimer;
+    // notifies us whenever the inotify fd becomes readable, i.e., we don't have to poll for events
+    std::unique_ptr<QSocketNotifier> eventsNotifier;
     QMutex* mutex;
 
 private:
     int inotifyFd = -1;
-    std::map<int, QDir> watchFdMap;
+    // maps watch descriptors to the directories they belong to
+    QHash<int, WatchedDirectory> watchFdMap;
 
 public:
-    // reads events from the inotify fd and emits the correct signals
-    std::vector<INotifyEvent> readEventsFromFd() {
+    // reads all pending events from the inotify fd
+    // the fd is drained completely, so that bursts of events are handled in a single run
+    // overflowed is set to true if the kernel had to drop events since the last call
+    FileSystemWatcherEvents readEventsFromFd(bool& overflowed) {
         // we don't want to read events in parallel
         QMutexLocker lock{mutex};
 
+        overflowed = false;
+
         // read raw bytes into buffer
         // this is necessary, as the inotify_events have dynamic sizes
-        static const auto bufSize = 4096;
-        char buffer[bufSize] __attribute__ ((aligned(8)));
+        // memory returned by operator new is suitably aligned for struct inotify_event
+        char* buffer = readBuffer.data();
+        const auto bufSize = readBuffer.size();
 
-        const auto rv = read(inotifyFd, buffer, bufSize);
-        const auto error = errno;
+        FileSystemWatcherEvents events;
 
-        if (rv == 0) {
-            throw FileSystemWatcherError("read() on inotify FD must never return 0");
-        }
+        while (true) {
+            const auto rv = read(inotifyFd, buffer, bufSize);
+            const auto error = errno;
 
-        if (rv == -1) {
-            // we're using a non-blocking inotify fd, therefore, if errno is set to EAGAIN, we just didn't find any
-            // new events
-            // this is not an error case
-            if (error == EAGAIN)
-                return {};
+            if (rv == 0) {
+                throw FileSystemWatcherError("read() on inotify FD must never return 0");
+            }
 
-            throw FileSystemWatcherError(QString("Failed to read from inotify fd: ") + strerror(error));
-        }
+            if (rv == -1) {
+                // we're using a non-blocking inotify fd, therefore, if errno is set to EAGAIN, we have read all
+                // pending events
+                // this is not an error case
+                if (error == EAGAIN)
+                    break;
+
+                if (error == EINTR)
+                    continue;
+
+                throw FileSystemWatcherError(QString("Failed to read from inotify fd: ") + strerror(error));
+            }
+
+            // read events into vector
+            for (char* p = buffer; p < buffer + rv;) {
+                // create inotify_event from current position in buffer
+                auto* currentEvent = (struct inotify_event*) p;
 
-        // read events into vector
-        std::vector<INotifyEvent> events;
+                // update current position in buffer
+                p += sizeof(struct inotify_event) + currentEvent->len;
 
-        for (char* p = buffer; p < buffer + rv;) {
-            // create inotify_event from current position in buffer
-            auto* currentEvent = (struct inotify_event*) p;
+                // the queue overflow event is not associated with any watch (its wd is -1)
+                if (currentEvent->mask & IN_Q_OVERFLOW) {
+                    overflowed = true;
+                    ++overflowCount;
+                    continue;
+                }
+
+                // the kernel has removed the watch, e.g., because the directory has been deleted
+                if (currentEvent->mask & IN_IGNORED) {
+                    watchFdMap.remove(currentEvent->wd);
+                    continue;
+                }
+
+                // events may still arrive for watches we have removed already
+                // constFind() doesn't insert default-constructed entries for unknown watch descriptors
+                const auto directoryIt = watchFdMap.constFind(currentEvent->wd);
 
-            // initialize new INotifyEvent with the data from the currentEvent
-            QString relativePath(currentEvent->name);
-            auto directory = watchFdMap[currentEvent->wd];
-            events.emplace_back(currentEvent->mask, directory.absolutePath() + "/" + relativePath);
+                if (directoryIt == watchFdMap.constEnd())
+                    continue;
+
+                // copy, as the map might be modified below
+                const auto directory = directoryIt.value();
+                const auto path = directory.pathPrefix + QString::fromUtf8(currentEvent->name);
+
+                // directories are never reported as changed or removed files
+                if (currentEvent->mask & IN_ISDIR) {
+                    handleSubdirectoryEvent(currentEvent->mask, directory, path, events);
+                    continue;
+                }
 
-            // update current position in buffer
-            p += sizeof(struct inotify_event) + currentEvent->len;
+                FileSystemWatcherEvent::Type type;
+
+                if (currentEvent->mask & fileChangeEvents) {
+                    type = FileSystemWatcherEvent::FILE_CHANGED;
+                } else if (currentEvent->mask & fileRemovalEvents) {
+                    type = FileSystemWatcherEvent::FILE_REMOVED;
+                } else {
+                    continue;
+                }
+
+                ++eventsCount;
+
+                events.push_back({type, path});
+            }
         }
 
         return events;
     }
 
-    PrivateData() : isRunning(false), watchedDirectories(), mutex(new QMutex) {
+    PrivateData() : isRunning(false), readBuffer(DEFAULT_READ_BUFFER_SIZE), watchedDirectories(), mutex(new QMutex) {
         inotifyFd = inotify_init1(IN_NONBLOCK);
 
         if (inotifyFd < 0) {
             auto error = errno;
             throw FileSystemWatcherError(QString("Failed to initialize inotify, reason: ") + strerror(error));
         }
+
+        // the notifier is enabled once the first directory is watched
+        eventsNotifier.reset(new QSocketNotifier(inotifyFd, QSocketNotifier::Read));
+        eventsNotifier->setEnabled(false);
     };
 
     // caution: method is not threadsafe!
-    bool startWatching(const QDir& directory) {
-        static const auto mask = fileChangeEvents | fileRemovalEvents;
+    // watches the directory and, in recursive mode, its subdirectories
+    // if foundFiles is passed, events for the files found in the subdirectories are appended, which is needed when
+    // a directory appears while the watcher is running (it may contain files already, e.g., when it's moved in)
+    bool startWatching(const QDir& directory, const QString& rootKey, int depth,
+                       FileSystemWatcherEvents* foundFiles = nullptr) {
+        auto mask = fileChangeEvents | fileRemovalEvents;
+
+        // subdirectories which are created need to be watched, too
+        if (depth < recursionDepth)
+            mask |= IN_CREATE;
+
+        // symlinks are not followed, as they could create loops
+        if (depth > 0)
+            mask |= IN_ONLYDIR | IN_DONT_FOLLOW;
 
         qDebug() << "start watching directory " << directory;
 
@@ -119,10 +212,58 @@ public:
             return false;
         }
 
-        watchFdMap[watchFd] = directory;
-        eventsLoopTimer.start();
+        // inotify returns the same watch descriptor for the same inode, e.g., if a watched directory is a
+        // subdirectory of another watched directory, or is bind mounted somewhere below it
+        // in that case, we keep the existing entry, and don't descend into it again, which could end in a loop
+        // watching a directory again (e.g., after an overflow) is fine, though, it may have new subdirectories
+        const auto existing = watchFdMap.constFind(watchFd);
 
-        return true;
+        if (existing == watchFdMap.constEnd()) {
+            watchFdMap.insert(watchFd, WatchedDirectory(directory, rootKey, depth));
+        } else if (existing->pathPrefix != directory.absolutePath() + "/") {
+            return true;
+        }
+
+        eventsNotifier->setEnabled(true);
+
+        if (depth >= recursionDepth && foundFiles == nullptr)
+            return true;
+
+        bool rv = true;
+
+        const auto filters = QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks | QDir::Hidden;
+
+        for (const auto& entry : directory.entryInfoList(filters)) {
+            if (entry.isDir()) {
+                if (depth < recursionDepth)
+                    rv = startWatching(QDir(entry.absoluteFilePath()), rootKey, depth + 1, foundFiles) && rv;
+            } else if (foundFiles != nullptr) {
+                foundFiles->push_back({FileSystemWatcherEvent::FILE_CHANGED, entry.absoluteFilePath()});
+            }
+        }
+
+        return rv;
+    }
+
+    bool startWatching(const QDir& directory) {
+        return startWatching(directory, QDirSet::keyFor(directory), 0);
+    }
+
+    // caution: method is not threadsafe!
+    // keeps the watches in sync with the directory tree in recursive mode
+    void handleSubdirectoryEvent(uint32_t mask, const WatchedDirectory& parent, const QString& path,
+                                 FileSystemWatcherEvents& events) {
+        // directories which are deleted are taken care of by the IN_IGNORED events the kernel sends for their
+        // watches, but moving a directory elsewhere doesn't remove any watches
+        // in case it has been moved within the watched tree, it is watched again with its new path below
+        if (mask & IN_MOVED_FROM)
+            stopWatchingSubtree(path + "/");
+
+        if ((mask & (IN_CREATE | IN_MOVED_TO)) && parent.depth < recursionDepth) {
+            if (!startWatching(QDir(path), parent.rootKey, parent.depth + 1, &events)) {
+                std::cerr << "Warning: failed to watch new subdirectory " << path.toStdString() << std::endl;
+            }
+        }
     }
 
     bool startWatching() {
@@ -152,7 +293,7 @@ public:
     bool stopWatching(int watchFd) {
         // no matter whether the watch removal succeeds, retrying to remove the watch won't help
         // therefore, we can remove the file descriptor from the map in any case
-        watchFdMap.erase(watchFd);
+        watchFdMap.remove(watchFd);
 
         qDebug() << "stop watching watchfd " << watchFd;
 
@@ -165,12 +306,25 @@ public:
         return true;
     }
 
+    // caution: method is not threadsafe!
+    void stopWatchingSubtree(const QString& pathPrefix) {
+        std::vector<int> watchFdsToRemove;
+
+        for (auto it = watchFdMap.constBegin(); it != watchFdMap.constEnd(); ++it) {
+            if (it->pathPrefix.startsWith(pathPrefix))
+                watchFdsToRemove.push_back(it.key());
+        }
+
+        for (const auto watchFd : watchFdsToRemove) {
+            stopWatching(watchFd);
+        }
+    }
+
     bool stopWatching() {
         QMutexLocker lock{mutex};
 
-        while (!watchFdMap.empty()) {
-            const auto pair = *(watchFdMap.begin());
-            const auto watchFd = pair.first;
+        while (!watchFdMap.isEmpty()) {
+            const auto watchFd = watchFdMap.constBegin().key();
 
             if (!stopWatching(watchFd)) {
                 std::cerr << "Warning: Failed to stop watching on file descriptor " << watchFd << std::endl;
@@ -183,28 +337,33 @@ public:
     bool stopWatching(const QDirSet& directories) {
         QMutexLocker lock{mutex};
 
-        for (const auto& directory : directories) {
-            for (const auto& pair : watchFdMap) {
-                if (pair.second == directory) {
-                    if (!stopWatching(pair.first)) {
-                        return false;
-                    }
-                }
-            }
+        // stopWatching(int) modifies the map, so we have to collect the watch fds first
+        std::vector<int> watchFdsToRemove;
 
-            // reaching the following line means that we couldn't find the requested path in the fd map
-            return false;
+        // the keys have been computed when the watches were added, so we don't have to canonicalize any paths here
+        for (auto it = watchFdMap.constBegin(); it != watchFdMap.constEnd(); ++it) {
+            if (directories.containsKey(it->rootKey))
+                watchFdsToRemove.push_back(it.key());
         }
 
-        return true;
+        bool rv = true;
+
+        for (const auto watchFd : watchFdsToRemove) {
+            rv = stopWatching(watchFd) && rv;
+        }
+
+        return rv;
     }
 };
 
 FileSystemWatcher::FileSystemWatcher() {
     d = std::make_shared<PrivateData>();
 
-    d->eventsLoopTimer.setInterval(100);
-    connect(&d->eventsLoopTimer, &QTimer::timeout, this, &FileSystemWatcher::readEvents);
+    // required to deliver eventsReceived() via queued connections
+    qRegisterMetaType<FileSystemWatcherEvents>("FileSystemWatcherEvents");
+
+    // Qt 5.15 overloads activated(), so we have to use the old style syntax to stay compatible with older versions
+    connect(d->eventsNotifier.get(), SIGNAL(activated(int)), this, SLOT(readEvents()));
 }
 
 FileSystemWatcher::FileSystemWatcher(const QDir& path) : FileSystemWatcher() {
@@ -262,71 +421,82 @@ bool FileSystemWatcher::stopWatching() {
             d->isRunning = false;
 
             // we can stop reporting events now, I guess
-            d->eventsLoopTimer.stop();
+            d->eventsNotifier->setEnabled(false);
         }
     }
 
     return rv;
 }
 
-void FileSystemWatcher::readEvents() {
-    auto events = d->readEventsFromFd();
+void FileSystemWatcher::setRecursionDepth(int depth) {
+    QMutexLocker lock{d->mutex};
+    d->recursionDepth = std::max(0, depth);
+}
+
+int FileSystemWatcher::recursionDepth() {
+    QMutexLocker lock{d->mutex};
+    return d->recursionDepth;
+}
 
-    for (const auto& event : events) {
-        const auto mask = event.mask;
+void FileSystemWatcher::setReadBufferSize(size_t size) {
+    QMutexLocker lock{d->mutex};
 
-        if (mask & d->fileChangeEvents) {
-            emit fileChanged(event.path);
-        } else if (mask & d->fileRemovalEvents) {
-            emit fileRemoved(event.path);
-        }
-    }
+    static constexpr size_t minimumSize = sizeof(struct inotify_event) + NAME_MAX + 1;
+
+    d->readBuffer.resize(std::max(size, minimumSize));
 }
 
-bool FileSystemWatcher::updateWatchedDirectories(QDirSet watchedDirectories) {
-    // the list may contain entries for directories which don't exist already, therefore we have to remove those first
-    // so when they'll be created, we'll notice
+quint64 FileSystemWatcher::eventsCount() {
+    QMutexLocker lock{d->mutex};
+    return d->eventsCount;
+}
+
+quint64 FileSystemWatcher::overflowCount() {
+    QMutexLocker lock{d->mutex};
+    return d->overflowCount;
+}
+
+void FileSystemWatcher::readEvents() {
+    bool overflowed;
+
+    FileSystemWatcherEvents events;
+
     {
-        // erase-remove doesn't work with sets apparently (see https://stackoverflow.com/a/26833313)
-        // therefore we use a simple custom algorithm
-        auto it = watchedDirectories.begin();
-        while (it != watchedDirectories.end()) {
-            if (!it->exists()) {
-                it = watchedDirectories.erase(it);
-            } else {
-                ++it;
-            }
-        }
+        MetricsTimer timer("inotify.drain");
+        events = d->readEventsFromFd(overflowed);
     }
 
-    auto setDifference = [](const QDirSet& toExamine, const QDirSet& toSearchFor) -> QDirSet {
-        QDirSet results;
+    // a single signal per drain, no matter how many events have been read
+    // this keeps the overhead of queued connections constant during bursts
+    if (!events.empty())
+        emit eventsReceived(events);
 
-        // QDir behaves weirdly with STL algorithm comparisons etc.
-        // therefore we implement this difference algorithm all by ourselves to make sure it works correctly
-        for (const auto& examined : toExamine) {
-            bool found = false;
+    // the kernel doesn't tell us which watches dropped events, so all directories need to be rescanned
+    if (overflowed) {
+        std::cerr << "Warning: inotify event queue overflowed, events have been lost" << std::endl;
 
-            for (const auto& searched : toSearchFor) {
-                if (searched == examined) {
-                    found = true;
-                    break;
-                }
-            }
-
-            if (!found) {
-                results.insert(examined);
-            }
+        // the lost events may include the creation of subdirectories, which need to be watched
+        if (recursionDepth() > 0 && !d->startWatching()) {
+            std::cerr << "Warning: failed to watch subdirectories after overflow" << std::endl;
         }
 
-        return results;
-    };
+        emit directoriesNeedRescan(directories());
+    }
+}
+
+bool FileSystemWatcher::updateWatchedDirectories(QDirSet watchedDirectories) {
+    // the list may contain entries for directories which don't exist already, therefore we have to remove those first
+    // so when they'll be created, we'll notice
+    watchedDirectories.removeIf([](const QDir& dir) {
+        return !dir.exists();
+    });
 
     // first, we calculate which directores are new to be watched
-    QDirSet newDirectories = setDifference(watchedDirectories, d->watchedDirectories);
+    // both sets are sorted by their keys, so the differences can be calculated in linear time
+    QDirSet newDirectories = watchedDirectories.difference(d->watchedDirectories);
 
     // to stop watching with a fine granularity, we also need to know which directories have been removed
-    QDirSet disappearedDirectories = setDifference(d->watchedDirectories, watchedDirectories);
+    QDirSet disappearedDirectories = d->watchedDirectories.difference(watchedDirectories);
 
     {
         QMutexLocker lock{d->mutex};
@@ -342,9 +512,8 @@ bool FileSystemWatcher::updateWatchedDirectories(QDirSet watchedDirectories) {
 
     // we must run both stop and start methods, so we cannot directly return false if either fails
     // also, this makes sure the signals are sent even in case either of the following methods fails
-    bool rv = true;
-    rv = rv && d->stopWatching(disappearedDirectories);
-    rv = rv && d->startWatching(newDirectories);
+    bool rv = d->stopWatching(disappearedDirectories);
+    rv = d->startWatching(newDirectories) && rv;
 
     // send out the signals for further handling by users of a fs watcher instance
     emit newDirectoriesToWatch(newDirectories);
@@ -2,9 +2,11 @@
 #include <algorithm>
 #include <memory>
 #include <unordered_set>
+#include <vector>
 
 // library includes
 #include <QDir>
+#include <QMetaType>
 #include <QObject>
 #include <QSet>
 #include <QString>
@@ -20,6 +22,21 @@ public:
     explicit FileSystemWatcherError(const QString& message) : std::runtime_error(message.toStdString().c_str()) {};
 };
 
+// a change of a file in one of the watched directories
+struct FileSystemWatcherEvent {
+    enum Type {
+        FILE_CHANGED = 0,
+        FILE_REMOVED,
+    };
+
+    Type type;
+    QString path;
+};
+
+typedef std::vector<FileSystemWatcherEvent> FileSystemWatcherEvents;
+
+Q_DECLARE_METATYPE(FileSystemWatcherEvents)
+
 class FileSystemWatcher : public QObject {
     Q_OBJECT
 
@@ -38,12 +55,33 @@ public slots:
     void readEvents();
     bool updateWatchedDirectories(QDirSet watchedDirectories);
 
+public:
+    // default size of the buffer the inotify events are read into
+    static constexpr size_t DEFAULT_READ_BUFFER_SIZE = 64 * 1024;
+
 public:
     QDirSet directories();
 
+    // number of subdirectory levels watched below the watched directories, 0 (the default) disables recursion
+    // subdirectories are watched as they appear, and events for files found in new subdirectories are reported
+    // must be set before the watching is started
+    void setRecursionDepth(int depth);
+    int recursionDepth();
+
+    // larger buffers reduce the amount of read() calls needed to handle bursts of events
+    void setReadBufferSize(size_t size);
+
+    // statistics, useful for diagnostics
+    // the overflow count is the number of times the kernel's event queue overflowed, i.e., events have been lost
+    quint64 eventsCount();
+    quint64 overflowCount();
+
 signals:
-    void fileChanged(QString path);
-    void fileRemoved(QString path);
+    // all events read in one go, in the order in which they have occurred
+    // there is a single signal per drain, so the overhead of queued connections doesn't grow with the number of events
+    void eventsReceived(FileSystemWatcherEvents events);
     void newDirectoriesToWatch(QDirSet set);
     void directoriesToWatchDisappeared(QDirSet set);
+    // emitted when events have been lost, the directories need to be rescanned to catch up with their contents
+    void directoriesNeedRescan(QDirSet set);
 };
@@ -0,0 +1,92 @@
+// system includes
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <unistd.h>
+
+// library includes
+#include <QDebug>
+#include <QSocketNotifier>
+
+// local includes
+#include "mountwatcher.h"
+#include "shared.h"
+
+class MountWatcher::PrivateData {
+public:
+    int mountTableFd = -1;
+
+    // POLLPRI is reported as an exception by Qt
+    std::unique_ptr<QSocketNotifier> notifier;
+
+    QSet<QString> locations;
+
+public:
+    ~PrivateData() {
+        if (mountTableFd >= 0)
+            close(mountTableFd);
+    }
+};
+
+MountWatcher::MountWatcher() : d(std::make_shared<PrivateData>()) {}
+
+QSet<QString> MountWatcher::locations() const {
+    return d->locations;
+}
+
+bool MountWatcher::startWatching() {
+    if (d->notifier != nullptr) {
+        qDebug() << "tried to start mount watcher while it's running already";
+        return true;
+    }
+
+    d->mountTableFd = open("/proc/self/mounts", O_RDONLY | O_CLOEXEC);
+
+    if (d->mountTableFd < 0) {
+        std::cerr << "Failed to open mount table: " << strerror(errno) << std::endl;
+        return false;
+    }
+
+    // the fd has been opened already, so changes made while the baseline is calculated are reported, too
+    d->locations = additionalAppImagesLocations(true);
+
+    d->notifier.reset(new QSocketNotifier(d->mountTableFd, QSocketNotifier::Exception));
+    connect(d->notifier.get(), SIGNAL(activated(int)), this, SLOT(readMountTable()));
+
+    return true;
+}
+
+bool MountWatcher::stopWatching() {
+    d->notifier.reset();
+
+    if (d->mountTableFd >= 0) {
+        close(d->mountTableFd);
+        d->mountTableFd = -1;
+    }
+
+    return true;
+}
+
+void MountWatcher::readMountTable() {
+    // the kernel resets the POLLPRI state when the change is reported, so we just have to read the current table
+    // listMounts() parses the table from a separate file descriptor
+    auto currentLocations = additionalAppImagesLocations(true);
+
+    QSet<QString> addedLocations = currentLocations;
+    addedLocations.subtract(d->locations);
+
+    QSet<QString> removedLocations = d->locations;
+    removedLocations.subtract(currentLocations);
+
+    d->locations = std::move(currentLocations);
+
+    if (addedLocations.isEmpty() && removedLocations.isEmpty()) {
+        qDebug() << "mount table changed, but AppImage locations are unchanged";
+        return;
+    }
+
+    qDebug() << "AppImage locations changed, added:" << addedLocations << "removed:" << removedLocations;
+
+    emit locationsChanged(addedLocations, removedLocations);
+}
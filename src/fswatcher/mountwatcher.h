@@ -0,0 +1,44 @@
+// system includes
+#include <memory>
+
+// library includes
+#include <QObject>
+#include <QSet>
+#include <QString>
+
+#pragma once
+
+/**
+ * Watches the mount table, and reports changes of the AppImage locations on mounted filesystems (see
+ * additionalAppImagesLocations()).
+ *
+ * The kernel signals changes of the mount table by raising POLLPRI on /proc/self/mounts, so there is no need to poll
+ * the table regularly. Whenever it has changed, the locations are calculated again and compared to the previous
+ * ones. The signal is emitted only if any of those locations have actually been added or removed, e.g., because a
+ * USB drive has been plugged in.
+ */
+class MountWatcher : public QObject {
+    Q_OBJECT
+
+private:
+    class PrivateData;
+    std::shared_ptr<PrivateData> d;
+
+public:
+    MountWatcher();
+
+public:
+    // AppImage locations on the filesystems mounted when the mount table has last been read
+    // the table is read for the first time when the watching is started
+    QSet<QString> locations() const;
+
+public slots:
+    bool startWatching();
+    bool stopWatching();
+
+private slots:
+    void readMountTable();
+
+signals:
+    void locationsChanged(QSet<QString> addedLocations, QSet<QString> removedLocations);
+};
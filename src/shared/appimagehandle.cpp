@@ -0,0 +1,240 @@
+// system headers
+#include <cerrno>
+#include <cstring>
+#include <memory>
+extern "C" {
+    #include <appimage/appimage.h>
+    #include <fcntl.h>
+    #include <glib.h>
+    #include <unistd.h>
+}
+
+// library headers
+#include <QDebug>
+
+// local headers
+#include "appimagehandle.h"
+
+// the magic bytes identifying AppImages, see the AppImage specification
+static constexpr off_t APPIMAGE_MAGIC_OFFSET = 8;
+static const char APPIMAGE_MAGIC[] = {'A', 'I'};
+
+// every AppImage starts with an ELF binary, the runtime
+static const char ELF_MAGIC[] = {'\x7f', 'E', 'L', 'F'};
+
+// type 1 AppImages without magic bytes are ISO 9660 images, whose volume descriptor contains this identifier
+static constexpr off_t ISO9660_MAGIC_OFFSET = 32769;
+static const char ISO9660_MAGIC[] = {'C', 'D', '0', '0', '1'};
+
+// reads a boolean-ish value from the desktop entry, with the same semantics as libappimage (i.e., the value is
+// compared to the expected one ignoring case and surrounding whitespace)
+// returns 1 if the value equals the expected one, 0 if not (or the key is missing), < 0 on errors
+static int desktopEntryValueEquals(const QByteArray& desktopEntry, const char* key, const char* expectedValue) {
+    std::unique_ptr<GKeyFile, void (*)(GKeyFile*)> keyFile(g_key_file_new(), g_key_file_free);
+
+    if (!g_key_file_load_from_data(keyFile.get(), desktopEntry.constData(), static_cast<gsize>(desktopEntry.size()),
+                                   G_KEY_FILE_NONE, nullptr)) {
+        return -1;
+    }
+
+    auto* value = g_key_file_get_value(keyFile.get(), G_KEY_FILE_DESKTOP_GROUP, key, nullptr);
+
+    if (value == nullptr)
+        return 0;
+
+    const auto rv = QString(value).trimmed().compare(expectedValue, Qt::CaseInsensitive) == 0 ? 1 : 0;
+
+    g_free(value);
+
+    return rv;
+}
+
+class AppImageHandle::PrivateData {
+public:
+    const QString path;
+    const std::string stdPath;
+
+    int fd;
+
+    // memoized values, see the has* flags
+    bool hasType = false;
+    int type = -1;
+
+    bool hasDesktopEntry = false;
+    QByteArray desktopEntry;
+
+    bool hasShallNotBeIntegrated = false;
+    int shallNotBeIntegrated = -1;
+
+    bool hasIsTerminalApp = false;
+    int isTerminalApp = -1;
+
+public:
+    explicit PrivateData(QString path) : path(std::move(path)), stdPath(this->path.toStdString()) {
+        fd = open(stdPath.c_str(), O_RDONLY | O_CLOEXEC);
+
+        if (fd < 0) {
+            qDebug() << "failed to open AppImage" << this->path << strerror(errno);
+        }
+    }
+
+    ~PrivateData() {
+        if (fd >= 0)
+            close(fd);
+    }
+
+    PrivateData(const PrivateData&) = delete;
+    PrivateData& operator=(const PrivateData&) = delete;
+
+public:
+    int detectType() const {
+        if (fd < 0)
+            return -1;
+
+        // the ELF header and the magic bytes can be checked with a single read
+        // this way, arbitrary files (archives, disk images, half-written downloads, ...) are rejected before
+        // libappimage gets to open and parse them
+        char header[APPIMAGE_MAGIC_OFFSET + 3]{};
+
+        if (pread(fd, header, sizeof(header), 0) != sizeof(header) ||
+            memcmp(header, ELF_MAGIC, sizeof(ELF_MAGIC)) != 0) {
+            return -1;
+        }
+
+        const char* magic = header + APPIMAGE_MAGIC_OFFSET;
+
+        if (memcmp(magic, APPIMAGE_MAGIC, sizeof(APPIMAGE_MAGIC)) == 0 && (magic[2] == 1 || magic[2] == 2)) {
+            return magic[2];
+        }
+
+        // type 1 AppImages may lack the magic bytes; anything else ELF is just a regular executable (or library)
+        char isoMagic[sizeof(ISO9660_MAGIC)]{};
+
+        if (pread(fd, isoMagic, sizeof(isoMagic), ISO9660_MAGIC_OFFSET) != sizeof(isoMagic) ||
+            memcmp(isoMagic, ISO9660_MAGIC, sizeof(ISO9660_MAGIC)) != 0) {
+            return -1;
+        }
+
+        // libappimage knows some heuristics to detect type 1 AppImages without magic bytes, so we leave the rest to
+        // libappimage
+        return appimage_get_type(stdPath.c_str(), false);
+    }
+
+    QByteArray extractDesktopEntry() const {
+        QByteArray rv;
+
+        // libappimage uses the first desktop file in the root directory
+        auto** files = appimage_list_files(stdPath.c_str());
+
+        if (files == nullptr)
+            return rv;
+
+        for (auto** file = files; *file != nullptr; ++file) {
+            QString filePath(*file);
+
+            while (filePath.startsWith("/") || filePath.startsWith("./"))
+                filePath.remove(0, filePath.startsWith("/") ? 1 : 2);
+
+            if (filePath.contains('/') || !filePath.endsWith(".desktop"))
+                continue;
+
+            char* buffer = nullptr;
+            unsigned long bufferSize = 0;
+
+            if (appimage_read_file_into_buffer_following_symlinks(stdPath.c_str(), *file, &buffer, &bufferSize)) {
+                rv = QByteArray(buffer, static_cast<int>(bufferSize));
+            }
+
+            free(buffer);
+            break;
+        }
+
+        appimage_string_list_free(files);
+
+        return rv;
+    }
+};
+
+AppImageHandle::AppImageHandle(const QString& path) : d(std::make_shared<PrivateData>(path)) {}
+
+const QString& AppImageHandle::path() const {
+    return d->path;
+}
+
+int AppImageHandle::fd() const {
+    return d->fd;
+}
+
+int AppImageHandle::type() {
+    if (!d->hasType) {
+        d->type = d->detectType();
+        d->hasType = true;
+    }
+
+    return d->type;
+}
+
+bool AppImageHandle::isAppImage() {
+    const auto type = this->type();
+    return type > 0 && type <= 2;
+}
+
+bool AppImageHandle::isOpenForWriting() const {
+    if (d->fd < 0)
+        return false;
+
+    // a read lease cannot be acquired while the file is open for writing by any process
+    // the lease is released right away, so writers which open the file afterwards are not blocked
+    if (fcntl(d->fd, F_SETLEASE, F_RDLCK) == 0) {
+        fcntl(d->fd, F_SETLEASE, F_UNLCK);
+        return false;
+    }
+
+    // other errors mean we cannot tell (e.g., the file belongs to another user, or the file system doesn't support
+    // leases), so we treat the file like before
+    return errno == EAGAIN;
+}
+
+const QByteArray& AppImageHandle::desktopEntry() {
+    if (!d->hasDesktopEntry) {
+        if (isAppImage())
+            d->desktopEntry = d->extractDesktopEntry();
+
+        d->hasDesktopEntry = true;
+    }
+
+    return d->desktopEntry;
+}
+
+int AppImageHandle::shallNotBeIntegrated() {
+    if (!d->hasShallNotBeIntegrated) {
+        const auto& entry = desktopEntry();
+
+        // in case the desktop entry couldn't be extracted, libappimage shall decide (and report the error)
+        if (entry.isEmpty()) {
+            d->shallNotBeIntegrated = appimage_shall_not_be_integrated(d->stdPath.c_str());
+        } else {
+            d->shallNotBeIntegrated = desktopEntryValueEquals(entry, "X-AppImage-Integrate", "false");
+        }
+
+        d->hasShallNotBeIntegrated = true;
+    }
+
+    return d->shallNotBeIntegrated;
+}
+
+int AppImageHandle::isTerminalApp() {
+    if (!d->hasIsTerminalApp) {
+        const auto& entry = desktopEntry();
+
+        if (entry.isEmpty()) {
+            d->isTerminalApp = appimage_is_terminal_app(d->stdPath.c_str());
+        } else {
+            d->isTerminalApp = desktopEntryValueEquals(entry, G_KEY_FILE_DESKTOP_KEY_TERMINAL, "true");
+        }
+
+        d->hasIsTerminalApp = true;
+    }
+
+    return d->isTerminalApp;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// system headers
+#include <memory>
+
+// library headers
+#include <QByteArray>
+#include <QString>
+
+/*
+ * Handle to a single AppImage, whose properties are extracted lazily and memoized.
+ *
+ * Launching or integrating an AppImage requires several pieces of information about it (type, flags from the
+ * embedded desktop entry, ...). Querying them via libappimage individually reads the squashfs again and again. Passing
+ * a handle around instead makes sure every piece of information is extracted at most once. The type is detected by
+ * reading the magic bytes from the handle's own file descriptor, libappimage still opens the file itself to extract
+ * the desktop entry.
+ *
+ * Handles are cheap to copy, copies share the memoized values. They are not threadsafe, though: a handle must not be
+ * used by multiple threads at the same time.
+ */
+class AppImageHandle {
+private:
+    class PrivateData;
+    std::shared_ptr<PrivateData> d;
+
+public:
+    explicit AppImageHandle(const QString& path);
+
+public:
+    const QString& path() const;
+
+    // file descriptor of the AppImage, opened read-only, close-on-exec
+    // -1 if the file could not be opened
+    int fd() const;
+
+    // AppImage type (see appimage_get_type()), values <= 0 mean "not an AppImage"
+    int type();
+
+    // true for the types AppImageLauncher supports (i.e., 1 and 2)
+    bool isAppImage();
+
+    // true if another process has the file open for writing, e.g., while it's being downloaded or copied
+    // not memoized, as the state changes over time
+    bool isOpenForWriting() const;
+
+    // same semantics as appimage_shall_not_be_integrated()/appimage_is_terminal_app(): 1 = yes, 0 = no, < 0 = error
+    int shallNotBeIntegrated();
+    int isTerminalApp();
+
+private:
+    // contents of the desktop file embedded in the AppImage, empty if it couldn't be extracted
+    const QByteArray& desktopEntry();
+};
@@ -0,0 +1,190 @@
+// system headers
+extern "C" {
+    #include <glib.h>
+    #include <sys/stat.h>
+}
+
+// library headers
+#include <QDir>
+#include <QFileInfo>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+#include <QStandardPaths>
+
+// local headers
+#include "desktopfilenameindex.h"
+
+static qint64 readMTime(const QString& path) {
+    struct stat st{};
+
+    if (stat(path.toStdString().c_str(), &st) != 0)
+        return -1;
+
+    return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+}
+
+// returns false if the file isn't a valid desktop file or doesn't have a Name entry
+static bool readNameEntry(const QString& path, QString& nameEntry) {
+    std::shared_ptr<GKeyFile> desktopFile(g_key_file_new(), [](GKeyFile* p) {
+        g_key_file_free(p);
+    });
+
+    if (!g_key_file_load_from_file(desktopFile.get(), path.toStdString().c_str(), G_KEY_FILE_KEEP_TRANSLATIONS, nullptr))
+        return false;
+
+    auto* value = g_key_file_get_string(desktopFile.get(), G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, nullptr);
+
+    if (value == nullptr)
+        return false;
+
+    nameEntry = QString::fromUtf8(value);
+    g_free(value);
+
+    return true;
+}
+
+class DesktopFileNameIndex::PrivateData {
+public:
+    struct FileEntry {
+        qint64 mtime;
+        // empty if the file doesn't have a usable Name entry
+        QString nameEntry;
+    };
+
+    const QStringList directories;
+
+    QMutex mutex;
+
+    // modification time of the directories when they have been listed last
+    QHash<QString, qint64> directoryMTimes;
+
+    QHash<QString, FileEntry> files;
+
+    // sorted by the trimmed Name entry, which allows for efficient prefix lookups
+    QMultiMap<QString, QString> pathsByName;
+
+public:
+    explicit PrivateData(QStringList directories) : directories(std::move(directories)) {}
+
+public:
+    // caution: mutex must be held by the caller
+    void removeFile(const QString& path) {
+        const auto it = files.find(path);
+
+        if (it == files.end())
+            return;
+
+        if (!it->nameEntry.isEmpty())
+            pathsByName.remove(it->nameEntry.trimmed(), path);
+
+        files.erase(it);
+    }
+
+    // caution: mutex must be held by the caller
+    void updateFile(const QString& path, qint64 mtime) {
+        const auto it = files.constFind(path);
+
+        if (it != files.constEnd() && it->mtime == mtime)
+            return;
+
+        removeFile(path);
+
+        FileEntry entry{mtime, QString()};
+
+        // invalid files are remembered as well, so we don't try to parse them again and again
+        if (readNameEntry(path, entry.nameEntry) && !entry.nameEntry.isEmpty())
+            pathsByName.insert(entry.nameEntry.trimmed(), path);
+
+        files.insert(path, entry);
+    }
+
+    // caution: mutex must be held by the caller
+    void refreshDirectory(const QString& directory) {
+        const auto directoryMTime = readMTime(directory);
+
+        const auto it = directoryMTimes.constFind(directory);
+
+        // adding, removing or replacing (e.g., by renaming a temporary file) files changes the modification time
+        if (it != directoryMTimes.constEnd() && it.value() == directoryMTime)
+            return;
+
+        directoryMTimes.insert(directory, directoryMTime);
+
+        QSet<QString> existingFiles;
+
+        for (const auto& fileInfo : QDir(directory).entryInfoList(QStringList{"*.desktop"}, QDir::Files)) {
+            const auto path = fileInfo.absoluteFilePath();
+            existingFiles.insert(path);
+            updateFile(path, readMTime(path));
+        }
+
+        QStringList removedFiles;
+
+        for (auto fileIt = files.constBegin(); fileIt != files.constEnd(); ++fileIt) {
+            if (QFileInfo(fileIt.key()).absolutePath() == QDir(directory).absolutePath() &&
+                !existingFiles.contains(fileIt.key())) {
+                removedFiles << fileIt.key();
+            }
+        }
+
+        for (const auto& path : removedFiles) {
+            removeFile(path);
+        }
+    }
+
+    // caution: mutex must be held by the caller
+    void refresh() {
+        for (const auto& directory : directories) {
+            refreshDirectory(directory);
+        }
+    }
+};
+
+DesktopFileNameIndex::DesktopFileNameIndex(const QStringList& directories) {
+    d = std::make_shared<PrivateData>(directories);
+}
+
+std::shared_ptr<DesktopFileNameIndex> DesktopFileNameIndex::instance() {
+    // default locations of desktop files on systems
+    static const auto index = std::make_shared<DesktopFileNameIndex>(QStringList{
+        "/usr/share/applications",
+        QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/applications",
+    });
+
+    return index;
+}
+
+std::map<std::string, std::string> DesktopFileNameIndex::findByNamePrefix(const QString& prefix) {
+    QMutexLocker lock(&d->mutex);
+
+    d->refresh();
+
+    const auto trimmedPrefix = prefix.trimmed();
+
+    std::map<std::string, std::string> rv;
+
+    for (auto it = d->pathsByName.lowerBound(trimmedPrefix); it != d->pathsByName.end(); ++it) {
+        if (!it.key().startsWith(trimmedPrefix))
+            break;
+
+        rv[it.value().toStdString()] = d->files[it.value()].nameEntry.toStdString();
+    }
+
+    return rv;
+}
+
+void DesktopFileNameIndex::update(const QString& desktopFilePath) {
+    QMutexLocker lock(&d->mutex);
+
+    const auto path = QFileInfo(desktopFilePath).absoluteFilePath();
+    const auto mtime = readMTime(path);
+
+    if (mtime < 0) {
+        d->removeFile(path);
+    } else {
+        d->updateFile(path, mtime);
+    }
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// system headers
+#include <map>
+#include <memory>
+#include <string>
+
+// library headers
+#include <QString>
+#include <QStringList>
+
+/*
+ * In-memory index of the Name entries of the desktop files in a set of directories, used to find collisions between
+ * newly integrated AppImages and existing applications without parsing all desktop files every time.
+ *
+ * Before every lookup, the directories' modification times are checked. If a directory has changed, its files are
+ * listed again, and only desktop files which are new or have been modified (according to their modification time)
+ * are parsed.
+ *
+ * All methods are threadsafe.
+ */
+class DesktopFileNameIndex {
+private:
+    class PrivateData;
+    std::shared_ptr<PrivateData> d;
+
+public:
+    explicit DesktopFileNameIndex(const QStringList& directories);
+
+public:
+    // process-wide index of the system's and the user's applications directories
+    static std::shared_ptr<DesktopFileNameIndex> instance();
+
+public:
+    // find all desktop files whose (trimmed) Name entry starts with the given (trimmed) prefix
+    // returns a map of the desktop files' paths to their Name entries
+    std::map<std::string, std::string> findByNamePrefix(const QString& prefix);
+
+    // (re-)read a single desktop file, e.g., after it has been written
+    void update(const QString& desktopFilePath);
+};
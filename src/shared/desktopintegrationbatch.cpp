@@ -0,0 +1,183 @@
+// system headers
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <set>
+extern "C" {
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+// library headers
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSet>
+
+// local headers
+#include "desktopintegrationbatch.h"
+#include "registrationmanifest.h"
+
+namespace {
+    // process-wide, as the files are written deep down in the integration code
+    struct BatchState {
+        QMutex mutex;
+
+        // number of batches which have not ended yet
+        int depth = 0;
+
+        // directories of the files whose sync has been deferred
+        QSet<QString> directoriesToSync;
+
+        bool iconsChanged = false;
+
+        // DesktopIntegrationTree flags
+        int changedTrees = 0;
+    };
+
+    BatchState& batchState() {
+        static BatchState state;
+        return state;
+    }
+
+    void sendIconChangedSignal() {
+        auto message = QDBusMessage::createSignal(QStringLiteral("/KIconLoader"), QStringLiteral("org.kde.KIconLoader"), QStringLiteral("iconChanged"));
+        message.setArguments({0});
+        QDBusConnection::sessionBus().send(message);
+    }
+
+    // syncs every file system once, no matter how many of the directories reside on it
+    bool syncFileSystems(const QSet<QString>& directories) {
+        std::set<dev_t> syncedDevices;
+
+        bool rv = true;
+
+        for (const auto& directory : directories) {
+            const auto fd = open(directory.toStdString().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+            if (fd < 0) {
+                const auto error = errno;
+                std::cerr << "Warning: failed to open " << directory.toStdString() << " for syncing: "
+                          << strerror(error) << std::endl;
+                rv = false;
+                continue;
+            }
+
+            struct stat st{};
+
+            if (fstat(fd, &st) == 0 && syncedDevices.insert(st.st_dev).second) {
+                if (syncfs(fd) != 0) {
+                    const auto error = errno;
+                    std::cerr << "Warning: failed to sync file system of " << directory.toStdString() << ": "
+                              << strerror(error) << std::endl;
+                    rv = false;
+                }
+            }
+
+            close(fd);
+        }
+
+        return rv;
+    }
+}
+
+DesktopIntegrationBatch::DesktopIntegrationBatch() : active(true) {
+    auto& state = batchState();
+
+    QMutexLocker lock(&state.mutex);
+    ++state.depth;
+}
+
+DesktopIntegrationBatch::~DesktopIntegrationBatch() {
+    commit();
+}
+
+bool DesktopIntegrationBatch::commit() {
+    if (!active)
+        return true;
+
+    active = false;
+
+    auto& state = batchState();
+
+    QSet<QString> directoriesToSync;
+    bool iconsChanged;
+
+    {
+        QMutexLocker lock(&state.mutex);
+
+        if (--state.depth > 0)
+            return true;
+
+        directoriesToSync.swap(state.directoriesToSync);
+        iconsChanged = state.iconsChanged;
+        state.iconsChanged = false;
+        state.changedTrees = 0;
+    }
+
+    // the slow parts are done without holding the lock, new batches may be started in the meantime
+    auto rv = RegistrationManifest::flush();
+
+    if (!rv)
+        std::cerr << "Warning: failed to update registration manifest" << std::endl;
+
+    rv = syncFileSystems(directoriesToSync) && rv;
+
+    if (iconsChanged)
+        sendIconChangedSignal();
+
+    return rv;
+}
+
+int DesktopIntegrationBatch::changedTrees() const {
+    auto& state = batchState();
+
+    QMutexLocker lock(&state.mutex);
+    return state.changedTrees;
+}
+
+bool DesktopIntegrationBatch::isActive() {
+    auto& state = batchState();
+
+    QMutexLocker lock(&state.mutex);
+    return state.depth > 0;
+}
+
+bool DesktopIntegrationBatch::deferSync(const QString& path) {
+    auto& state = batchState();
+
+    QMutexLocker lock(&state.mutex);
+
+    if (state.depth <= 0)
+        return false;
+
+    state.directoriesToSync.insert(QFileInfo(path).absolutePath());
+    return true;
+}
+
+void DesktopIntegrationBatch::notifyIconsChanged() {
+    auto& state = batchState();
+
+    {
+        QMutexLocker lock(&state.mutex);
+
+        if (state.depth > 0) {
+            state.iconsChanged = true;
+            return;
+        }
+    }
+
+    sendIconChangedSignal();
+}
+
+void DesktopIntegrationBatch::markTreesChanged(int trees) {
+    auto& state = batchState();
+
+    QMutexLocker lock(&state.mutex);
+
+    if (state.depth > 0)
+        state.changedTrees |= trees;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+// library headers
+#include <QString>
+
+/*
+ * Write-behind stage for the files written while integrating AppImages.
+ *
+ * On its own, every integration syncs its desktop file to disk and notifies KDE/Plasma about changed icons via D-Bus.
+ * As long as a batch exists, file writes only mark the file systems they happened on, which are synced once when the
+ * batch ends, and a single icon change notification is sent at that point. The registration manifest is written at
+ * that point, too.
+ *
+ * The batch also keeps track of the desktop integration trees (see DesktopIntegrationTree) the integration code has
+ * modified, so that only the caches of those trees have to be updated.
+ *
+ * Batches may be nested, and be used by multiple threads (e.g., the operations of a batch running in parallel). The
+ * deferred work is done once the outermost batch ends.
+ */
+class DesktopIntegrationBatch {
+private:
+    bool active;
+
+public:
+    DesktopIntegrationBatch();
+    // ends the batch, unless commit() has been called already
+    ~DesktopIntegrationBatch();
+
+    DesktopIntegrationBatch(const DesktopIntegrationBatch&) = delete;
+    DesktopIntegrationBatch& operator=(const DesktopIntegrationBatch&) = delete;
+
+public:
+    // ends the batch, returns false if updating the registration manifest or syncing the written files failed
+    bool commit();
+
+    // the desktop integration trees which have been modified since the outermost batch has begun, as a combination of
+    // DesktopIntegrationTree flags
+    // must be called before commit()
+    int changedTrees() const;
+
+public:
+    // whether any batch is active in this process
+    static bool isActive();
+
+    // to be called after writing a file without syncing it
+    // returns true if the sync has been deferred to the end of the current batch, false if there is no active batch,
+    // in which case the caller has to sync the file on its own
+    static bool deferSync(const QString& path);
+
+    // sends the icon change notification, or defers it to the end of the current batch
+    static void notifyIconsChanged();
+
+    // to be called after modifying files in the given desktop integration trees
+    // without an active batch, this does nothing, callers have to update all the caches on their own then
+    static void markTreesChanged(int trees);
+};
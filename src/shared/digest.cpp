@@ -0,0 +1,263 @@
+// system headers
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+extern "C" {
+    #include <appimage/appimage.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+}
+
+// library headers
+#include <QCryptographicHash>
+
+// local headers
+#include "digest.h"
+
+// libappimage hashes the file in chunks of this size, and always feeds entire chunks into the hash function
+// therefore, the last chunk is effectively padded with null bytes, which we have to emulate
+static constexpr off_t LIBAPPIMAGE_DIGEST_CHUNK_SIZE = 4096;
+
+// the file is read in much larger blocks to reduce the amount of syscalls
+// must be a multiple of the chunk size above
+static constexpr off_t READ_BLOCK_SIZE = 4 * 1024 * 1024;
+
+// amount of blocks which can be in flight between the reader and the hashing thread
+static constexpr int READ_BLOCK_COUNT = 4;
+
+// sections libappimage skips when calculating the digest
+static const char* const SKIPPED_SECTIONS[] = {".digest_md5", ".sha256_sig", ".sig_key"};
+
+namespace {
+    struct Block {
+        std::vector<char> data;
+        off_t size = 0;
+    };
+
+    struct Section {
+        off_t offset;
+        off_t length;
+    };
+
+    // minimal blocking queue to pass blocks between the reader and the hashing thread
+    class BlockQueue {
+    private:
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::deque<Block*> blocks;
+
+    public:
+        void push(Block* block) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                blocks.push_back(block);
+            }
+
+            condition.notify_one();
+        }
+
+        Block* pop() {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !blocks.empty(); });
+
+            auto* block = blocks.front();
+            blocks.pop_front();
+            return block;
+        }
+    };
+}
+
+// pread() may return fewer bytes than requested, so we need to call it until we have read everything
+static ssize_t preadFully(int fd, char* buffer, size_t count, off_t offset) {
+    size_t bytesRead = 0;
+
+    while (bytesRead < count) {
+        const auto rv = pread(fd, buffer + bytesRead, count - bytesRead, offset + static_cast<off_t>(bytesRead));
+
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+
+            return -1;
+        }
+
+        // unexpected end of file
+        if (rv == 0)
+            break;
+
+        bytesRead += static_cast<size_t>(rv);
+    }
+
+    return static_cast<ssize_t>(bytesRead);
+}
+
+// looks up the sections whose contents must be ignored
+static bool findSkippedSections(const std::string& path, std::vector<Section>& skippedSections) {
+    skippedSections.clear();
+
+    for (const auto* sectionName : SKIPPED_SECTIONS) {
+        unsigned long offset = 0, length = 0;
+
+        // libappimage refuses to calculate the digest in this case, so do we
+        if (!appimage_get_elf_section_offset_and_length(path.c_str(), sectionName, &offset, &length))
+            return false;
+
+        if (offset != 0 && length != 0)
+            skippedSections.push_back({static_cast<off_t>(offset), static_cast<off_t>(length)});
+    }
+
+    return true;
+}
+
+// emulate null bytes for the skipped sections within the block starting at the given position
+static void zeroSkippedSections(const std::vector<Section>& skippedSections, char* data, off_t position, off_t size) {
+    for (const auto& section : skippedSections) {
+        const auto begin = std::max(position, section.offset);
+        const auto end = std::min(position + size, section.offset + section.length);
+
+        if (begin < end) {
+            memset(data + (begin - position), 0, static_cast<size_t>(end - begin));
+        }
+    }
+}
+
+class AppImageDigestMd5Calculator::PrivateData {
+public:
+    std::vector<Section> skippedSections;
+    bool valid = false;
+
+    QCryptographicHash hash{QCryptographicHash::Md5};
+    off_t position = 0;
+};
+
+AppImageDigestMd5Calculator::AppImageDigestMd5Calculator(const QString& path) : d(std::make_shared<PrivateData>()) {
+    d->valid = findSkippedSections(path.toStdString(), d->skippedSections);
+}
+
+bool AppImageDigestMd5Calculator::isValid() const {
+    return d->valid;
+}
+
+void AppImageDigestMd5Calculator::addData(char* data, qint64 size) {
+    zeroSkippedSections(d->skippedSections, data, d->position, static_cast<off_t>(size));
+
+    d->hash.addData(data, static_cast<int>(size));
+    d->position += static_cast<off_t>(size);
+}
+
+QByteArray AppImageDigestMd5Calculator::result() {
+    // pad the data to a multiple of the chunk size, see above
+    const auto remainder = d->position % LIBAPPIMAGE_DIGEST_CHUNK_SIZE;
+
+    if (remainder != 0) {
+        const QByteArray padding(static_cast<int>(LIBAPPIMAGE_DIGEST_CHUNK_SIZE - remainder), '\0');
+        d->hash.addData(padding);
+        d->position += padding.size();
+    }
+
+    return d->hash.result();
+}
+
+bool calculateAppImageDigestMd5(const QString& path, QByteArray& digest) {
+    const auto stdPath = path.toStdString();
+
+    std::vector<Section> skippedSections;
+
+    if (!findSkippedSections(stdPath, skippedSections))
+        return false;
+
+    const int fd = open(stdPath.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        const auto error = errno;
+        std::cerr << "Failed to open " << stdPath << " for digest calculation: " << strerror(error) << std::endl;
+        return false;
+    }
+
+    struct stat st{};
+
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+
+    const off_t fileSize = st.st_size;
+
+    // we read the file exactly once from the beginning to the end, so the kernel can read ahead aggressively
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    std::vector<Block> blocks(READ_BLOCK_COUNT);
+
+    BlockQueue freeBlocks;
+    BlockQueue filledBlocks;
+
+    for (auto& block : blocks) {
+        block.data.resize(READ_BLOCK_SIZE);
+        freeBlocks.push(&block);
+    }
+
+    std::atomic<bool> readFailed{false};
+
+    // the reader thread pushes filled blocks into the queue, followed by a null pointer marking the end of the file
+    std::thread reader([&]() {
+        for (off_t position = 0; position < fileSize; position += READ_BLOCK_SIZE) {
+            auto* block = freeBlocks.pop();
+
+            const auto blockSize = std::min(READ_BLOCK_SIZE, fileSize - position);
+
+            // ask the kernel to fetch the next block while we're processing this one
+            posix_fadvise(fd, position + blockSize, READ_BLOCK_SIZE, POSIX_FADV_WILLNEED);
+
+            if (preadFully(fd, block->data.data(), static_cast<size_t>(blockSize), position) != blockSize) {
+                readFailed = true;
+                break;
+            }
+
+            block->size = blockSize;
+
+            zeroSkippedSections(skippedSections, block->data.data(), position, blockSize);
+
+            // pad the last block to a multiple of the chunk size, see above
+            if (position + blockSize >= fileSize) {
+                const auto remainder = blockSize % LIBAPPIMAGE_DIGEST_CHUNK_SIZE;
+
+                if (remainder != 0) {
+                    const auto padding = LIBAPPIMAGE_DIGEST_CHUNK_SIZE - remainder;
+                    memset(block->data.data() + blockSize, 0, static_cast<size_t>(padding));
+                    block->size += padding;
+                }
+            }
+
+            filledBlocks.push(block);
+        }
+
+        filledBlocks.push(nullptr);
+    });
+
+    QCryptographicHash hash(QCryptographicHash::Md5);
+
+    for (Block* block; (block = filledBlocks.pop()) != nullptr;) {
+        hash.addData(block->data.data(), static_cast<int>(block->size));
+        freeBlocks.push(block);
+    }
+
+    reader.join();
+    close(fd);
+
+    if (readFailed) {
+        std::cerr << "Failed to read " << stdPath << " for digest calculation" << std::endl;
+        return false;
+    }
+
+    digest = hash.result();
+    return true;
+}
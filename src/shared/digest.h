@@ -0,0 +1,37 @@
+#pragma once
+
+// system headers
+#include <memory>
+
+// library headers
+#include <QByteArray>
+#include <QString>
+
+// calculate the MD5 digest of a type 2 AppImage, producing the same results as libappimage's
+// appimage_type2_digest_md5(), i.e., the contents of the .digest_md5, .sha256_sig and .sig_key sections are
+// replaced with null bytes
+// the file is read in large blocks on a separate thread while the previous block is being hashed, so the calculation
+// is bound by the disk's bandwidth rather than the hashing
+// on success, digest contains the raw (i.e., not hexlified) 16 bytes long digest
+bool calculateAppImageDigestMd5(const QString& path, QByteArray& digest);
+
+// incremental variant of the above, for callers which read the entire file anyway (e.g., to copy it)
+// the file's contents must be passed in order, from the beginning to the end
+class AppImageDigestMd5Calculator {
+private:
+    class PrivateData;
+    std::shared_ptr<PrivateData> d;
+
+public:
+    // looks up the sections to be skipped in the given file
+    explicit AppImageDigestMd5Calculator(const QString& path);
+
+    // false if the digest can't be calculated for the file (e.g., because it's not a type 2 AppImage)
+    bool isValid() const;
+
+    // the contents of the skipped sections are overwritten with null bytes in the passed buffer
+    void addData(char* data, qint64 size);
+
+    // raw digest of the data passed so far, must be called only once
+    QByteArray result();
+};
@@ -0,0 +1,135 @@
+// system headers
+#include <atomic>
+#include <string>
+extern "C" {
+    #include <sys/stat.h>
+    #include <sys/xattr.h>
+}
+
+// library headers
+#include <QDebug>
+#include <QStringList>
+
+// local headers
+#include "digestcache.h"
+#include "metadataindex.h"
+
+// "user" namespace attributes can be set by anyone who can write to the file
+static const char DIGEST_XATTR_NAME[] = "user.appimagelauncher.digest_md5";
+
+// the attribute contains a format version, followed by the stat data used to validate the digest and the digest
+// itself, separated by spaces
+static const QString DIGEST_XATTR_FORMAT_VERSION = "1";
+
+static std::atomic<quint64> cacheHits{0};
+static std::atomic<quint64> cacheMisses{0};
+
+static bool lookupInXattr(const std::string& path, const AppImageMetadata& current, QString& digestMd5) {
+    char buffer[256];
+
+    const auto size = getxattr(path.c_str(), DIGEST_XATTR_NAME, buffer, sizeof(buffer));
+
+    // ENODATA, ENOTSUP, ERANGE, ...
+    // none of these are worth reporting, the cache just doesn't have an entry
+    if (size <= 0)
+        return false;
+
+    const auto parts = QString::fromLatin1(buffer, static_cast<int>(size)).split(' ');
+
+    if (parts.size() != 5 || parts[0] != DIGEST_XATTR_FORMAT_VERSION)
+        return false;
+
+    if (parts[1].toULongLong() != current.inode ||
+        parts[2].toLongLong() != current.size ||
+        parts[3].toLongLong() != current.mtime) {
+        return false;
+    }
+
+    digestMd5 = parts[4];
+    return !digestMd5.isEmpty();
+}
+
+static bool storeInXattr(const std::string& path, const AppImageMetadata& current, const QString& digestMd5) {
+    const auto value = QStringList{
+        DIGEST_XATTR_FORMAT_VERSION,
+        QString::number(current.inode),
+        QString::number(current.size),
+        QString::number(current.mtime),
+        digestMd5,
+    }.join(' ').toLatin1();
+
+    return setxattr(path.c_str(), DIGEST_XATTR_NAME, value.constData(), static_cast<size_t>(value.size()), 0) == 0;
+}
+
+bool AppImageDigestCache::lookup(const QString& path, QString& digestMd5) {
+    const auto stdPath = path.toStdString();
+
+    AppImageMetadata current;
+
+    if (!AppImageMetadataIndex::readStatData(path, current)) {
+        ++cacheMisses;
+        return false;
+    }
+
+    if (lookupInXattr(stdPath, current, digestMd5)) {
+        ++cacheHits;
+        qDebug() << "digest cache hit (xattr) for" << path << "hits:" << hits() << "misses:" << misses();
+        return true;
+    }
+
+    AppImageMetadata metadata;
+
+    if (AppImageMetadataIndex::instance()->lookup(path, metadata) &&
+        metadata.ctime == current.ctime &&
+        !metadata.digestMd5.isEmpty()) {
+        digestMd5 = metadata.digestMd5;
+        ++cacheHits;
+        qDebug() << "digest cache hit (index) for" << path << "hits:" << hits() << "misses:" << misses();
+        return true;
+    }
+
+    ++cacheMisses;
+    qDebug() << "digest cache miss for" << path << "hits:" << hits() << "misses:" << misses();
+    return false;
+}
+
+void AppImageDigestCache::store(const QString& path, const QString& digestMd5) {
+    if (digestMd5.isEmpty())
+        return;
+
+    AppImageMetadata current;
+
+    if (!AppImageMetadataIndex::readStatData(path, current))
+        return;
+
+    // failing to set the attribute is not an error, the index serves as a fallback
+    if (!storeInXattr(path.toStdString(), current, digestMd5)) {
+        qDebug() << "could not store digest in extended attribute, using metadata index only:" << path;
+    }
+
+    // we always store the digest in the index, too
+    // the index refreshes the stat data when updating the entry, so the ctime change caused by writing the attribute
+    // doesn't invalidate the entry
+    const auto index = AppImageMetadataIndex::instance();
+
+    AppImageMetadata metadata;
+
+    if (!index->lookup(path, metadata)) {
+        metadata = AppImageMetadata{};
+        metadata.path = path;
+        // digests are only supported for type 2 AppImages
+        metadata.type = 2;
+    }
+
+    metadata.digestMd5 = digestMd5;
+
+    index->update(metadata);
+}
+
+quint64 AppImageDigestCache::hits() {
+    return cacheHits;
+}
+
+quint64 AppImageDigestCache::misses() {
+    return cacheMisses;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+// library headers
+#include <QString>
+
+/*
+ * Cache for AppImage MD5 digests, so that large AppImages don't have to be hashed more than once.
+ *
+ * Digests are stored in an extended attribute on the AppImage where supported. As a fallback (e.g., for read-only
+ * files or filesystems without xattr support), they are stored in the metadata index.
+ *
+ * Cached digests are only used as long as the file's inode, size and modification time match the values recorded
+ * alongside them. Entries in the metadata index are additionally validated with the file's status change time.
+ * This is not possible for extended attributes, as writing the attribute changes the status change time.
+ *
+ * All methods are threadsafe.
+ */
+class AppImageDigestCache {
+public:
+    // look up digest for given AppImage
+    // returns false if no valid digest could be found
+    static bool lookup(const QString& path, QString& digestMd5);
+
+    // store digest for given AppImage
+    static void store(const QString& path, const QString& digestMd5);
+
+    // statistics, useful to check whether the cache works as expected
+    static quint64 hits();
+    static quint64 misses();
+};
@@ -0,0 +1,271 @@
+// system headers
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+extern "C" {
+    #include <fcntl.h>
+    #include <linux/fs.h>
+    #include <sys/ioctl.h>
+    #include <sys/sendfile.h>
+    #include <sys/stat.h>
+    #include <sys/syscall.h>
+    #include <unistd.h>
+}
+
+// local headers
+#include "fastcopy.h"
+#include "digest.h"
+#include "metrics.h"
+
+// older kernel headers don't define it, the ioctl has been available as BTRFS_IOC_CLONE for a long time, though
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+// the kernel calls are split up into chunks of this size, so that progress can be reported
+static constexpr off_t KERNEL_COPY_CHUNK_SIZE = 64 * 1024 * 1024;
+
+// buffer size used when copying in userspace
+static constexpr size_t USERSPACE_COPY_BUFFER_SIZE = 8 * 1024 * 1024;
+
+namespace {
+    enum CopyResult {
+        COPY_SUCCEEDED = 0,
+        COPY_FAILED,
+        // the strategy isn't supported by the kernel or the file systems, the next one should be tried
+        COPY_UNSUPPORTED,
+    };
+
+    bool isUnsupportedError(int error) {
+        return error == ENOSYS || error == EINVAL || error == EXDEV || error == EOPNOTSUPP || error == ENOTTY ||
+               error == EBADF || error == EPERM;
+    }
+
+    void reportProgress(const FastCopyProgressCallback& progress, off_t bytesCopied, off_t bytesTotal) {
+        if (progress)
+            progress(bytesCopied, bytesTotal);
+    }
+
+    CopyResult copyWithReflink(int sourceFd, int destinationFd) {
+        if (ioctl(destinationFd, FICLONE, sourceFd) == 0)
+            return COPY_SUCCEEDED;
+
+        return isUnsupportedError(errno) ? COPY_UNSUPPORTED : COPY_FAILED;
+    }
+
+    // copies the file using a kernel function which takes care of the offsets
+    // a strategy is considered unsupported only if it fails before anything has been copied
+    template<typename CopyFunction>
+    CopyResult copyInKernel(off_t size, const FastCopyProgressCallback& progress, CopyFunction copyFunction) {
+        off_t bytesCopied = 0;
+
+        while (bytesCopied < size) {
+            const auto rv = copyFunction(static_cast<size_t>(std::min(KERNEL_COPY_CHUNK_SIZE, size - bytesCopied)));
+
+            if (rv < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                return bytesCopied == 0 && isUnsupportedError(errno) ? COPY_UNSUPPORTED : COPY_FAILED;
+            }
+
+            // the file has been truncated while copying
+            if (rv == 0)
+                return COPY_FAILED;
+
+            bytesCopied += rv;
+            reportProgress(progress, bytesCopied, size);
+        }
+
+        return COPY_SUCCEEDED;
+    }
+
+    CopyResult copyWithCopyFileRange(int sourceFd, int destinationFd, off_t size,
+                                     const FastCopyProgressCallback& progress) {
+#ifdef SYS_copy_file_range
+        // glibc provides a wrapper only since 2.27, and emulates the call in userspace if the kernel doesn't support it
+        return copyInKernel(size, progress, [sourceFd, destinationFd](size_t count) {
+            return static_cast<ssize_t>(
+                syscall(SYS_copy_file_range, sourceFd, nullptr, destinationFd, nullptr, count, 0)
+            );
+        });
+#else
+        return COPY_UNSUPPORTED;
+#endif
+    }
+
+    CopyResult copyWithSendfile(int sourceFd, int destinationFd, off_t size, const FastCopyProgressCallback& progress) {
+        return copyInKernel(size, progress, [sourceFd, destinationFd](size_t count) {
+            return sendfile(destinationFd, sourceFd, nullptr, count);
+        });
+    }
+
+    bool writeFully(int fd, const char* data, size_t count) {
+        size_t bytesWritten = 0;
+
+        while (bytesWritten < count) {
+            const auto rv = write(fd, data + bytesWritten, count - bytesWritten);
+
+            if (rv < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                return false;
+            }
+
+            bytesWritten += static_cast<size_t>(rv);
+        }
+
+        return true;
+    }
+
+    CopyResult copyInUserspace(int sourceFd, int destinationFd, off_t size, const FastCopyProgressCallback& progress,
+                               AppImageDigestMd5Calculator* calculator) {
+        std::vector<char> buffer(USERSPACE_COPY_BUFFER_SIZE);
+
+        off_t bytesCopied = 0;
+
+        while (bytesCopied < size) {
+            const auto rv = read(sourceFd, buffer.data(), buffer.size());
+
+            if (rv < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                return COPY_FAILED;
+            }
+
+            if (rv == 0)
+                return COPY_FAILED;
+
+            if (!writeFully(destinationFd, buffer.data(), static_cast<size_t>(rv)))
+                return COPY_FAILED;
+
+            // the calculator modifies the buffer, therefore the data has to be written first
+            if (calculator != nullptr)
+                calculator->addData(buffer.data(), rv);
+
+            bytesCopied += rv;
+            reportProgress(progress, bytesCopied, size);
+        }
+
+        return COPY_SUCCEEDED;
+    }
+}
+
+bool fastCopyFile(const QString& source, const QString& destination, const FastCopyProgressCallback& progress,
+                  QByteArray* digestMd5) {
+    MetricsTimer timer("copy");
+
+    const auto stdSource = source.toStdString();
+    const auto stdDestination = destination.toStdString();
+
+    const auto sourceFd = open(stdSource.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (sourceFd < 0) {
+        const auto error = errno;
+        std::cerr << "Failed to open " << stdSource << " for copying: " << strerror(error) << std::endl;
+        return false;
+    }
+
+    struct stat st{};
+
+    if (fstat(sourceFd, &st) != 0) {
+        close(sourceFd);
+        return false;
+    }
+
+    // like QFile::copy(), the permissions of the source are kept
+    const auto destinationFd = open(
+        stdDestination.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, st.st_mode & 07777
+    );
+
+    if (destinationFd < 0) {
+        const auto error = errno;
+        std::cerr << "Failed to create " << stdDestination << ": " << strerror(error) << std::endl;
+        close(sourceFd);
+        return false;
+    }
+
+    const off_t size = st.st_size;
+
+    std::unique_ptr<AppImageDigestMd5Calculator> calculator;
+
+    if (digestMd5 != nullptr) {
+        digestMd5->clear();
+
+        calculator.reset(new AppImageDigestMd5Calculator(source));
+
+        if (!calculator->isValid())
+            calculator.reset();
+    }
+
+    // a reflink doesn't read the data at all, so calculating the digest separately is still cheaper than copying
+    auto result = copyWithReflink(sourceFd, destinationFd);
+
+    if (result == COPY_SUCCEEDED) {
+        Metrics::instance()->increment("copy.reflink");
+        reportProgress(progress, size, size);
+
+        if (calculator != nullptr) {
+            calculator.reset();
+
+            if (!calculateAppImageDigestMd5(source, *digestMd5))
+                digestMd5->clear();
+        }
+    }
+
+    // the kernel copies the data without passing it through userspace, which is why the digest can't be calculated
+    // on the way
+    if (result == COPY_UNSUPPORTED && calculator == nullptr) {
+        result = copyWithCopyFileRange(sourceFd, destinationFd, size, progress);
+
+        if (result == COPY_SUCCEEDED)
+            Metrics::instance()->increment("copy.copy_file_range");
+    }
+
+    if (result == COPY_UNSUPPORTED && calculator == nullptr) {
+        result = copyWithSendfile(sourceFd, destinationFd, size, progress);
+
+        if (result == COPY_SUCCEEDED)
+            Metrics::instance()->increment("copy.sendfile");
+    }
+
+    if (result == COPY_UNSUPPORTED) {
+        posix_fadvise(sourceFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        result = copyInUserspace(sourceFd, destinationFd, size, progress, calculator.get());
+
+        if (result == COPY_SUCCEEDED) {
+            Metrics::instance()->increment("copy.userspace");
+
+            if (calculator != nullptr)
+                *digestMd5 = calculator->result();
+        }
+    }
+
+    auto error = errno;
+
+    close(sourceFd);
+
+    if (close(destinationFd) != 0 && result == COPY_SUCCEEDED) {
+        error = errno;
+        result = COPY_FAILED;
+    }
+
+    if (result != COPY_SUCCEEDED) {
+        std::cerr << "Failed to copy " << stdSource << " to " << stdDestination << ": " << strerror(error) << std::endl;
+
+        unlink(stdDestination.c_str());
+
+        if (digestMd5 != nullptr)
+            digestMd5->clear();
+
+        return false;
+    }
+
+    return true;
+}
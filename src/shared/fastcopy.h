@@ -0,0 +1,23 @@
+#pragma once
+
+// system headers
+#include <functional>
+
+// library headers
+#include <QByteArray>
+#include <QString>
+
+// called with the number of bytes copied so far and the size of the file
+typedef std::function<void(qint64 bytesCopied, qint64 bytesTotal)> FastCopyProgressCallback;
+
+// copies a file as fast as the file systems involved allow
+// the strategies are tried in this order:
+//   - FICLONE: shares the data with the source, which is instant (btrfs, XFS, ...)
+//   - copy_file_range(): the data is copied within the kernel, some file systems (e.g., NFS) copy it server-side
+//   - sendfile(): the data is copied within the kernel as well, works across all file systems
+//   - read() and write() with a large buffer
+// if digestMd5 is not null, the AppImage's MD5 digest (see calculateAppImageDigestMd5()) is calculated while the data
+// is copied in userspace, so the file is read only once; it is left empty if the digest can't be calculated
+// the destination must not exist, incomplete copies are removed on errors
+bool fastCopyFile(const QString& source, const QString& destination,
+                  const FastCopyProgressCallback& progress = nullptr, QByteArray* digestMd5 = nullptr);
@@ -0,0 +1,42 @@
+// system headers
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+extern "C" {
+    #include <fcntl.h>
+    #include <sys/file.h>
+    #include <unistd.h>
+}
+
+// library headers
+#include <QDir>
+#include <QFileInfo>
+
+// local headers
+#include "filelock.h"
+
+FileLock::FileLock(const QString& lockFilePath) {
+    // the lock file usually lives next to the file it protects, which might not have been created yet
+    QDir().mkpath(QFileInfo(lockFilePath).absolutePath());
+
+    fd = open(lockFilePath.toStdString().c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+    if (fd < 0) {
+        const auto error = errno;
+        std::cerr << "Warning: could not open lock file " << lockFilePath.toStdString() << ": "
+                  << strerror(error) << std::endl;
+        return;
+    }
+
+    if (flock(fd, LOCK_EX) != 0) {
+        const auto error = errno;
+        std::cerr << "Warning: could not lock " << lockFilePath.toStdString() << ": " << strerror(error) << std::endl;
+    }
+}
+
+FileLock::~FileLock() {
+    if (fd >= 0) {
+        flock(fd, LOCK_UN);
+        close(fd);
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+// library headers
+#include <QString>
+
+/*
+ * Holds an exclusive lock (see flock(2)) on the given file as long as the object exists. The file is created if
+ * necessary.
+ *
+ * Used to serialize read-modify-write cycles on files shared by multiple processes (and threads, as every instance
+ * opens the file on its own). Failing to acquire the lock is reported, but not considered fatal.
+ */
+class FileLock {
+private:
+    int fd;
+
+public:
+    explicit FileLock(const QString& lockFilePath);
+    ~FileLock();
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+};
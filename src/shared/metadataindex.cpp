@@ -0,0 +1,343 @@
+// system headers
+#include <iostream>
+extern "C" {
+    #include <sys/stat.h>
+}
+
+// library headers
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+
+// local headers
+#include "filelock.h"
+#include "metadataindex.h"
+
+// index files with a different version are discarded, therefore this needs to be bumped on incompatible changes
+static constexpr int INDEX_FORMAT_VERSION = 1;
+
+// QJsonValue stores numbers as doubles, which cannot represent nanosecond timestamps or inode numbers precisely
+// therefore, these values are stored as strings
+static QJsonObject metadataToJson(const AppImageMetadata& metadata) {
+    QJsonObject rv;
+
+    rv["inode"] = QString::number(metadata.inode);
+    rv["size"] = QString::number(metadata.size);
+    rv["mtime"] = QString::number(metadata.mtime);
+    rv["ctime"] = QString::number(metadata.ctime);
+    rv["type"] = metadata.type;
+    rv["registered"] = metadata.registered;
+    rv["digest_md5"] = metadata.digestMd5;
+    rv["desktop_file"] = metadata.desktopFilePath;
+    rv["has_update_information"] = metadata.hasUpdateInformation;
+
+    return rv;
+}
+
+static AppImageMetadata metadataFromJson(const QString& path, const QJsonObject& object) {
+    AppImageMetadata rv;
+
+    rv.path = path;
+    rv.inode = object["inode"].toString().toULongLong();
+    rv.size = object["size"].toString("-1").toLongLong();
+    rv.mtime = object["mtime"].toString("-1").toLongLong();
+    rv.ctime = object["ctime"].toString("-1").toLongLong();
+    rv.type = object["type"].toInt(-1);
+    rv.registered = object["registered"].toBool(false);
+    rv.digestMd5 = object["digest_md5"].toString();
+    rv.desktopFilePath = object["desktop_file"].toString();
+    // entries written by older versions don't contain the value, which is fine, it's just unknown then
+    rv.hasUpdateInformation = object["has_update_information"].toInt(-1);
+
+    return rv;
+}
+
+// returns the entries stored in the given index file, or an empty object if it doesn't exist or can't be used
+static QJsonObject readEntriesFromFile(const QString& indexFilePath) {
+    QFile file(indexFilePath);
+
+    // it's perfectly fine for the index not to exist yet
+    if (!file.exists())
+        return {};
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Warning: could not open metadata index for reading: "
+                  << indexFilePath.toStdString() << std::endl;
+        return {};
+    }
+
+    QJsonParseError parseError{};
+    const auto jsonDoc = QJsonDocument::fromJson(file.readAll(), &parseError);
+
+    // the index is just a cache, so if it's broken, we can simply start over
+    if (parseError.error != QJsonParseError::NoError || !jsonDoc.isObject()) {
+        std::cerr << "Warning: metadata index is corrupt, discarding: "
+                  << parseError.errorString().toStdString() << std::endl;
+        return {};
+    }
+
+    const auto rootObj = jsonDoc.object();
+
+    if (rootObj["version"].toInt() != INDEX_FORMAT_VERSION) {
+        qDebug() << "metadata index has incompatible version, discarding";
+        return {};
+    }
+
+    return rootObj["entries"].toObject();
+}
+
+// an entry is valid as long as the file has not been replaced or modified
+static bool statDataMatches(const AppImageMetadata& entry, const AppImageMetadata& current) {
+    return entry.inode == current.inode && entry.size == current.size && entry.mtime == current.mtime;
+}
+
+class AppImageMetadataIndex::PrivateData {
+public:
+    const QString indexFilePath;
+
+    mutable QMutex mutex;
+
+    bool autoSave;
+
+    QHash<QString, AppImageMetadata> entries;
+
+    // keep track of modifications since the last save, so they can be merged into the file on disk
+    QSet<QString> modifiedPaths;
+    QSet<QString> removedPaths;
+
+public:
+    explicit PrivateData(QString indexFilePath) : indexFilePath(std::move(indexFilePath)), autoSave(true) {}
+
+public:
+    QHash<QString, AppImageMetadata> readFromDisk() const {
+        QHash<QString, AppImageMetadata> rv;
+
+        const auto entriesObj = readEntriesFromFile(indexFilePath);
+
+        for (auto it = entriesObj.constBegin(); it != entriesObj.constEnd(); ++it) {
+            rv.insert(it.key(), metadataFromJson(it.key(), it.value().toObject()));
+        }
+
+        return rv;
+    }
+
+    bool writeToDisk(const QHash<QString, AppImageMetadata>& entriesToWrite) const {
+        QDir().mkpath(QFileInfo(indexFilePath).absolutePath());
+
+        // QSaveFile writes to a temporary file and renames it, so readers will never see a partially written index
+        QSaveFile file(indexFilePath);
+
+        if (!file.open(QIODevice::WriteOnly)) {
+            std::cerr << "Warning: could not open metadata index for writing: "
+                      << indexFilePath.toStdString() << std::endl;
+            return false;
+        }
+
+        QJsonObject entriesObj;
+
+        for (auto it = entriesToWrite.constBegin(); it != entriesToWrite.constEnd(); ++it) {
+            entriesObj[it.key()] = metadataToJson(it.value());
+        }
+
+        QJsonObject rootObj;
+        rootObj["version"] = INDEX_FORMAT_VERSION;
+        rootObj["entries"] = entriesObj;
+
+        file.write(QJsonDocument(rootObj).toJson(QJsonDocument::Compact));
+
+        return file.commit();
+    }
+
+    // caution: mutex must be held by the caller
+    bool save() {
+        if (modifiedPaths.isEmpty() && removedPaths.isEmpty())
+            return true;
+
+        FileLock lock(indexFilePath + ".lock");
+
+        // other processes might have modified the index in the meantime, so we apply our modifications on top of
+        // the current state on disk
+        auto mergedEntries = readFromDisk();
+
+        for (const auto& path : removedPaths) {
+            mergedEntries.remove(path);
+        }
+
+        for (const auto& path : modifiedPaths) {
+            const auto it = entries.constFind(path);
+
+            if (it != entries.constEnd())
+                mergedEntries.insert(path, it.value());
+        }
+
+        if (!writeToDisk(mergedEntries))
+            return false;
+
+        entries = mergedEntries;
+        modifiedPaths.clear();
+        removedPaths.clear();
+
+        return true;
+    }
+
+    // caution: mutex must be held by the caller
+    void saveIfNecessary() {
+        if (autoSave && !save())
+            std::cerr << "Warning: failed to save metadata index" << std::endl;
+    }
+};
+
+AppImageMetadataIndex::AppImageMetadataIndex(const QString& indexFilePath) {
+    d = std::make_shared<PrivateData>(indexFilePath);
+}
+
+QString AppImageMetadataIndex::defaultIndexFilePath() {
+    const auto cacheLocation = QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation);
+    return cacheLocation + "/appimagelauncher/metadata-index.json";
+}
+
+std::shared_ptr<AppImageMetadataIndex> AppImageMetadataIndex::instance() {
+    // initialization of function-local statics is threadsafe
+    static const auto index = []() {
+        auto rv = std::make_shared<AppImageMetadataIndex>(defaultIndexFilePath());
+        rv->load();
+        return rv;
+    }();
+
+    return index;
+}
+
+bool AppImageMetadataIndex::readStatData(const QString& path, AppImageMetadata& metadata) {
+    struct stat st{};
+
+    if (stat(path.toStdString().c_str(), &st) != 0)
+        return false;
+
+    metadata.inode = st.st_ino;
+    metadata.size = st.st_size;
+    metadata.mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    metadata.ctime = st.st_ctim.tv_sec * 1000000000LL + st.st_ctim.tv_nsec;
+
+    return true;
+}
+
+bool AppImageMetadataIndex::lookupInFile(const QString& indexFilePath, const QString& path,
+                                         AppImageMetadata& metadata) {
+    AppImageMetadata current;
+
+    if (!readStatData(path, current))
+        return false;
+
+    const auto entriesObj = readEntriesFromFile(indexFilePath);
+
+    const auto it = entriesObj.constFind(path);
+
+    if (it == entriesObj.constEnd())
+        return false;
+
+    const auto entry = metadataFromJson(path, it.value().toObject());
+
+    if (!statDataMatches(entry, current))
+        return false;
+
+    metadata = entry;
+    return true;
+}
+
+bool AppImageMetadataIndex::load() {
+    QMutexLocker lock(&d->mutex);
+
+    d->entries = d->readFromDisk();
+    d->modifiedPaths.clear();
+    d->removedPaths.clear();
+
+    return true;
+}
+
+bool AppImageMetadataIndex::save() {
+    QMutexLocker lock(&d->mutex);
+    return d->save();
+}
+
+void AppImageMetadataIndex::setAutoSave(bool autoSave) {
+    QMutexLocker lock(&d->mutex);
+    d->autoSave = autoSave;
+}
+
+bool AppImageMetadataIndex::lookup(const QString& path, AppImageMetadata& metadata) const {
+    AppImageMetadata current;
+
+    if (!readStatData(path, current))
+        return false;
+
+    QMutexLocker lock(&d->mutex);
+
+    const auto it = d->entries.constFind(path);
+
+    if (it == d->entries.constEnd())
+        return false;
+
+    const auto& entry = it.value();
+
+    if (!statDataMatches(entry, current))
+        return false;
+
+    metadata = entry;
+    return true;
+}
+
+bool AppImageMetadataIndex::lookupUnchecked(const QString& path, AppImageMetadata& metadata) const {
+    QMutexLocker lock(&d->mutex);
+
+    const auto it = d->entries.constFind(path);
+
+    if (it == d->entries.constEnd())
+        return false;
+
+    metadata = it.value();
+    return true;
+}
+
+bool AppImageMetadataIndex::update(AppImageMetadata metadata) {
+    if (!readStatData(metadata.path, metadata)) {
+        remove(metadata.path);
+        return false;
+    }
+
+    QMutexLocker lock(&d->mutex);
+
+    d->entries.insert(metadata.path, metadata);
+    d->removedPaths.remove(metadata.path);
+    d->modifiedPaths.insert(metadata.path);
+
+    d->saveIfNecessary();
+
+    return true;
+}
+
+void AppImageMetadataIndex::remove(const QString& path) {
+    QMutexLocker lock(&d->mutex);
+
+    // the entry might exist on disk only (e.g., if it has been added by another process), therefore the removal
+    // needs to be recorded in any case
+    d->entries.remove(path);
+    d->modifiedPaths.remove(path);
+    d->removedPaths.insert(path);
+
+    d->saveIfNecessary();
+}
+
+QList<AppImageMetadata> AppImageMetadataIndex::entries() const {
+    QMutexLocker lock(&d->mutex);
+    return d->entries.values();
+}
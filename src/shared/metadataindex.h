@@ -0,0 +1,108 @@
+#pragma once
+
+// system headers
+#include <memory>
+
+// library headers
+#include <QList>
+#include <QString>
+
+/*
+ * Metadata about a single file in one of the AppImage locations, as recorded in the metadata index.
+ *
+ * The stat data (inode, size, modification time) is used to detect whether the file has changed since the entry has
+ * been recorded. As long as it matches, the other values can be used without opening the file.
+ */
+struct AppImageMetadata {
+    QString path;
+
+    // stat data, used to validate the entry
+    quint64 inode = 0;
+    qint64 size = -1;
+    // modification time in nanoseconds
+    qint64 mtime = -1;
+    // status change time in nanoseconds
+    // not used to validate the entry, as e.g., changing extended attributes modifies it, but useful for consumers
+    // that need stricter validation (e.g., for cached digests)
+    qint64 ctime = -1;
+
+    // AppImage type as returned by appimage_get_type(), values <= 0 mean "not an AppImage"
+    int type = -1;
+
+    // whether the AppImage has been registered in the system (i.e., desktop file, icons etc. have been installed)
+    bool registered = false;
+
+    // MD5 digest (hexadecimal representation), empty if unknown
+    QString digestMd5;
+
+    // path to the desktop file installed while registering the AppImage, empty if unknown
+    QString desktopFilePath;
+
+    // whether the AppImage contains update information (i.e., can be updated with AppImageUpdate)
+    // < 0: unknown; 0 = false; > 0 = true
+    int hasUpdateInformation = -1;
+};
+
+/*
+ * Persistent index of AppImage metadata, keyed by path.
+ *
+ * The index is stored in the user's cache directory and shared by all AppImageLauncher tools. Modifications are
+ * kept in memory until save() is called, which merges them into the file on disk. This way, multiple processes
+ * (e.g., the daemon and the CLI) can update the index without overwriting each other's entries.
+ *
+ * All methods are threadsafe.
+ */
+class AppImageMetadataIndex {
+private:
+    class PrivateData;
+    std::shared_ptr<PrivateData> d;
+
+public:
+    explicit AppImageMetadataIndex(const QString& indexFilePath);
+
+public:
+    // path to the index file used by instance()
+    static QString defaultIndexFilePath();
+
+    // process-wide index backed by the default index file
+    // it is loaded from disk when this method is called for the first time
+    static std::shared_ptr<AppImageMetadataIndex> instance();
+
+    // read stat data for the given path into metadata
+    // returns false if the file cannot be stat()ed
+    static bool readStatData(const QString& path, AppImageMetadata& metadata);
+
+    // look up a single entry in the given index file, validated like in lookup()
+    // meant for short-lived processes which need a single entry only, as the other entries are not parsed into memory
+    static bool lookupInFile(const QString& indexFilePath, const QString& path, AppImageMetadata& metadata);
+
+public:
+    // (re-)load index from disk, discarding unsaved modifications
+    // a missing index file is not considered an error
+    bool load();
+
+    // merge modifications into the index file on disk
+    bool save();
+
+    // if enabled (the default), every modification is saved to disk right away
+    // batch users like the daemon should disable this and call save() once they're done
+    void setAutoSave(bool autoSave);
+
+    // look up entry for the given path, but only if the file has not changed since the entry has been recorded
+    // returns false if there is no such entry or the entry is outdated
+    bool lookup(const QString& path, AppImageMetadata& metadata) const;
+
+    // look up entry for the given path without validating it against the file on disk
+    bool lookupUnchecked(const QString& path, AppImageMetadata& metadata) const;
+
+    // insert or replace entry
+    // the stat data is refreshed from disk, therefore the entry describes the file's current state
+    // returns false if the file cannot be stat()ed, in which case the previous entry (if any) is removed
+    bool update(AppImageMetadata metadata);
+
+    // remove entry for the given path, if any
+    void remove(const QString& path);
+
+    // list all entries, including potentially outdated ones
+    QList<AppImageMetadata> entries() const;
+};
@@ -0,0 +1,113 @@
+// system headers
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <map>
+#include <string>
+
+// library headers
+#include <QJsonArray>
+#include <QMutex>
+#include <QMutexLocker>
+
+// local headers
+#include "metrics.h"
+
+class Metrics::PrivateData {
+public:
+    struct Histogram {
+        // bucket i counts the samples below 2^i us, the last one takes everything else
+        std::array<quint64, 32> buckets{};
+
+        quint64 count = 0;
+        qint64 sum = 0;
+        qint64 min = std::numeric_limits<qint64>::max();
+        qint64 max = 0;
+
+        void record(qint64 value) {
+            value = std::max<qint64>(value, 0);
+
+            size_t bucket = 0;
+
+            while (bucket < buckets.size() - 1 && (value >> bucket) != 0)
+                ++bucket;
+
+            ++buckets[bucket];
+            ++count;
+            sum += value;
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+    };
+
+    QMutex mutex;
+
+    std::map<std::string, quint64> counters;
+    std::map<std::string, Histogram> histograms;
+};
+
+Metrics::Metrics() : d(std::make_shared<PrivateData>()) {}
+
+std::shared_ptr<Metrics> Metrics::instance() {
+    static const auto metrics = std::make_shared<Metrics>();
+    return metrics;
+}
+
+void Metrics::increment(const char* counter, quint64 value) {
+    QMutexLocker lock(&d->mutex);
+    d->counters[counter] += value;
+}
+
+void Metrics::record(const char* histogram, qint64 durationUs) {
+    QMutexLocker lock(&d->mutex);
+    d->histograms[histogram].record(durationUs);
+}
+
+QJsonObject Metrics::toJson() {
+    QMutexLocker lock(&d->mutex);
+
+    QJsonObject counters;
+
+    for (const auto& counter : d->counters) {
+        counters.insert(QString::fromStdString(counter.first), static_cast<qint64>(counter.second));
+    }
+
+    QJsonObject histograms;
+
+    for (const auto& pair : d->histograms) {
+        const auto& histogram = pair.second;
+
+        QJsonArray buckets;
+
+        for (size_t i = 0; i < histogram.buckets.size(); ++i) {
+            if (histogram.buckets[i] == 0)
+                continue;
+
+            // the last bucket has no upper bound
+            const auto upperBound = i < histogram.buckets.size() - 1 ? QJsonValue(static_cast<qint64>(1) << i) : QJsonValue();
+
+            buckets.append(QJsonArray{upperBound, static_cast<qint64>(histogram.buckets[i])});
+        }
+
+        histograms.insert(QString::fromStdString(pair.first), QJsonObject{
+            {"count", static_cast<qint64>(histogram.count)},
+            {"sum_us", histogram.sum},
+            {"min_us", histogram.count > 0 ? histogram.min : 0},
+            {"max_us", histogram.max},
+            {"buckets", buckets},
+        });
+    }
+
+    return QJsonObject{
+        {"counters", counters},
+        {"histograms", histograms},
+    };
+}
+
+MetricsTimer::MetricsTimer(const char* histogram) : histogram(histogram) {
+    timer.start();
+}
+
+MetricsTimer::~MetricsTimer() {
+    Metrics::instance()->record(histogram, timer.nsecsElapsed() / 1000);
+}
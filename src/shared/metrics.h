@@ -0,0 +1,51 @@
+#pragma once
+
+// system headers
+#include <memory>
+
+// library headers
+#include <QElapsedTimer>
+#include <QJsonObject>
+
+/*
+ * Process-wide registry of counters and latency histograms, used to find out where the time is spent.
+ *
+ * The histograms' buckets are powers of two (in microseconds), so recording a sample is cheap, and the memory needed
+ * doesn't depend on the number of samples. Names are expected to be string literals like "worker.integrate".
+ *
+ * All methods are threadsafe.
+ */
+class Metrics {
+private:
+    class PrivateData;
+    std::shared_ptr<PrivateData> d;
+
+public:
+    Metrics();
+
+public:
+    static std::shared_ptr<Metrics> instance();
+
+public:
+    void increment(const char* counter, quint64 value = 1);
+    void record(const char* histogram, qint64 durationUs);
+
+    // snapshot of all values recorded so far
+    // {"counters": {<name>: <value>}, "histograms": {<name>: {"count", "sum_us", "min_us", "max_us", "buckets"}}}
+    // buckets are listed as [<upper bound in us>, <count>] pairs, empty buckets are omitted
+    QJsonObject toJson();
+};
+
+// records the lifetime of the object in the given histogram of the process-wide registry
+class MetricsTimer {
+private:
+    const char* histogram;
+    QElapsedTimer timer;
+
+public:
+    explicit MetricsTimer(const char* histogram);
+    ~MetricsTimer();
+
+    MetricsTimer(const MetricsTimer&) = delete;
+    MetricsTimer& operator=(const MetricsTimer&) = delete;
+};
@@ -0,0 +1,292 @@
+// system headers
+#include <iostream>
+
+// library headers
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonParseError>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// local headers
+#include "desktopintegrationbatch.h"
+#include "filelock.h"
+#include "registrationmanifest.h"
+
+// manifests with a different version are discarded, therefore this needs to be bumped on incompatible changes
+static constexpr int MANIFEST_FORMAT_VERSION = 1;
+
+typedef QMap<QString, RegistrationManifest::Entry> Entries;
+
+namespace {
+    // registrations recorded while a batch is active, process-wide like the batch itself
+    struct PendingRegistrations {
+        // must be held while the buffered registrations are written, so that they can't overwrite a later removal
+        QMutex mutex;
+
+        // desktop file paths, keyed by the AppImage paths
+        QMap<QString, QString> desktopFilePaths;
+    };
+
+    PendingRegistrations& pendingRegistrations() {
+        static PendingRegistrations pending;
+        return pending;
+    }
+}
+
+static Entries readManifest() {
+    Entries rv;
+
+    QFile file(RegistrationManifest::manifestFilePath());
+
+    if (!file.exists())
+        return rv;
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Warning: could not open registration manifest for reading" << std::endl;
+        return rv;
+    }
+
+    QJsonParseError parseError{};
+    const auto jsonDoc = QJsonDocument::fromJson(file.readAll(), &parseError);
+
+    // if the manifest is lost, the clean up falls back to inspecting the desktop files, so this is not fatal
+    if (parseError.error != QJsonParseError::NoError || !jsonDoc.isObject()) {
+        std::cerr << "Warning: registration manifest is corrupt, discarding: "
+                  << parseError.errorString().toStdString() << std::endl;
+        return rv;
+    }
+
+    const auto rootObj = jsonDoc.object();
+
+    if (rootObj["version"].toInt() != MANIFEST_FORMAT_VERSION) {
+        qDebug() << "registration manifest has incompatible version, discarding";
+        return rv;
+    }
+
+    const auto registrationsObj = rootObj["registrations"].toObject();
+
+    for (auto it = registrationsObj.constBegin(); it != registrationsObj.constEnd(); ++it) {
+        const auto entryObj = it.value().toObject();
+
+        RegistrationManifest::Entry entry;
+        entry.appImagePath = it.key();
+        entry.desktopFilePath = entryObj["desktop_file"].toString();
+
+        for (const auto& value : entryObj["other_files"].toArray()) {
+            entry.otherFilePaths << value.toString();
+        }
+
+        rv.insert(entry.appImagePath, entry);
+    }
+
+    return rv;
+}
+
+static bool writeManifest(const Entries& entries) {
+    const auto path = RegistrationManifest::manifestFilePath();
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+
+    QSaveFile file(path);
+
+    if (!file.open(QIODevice::WriteOnly)) {
+        std::cerr << "Warning: could not open registration manifest for writing" << std::endl;
+        return false;
+    }
+
+    QJsonObject registrationsObj;
+
+    for (const auto& entry : entries) {
+        QJsonObject entryObj;
+        entryObj["desktop_file"] = entry.desktopFilePath;
+        entryObj["other_files"] = QJsonArray::fromStringList(entry.otherFilePaths);
+
+        registrationsObj[entry.appImagePath] = entryObj;
+    }
+
+    QJsonObject rootObj;
+    rootObj["version"] = MANIFEST_FORMAT_VERSION;
+    rootObj["registrations"] = registrationsObj;
+
+    file.write(QJsonDocument(rootObj).toJson(QJsonDocument::Compact));
+
+    return file.commit();
+}
+
+QString RegistrationManifest::manifestFilePath() {
+    const auto dataLocation = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    return dataLocation + "/appimagelauncher/registrations.json";
+}
+
+QStringList RegistrationManifest::findFilesRelatedToDesktopFile(const QString& desktopFilePath) {
+    return findFilesRelatedToDesktopFiles({desktopFilePath}).value(desktopFilePath);
+}
+
+QMap<QString, QStringList> RegistrationManifest::findFilesRelatedToDesktopFiles(const QStringList& desktopFilePaths) {
+    // libappimage's desktop files are named appimagekit_<md5 of the AppImage's path>-<name>.desktop
+    // the icons and MIME definitions start with appimagekit_<md5>, too
+    QMap<QString, QString> prefixes;
+
+    for (const auto& desktopFilePath : desktopFilePaths) {
+        const auto prefix = QFileInfo(desktopFilePath).fileName().section('-', 0, 0);
+
+        if (prefix.startsWith("appimagekit_") && !prefix.endsWith(".desktop"))
+            prefixes.insert(desktopFilePath, prefix);
+    }
+
+    QMap<QString, QStringList> rv;
+
+    if (prefixes.isEmpty())
+        return rv;
+
+    const auto nameFilters = QStringList{"appimagekit_*"};
+
+    const auto dataLocation = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+
+    auto addMatchingFiles = [&rv, &prefixes, &nameFilters](const QString& dirPath) {
+        for (const auto& fileInfo : QDir(dirPath).entryInfoList(nameFilters, QDir::Files)) {
+            for (auto it = prefixes.constBegin(); it != prefixes.constEnd(); ++it) {
+                if (fileInfo.fileName().startsWith(it.value()))
+                    rv[it.key()] << fileInfo.absoluteFilePath();
+            }
+        }
+    };
+
+    // icons are installed into <size>/<context> directories of the hicolor theme
+    const QDir hicolorDir(dataLocation + "/icons/hicolor");
+
+    for (const auto& sizeDirInfo : hicolorDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+        const QDir sizeDir(sizeDirInfo.absoluteFilePath());
+
+        for (const auto& contextDirInfo : sizeDir.entryInfoList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            addMatchingFiles(contextDirInfo.absoluteFilePath());
+        }
+    }
+
+    addMatchingFiles(dataLocation + "/mime/packages");
+
+    return rv;
+}
+
+bool RegistrationManifest::record(const Entry& entry) {
+    return record(QList<Entry>{entry});
+}
+
+bool RegistrationManifest::record(const QList<Entry>& newEntries) {
+    if (newEntries.isEmpty())
+        return true;
+
+    FileLock lock(manifestFilePath() + ".lock");
+
+    auto entries = readManifest();
+
+    for (const auto& entry : newEntries) {
+        entries.insert(entry.appImagePath, entry);
+    }
+
+    return writeManifest(entries);
+}
+
+bool RegistrationManifest::recordRegistration(const QString& appImagePath, const QString& desktopFilePath) {
+    auto& pending = pendingRegistrations();
+
+    {
+        QMutexLocker lock(&pending.mutex);
+
+        // the batch calls flush() after it has ended, which has to wait for the mutex, so the registration can't get
+        // lost in between
+        if (DesktopIntegrationBatch::isActive()) {
+            pending.desktopFilePaths.insert(appImagePath, desktopFilePath);
+            return true;
+        }
+    }
+
+    Entry entry;
+    entry.appImagePath = appImagePath;
+    entry.desktopFilePath = desktopFilePath;
+    entry.otherFilePaths = findFilesRelatedToDesktopFile(desktopFilePath);
+
+    return record(entry);
+}
+
+// caution: the pending registrations' mutex must be held by the caller
+static bool flushPendingRegistrations(PendingRegistrations& pending) {
+    if (pending.desktopFilePaths.isEmpty())
+        return true;
+
+    // the icons directories are searched once for all the registrations
+    const auto relatedFiles = RegistrationManifest::findFilesRelatedToDesktopFiles(pending.desktopFilePaths.values());
+
+    QList<RegistrationManifest::Entry> entries;
+
+    for (auto it = pending.desktopFilePaths.constBegin(); it != pending.desktopFilePaths.constEnd(); ++it) {
+        RegistrationManifest::Entry entry;
+        entry.appImagePath = it.key();
+        entry.desktopFilePath = it.value();
+        entry.otherFilePaths = relatedFiles.value(it.value());
+
+        entries << entry;
+    }
+
+    // the registrations are dropped even on errors, the clean up falls back to inspecting the desktop files anyway
+    pending.desktopFilePaths.clear();
+
+    return RegistrationManifest::record(entries);
+}
+
+bool RegistrationManifest::flush() {
+    auto& pending = pendingRegistrations();
+
+    QMutexLocker pendingLock(&pending.mutex);
+    return flushPendingRegistrations(pending);
+}
+
+bool RegistrationManifest::remove(const QStringList& appImagePaths) {
+    if (appImagePaths.isEmpty())
+        return true;
+
+    auto& pending = pendingRegistrations();
+
+    QMutexLocker pendingLock(&pending.mutex);
+
+    for (const auto& path : appImagePaths) {
+        pending.desktopFilePaths.remove(path);
+    }
+
+    FileLock lock(manifestFilePath() + ".lock");
+
+    auto entries = readManifest();
+
+    auto modified = false;
+
+    for (const auto& path : appImagePaths) {
+        modified = entries.remove(path) > 0 || modified;
+    }
+
+    if (!modified)
+        return true;
+
+    return writeManifest(entries);
+}
+
+QList<RegistrationManifest::Entry> RegistrationManifest::entries() {
+    auto& pending = pendingRegistrations();
+
+    QMutexLocker pendingLock(&pending.mutex);
+
+    // the clean up would otherwise inspect the desktop files of the AppImages registered in the current batch
+    if (!flushPendingRegistrations(pending))
+        std::cerr << "Warning: failed to update registration manifest" << std::endl;
+
+    FileLock lock(manifestFilePath() + ".lock");
+    return readManifest().values();
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+// library headers
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+/*
+ * Records which files have been installed while registering an AppImage in the system (desktop file, icons, MIME
+ * definitions).
+ *
+ * This allows cleaning up after AppImages that have been removed by simply deleting the recorded files, instead of
+ * having to parse all desktop files and search the icons directories for related files.
+ *
+ * The manifest is stored in the user's data directory. Modifications are merged into the file on disk, so multiple
+ * processes may use it concurrently. While a DesktopIntegrationBatch is active, registrations are buffered, and
+ * written once when the batch ends.
+ *
+ * All methods are threadsafe.
+ */
+class RegistrationManifest {
+public:
+    struct Entry {
+        QString appImagePath;
+        QString desktopFilePath;
+        // icons and MIME definitions
+        QStringList otherFilePaths;
+    };
+
+public:
+    static QString manifestFilePath();
+
+    // look up the icons and MIME definitions installed by libappimage alongside the given desktop file
+    // libappimage uses the same unique prefix for all the files it installs for an AppImage
+    static QStringList findFilesRelatedToDesktopFile(const QString& desktopFilePath);
+
+    // same as above for multiple desktop files, searching the directories only once
+    // the result is keyed by the desktop file paths
+    static QMap<QString, QStringList> findFilesRelatedToDesktopFiles(const QStringList& desktopFilePaths);
+
+    // insert or replace the entry for entry.appImagePath
+    static bool record(const Entry& entry);
+
+    // same as above for multiple entries, the manifest is written only once
+    static bool record(const QList<Entry>& entries);
+
+    // insert or replace the entry for an AppImage which has just been registered, looking up the related files
+    // while a DesktopIntegrationBatch is active, this is deferred to flush()
+    static bool recordRegistration(const QString& appImagePath, const QString& desktopFilePath);
+
+    // write the registrations buffered while a batch was active
+    // called by DesktopIntegrationBatch when the outermost batch ends
+    static bool flush();
+
+    // remove entries for the given AppImages
+    static bool remove(const QStringList& appImagePaths);
+
+    // includes the buffered registrations
+    static QList<Entry> entries();
+};
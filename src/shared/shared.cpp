@@ -1,13 +1,18 @@
 // system includes
-#include <fstream>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
+#include <map>
 #include <memory>
 #include <sstream>
 #include <tuple>
 extern "C" {
     #include <appimage/appimage.h>
+    #include <fcntl.h>
     #include <glib.h>
     // #include <libgen.h>
+    #include <mntent.h>
+    #include <sys/inotify.h>
     #include <sys/stat.h>
     #include <stdio.h>
     #include <unistd.h>
@@ -25,6 +30,8 @@ extern "C" {
 #include <QMap>
 #include <QMapIterator>
 #include <QMessageBox>
+#include <QMutex>
+#include <QMutexLocker>
 #include <QObject>
 #include <QRegularExpression>
 #include <QSet>
@@ -33,12 +40,22 @@ extern "C" {
 #include <QWindow>
 #include <QPushButton>
 #include <QPixmap>
+#include <QProcess>
+#include <QProgressDialog>
 #ifdef ENABLE_UPDATE_HELPER
 #include <appimage/update.h>
 #endif
 
 // local headers
 #include "shared.h"
+#include "desktopfilenameindex.h"
+#include "desktopintegrationbatch.h"
+#include "digest.h"
+#include "digestcache.h"
+#include "fastcopy.h"
+#include "metadataindex.h"
+#include "metrics.h"
+#include "registrationmanifest.h"
 #include "translationmanager.h"
 
 static void gKeyFileDeleter(GKeyFile* ptr) {
@@ -175,12 +192,50 @@ void createConfigFile(int askToMove,
         }
         file.write("\n");
     }
+
+    // advanced settings, which are not exposed in the UI
+    // size (in bytes) of the buffer used to read file system events, increase if events get lost frequently
+    file.write("# inotify_read_buffer_size = 65536\n");
+    // number of subdirectory levels to watch below the watched directories, 0 watches the directories only
+    file.write("# watch_subdirectories_depth = 0\n");
+    // scheduled (un)integrations are executed once no further changes have been detected for the quiet period, but
+    // no later than the max latency after the first change (in milliseconds)
+    file.write("# debounce_quiet_period_ms = 500\n");
+    file.write("# debounce_max_latency_ms = 5000\n");
+    // maximum number of AppImages (un)integrated in parallel
+    file.write("# max_worker_threads = 2\n");
+    // removed AppImages are kept in the trash bin for the given number of days (0 removes them right away), and as
+    // long as the trash bin doesn't exceed the given size (in MiB, -1 means unlimited)
+    file.write("# trash_max_age_days = 0\n");
+    file.write("# trash_max_size_mib = -1\n");
+
+    file.close();
+
+    // the change would be noticed anyway, but inotify might not be available
+    invalidateConfig();
 }
 
 
-std::shared_ptr<QSettings> getConfig() {
-    auto configFilePath = getConfigFilePath();
+ConfigSnapshot::ConfigSnapshot(QVariantMap values) : values(std::move(values)) {}
+
+std::shared_ptr<const ConfigSnapshot> ConfigSnapshot::fromSettings(const QSettings& settings) {
+    QVariantMap values;
+
+    for (const auto& key : settings.allKeys())
+        values.insert(key, settings.value(key));
 
+    return std::make_shared<const ConfigSnapshot>(std::move(values));
+}
+
+bool ConfigSnapshot::contains(const QString& key) const {
+    return values.contains(key);
+}
+
+QVariant ConfigSnapshot::value(const QString& key, const QVariant& defaultValue) const {
+    return values.value(key, defaultValue);
+}
+
+static std::shared_ptr<const ConfigSnapshot> readConfig(const QString& configFilePath) {
     // if the file does not exist, we'll just use the standard location
     // while in theory it would have been possible to just write the default location to the file, if we'd ever change
     // it again, we'd leave a lot of systems in the old state, and would have to write some complex code to resolve
@@ -190,20 +245,169 @@ std::shared_ptr<QSettings> getConfig() {
         return nullptr;
     }
 
-    auto rv = std::make_shared<QSettings>(configFilePath, QSettings::IniFormat);
+    // the settings object is only used to parse the file, and must not be modified, otherwise it would write back to
+    // the file, triggering our own inotify watch
+    const QSettings settings(configFilePath, QSettings::IniFormat);
 
-    // expand ~ in paths in the config file with $HOME
-    const auto keysContainingPath = {
-        "AppImageLauncher/destination",
-    };
-    for (const QString& keyContainingPath : keysContainingPath){
-        if (rv->contains(keyContainingPath)) {
-            auto newValue = expandTilde(rv->value(keyContainingPath).toString());
-            rv->setValue(keyContainingPath, newValue);
+    return ConfigSnapshot::fromSettings(settings);
+}
+
+namespace {
+    // process-wide snapshot of the config file
+    // the snapshot is invalidated whenever an inotify watch on the config directory reports a change to the config
+    // file, so that the file is read only when it has actually changed
+    // the inotify instance is non-blocking and drained whenever the snapshot is accessed, therefore no event loop is
+    // required
+    class ConfigCache {
+    public:
+        QMutex mutex;
+
+        QString configFilePath;
+        std::shared_ptr<const ConfigSnapshot> config;
+        bool valid = false;
+        quint64 generation = 0;
+
+        int inotifyFd = -1;
+        int watchDescriptor = -1;
+
+    public:
+        static ConfigCache& instance() {
+            // initialization of function-local statics is threadsafe
+            static ConfigCache cache;
+            return cache;
         }
-    }
 
-    return rv;
+        ~ConfigCache() {
+            if (inotifyFd >= 0)
+                close(inotifyFd);
+        }
+
+    public:
+        // caution: mutex must be held by the caller
+        // returns false if the config directory cannot be watched, in which case the snapshot must not be reused
+        bool ensureWatch() {
+            if (inotifyFd < 0) {
+                inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+                if (inotifyFd < 0)
+                    return false;
+            }
+
+            if (watchDescriptor < 0) {
+                // editors and QSaveFile tend to replace files rather than modifying them, so we need to watch the
+                // directory
+                const auto configDirPath = QFileInfo(configFilePath).absolutePath().toStdString();
+
+                watchDescriptor = inotify_add_watch(
+                    inotifyFd, configDirPath.c_str(),
+                    IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF
+                );
+            }
+
+            return watchDescriptor >= 0;
+        }
+
+        // caution: mutex must be held by the caller
+        // reads all pending events, and invalidates the snapshot if the config file might have changed
+        void processEvents() {
+            if (inotifyFd < 0)
+                return;
+
+            const auto configFileName = QFileInfo(configFilePath).fileName().toStdString();
+
+            alignas(struct inotify_event) char buffer[4096];
+
+            while (true) {
+                const auto bytesRead = read(inotifyFd, buffer, sizeof(buffer));
+
+                if (bytesRead <= 0) {
+                    // EAGAIN: all events have been read
+                    if (bytesRead < 0 && errno == EINTR)
+                        continue;
+
+                    break;
+                }
+
+                for (ssize_t offset = 0; offset < bytesRead;) {
+                    const auto* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+                    offset += sizeof(struct inotify_event) + event->len;
+
+                    // the directory itself is gone, or events have been lost, so we have to start over
+                    if ((event->mask & (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF | IN_Q_OVERFLOW)) != 0) {
+                        if ((event->mask & IN_IGNORED) != 0)
+                            watchDescriptor = -1;
+
+                        valid = false;
+                        continue;
+                    }
+
+                    if (event->len > 0 && configFileName == event->name)
+                        valid = false;
+                }
+            }
+        }
+
+        // caution: mutex must be held by the caller
+        void update() {
+            const auto currentConfigFilePath = getConfigFilePath();
+
+            // unlikely, but the location depends on the environment
+            if (currentConfigFilePath != configFilePath) {
+                if (watchDescriptor >= 0)
+                    inotify_rm_watch(inotifyFd, watchDescriptor);
+
+                // the events for the old watch must not be mistaken for ones for the new watch
+                processEvents();
+
+                watchDescriptor = -1;
+                configFilePath = currentConfigFilePath;
+                valid = false;
+            }
+
+            processEvents();
+
+            if (valid)
+                return;
+
+            // the watch must be set up before reading the file, otherwise changes in between would go unnoticed
+            const auto watching = ensureWatch();
+
+            config = readConfig(configFilePath);
+            ++generation;
+
+            // without a watch, we cannot tell whether the file changes, so it has to be read every time
+            valid = watching;
+        }
+    };
+}
+
+std::shared_ptr<const ConfigSnapshot> getConfig() {
+    auto& cache = ConfigCache::instance();
+
+    QMutexLocker lock(&cache.mutex);
+    cache.update();
+
+    return cache.config;
+}
+
+std::shared_ptr<const ConfigSnapshot> readConfigFile() {
+    return readConfig(getConfigFilePath());
+}
+
+quint64 configGeneration() {
+    auto& cache = ConfigCache::instance();
+
+    QMutexLocker lock(&cache.mutex);
+    cache.update();
+
+    return cache.generation;
+}
+
+void invalidateConfig() {
+    auto& cache = ConfigCache::instance();
+
+    QMutexLocker lock(&cache.mutex);
+    cache.valid = false;
 }
 
 // TODO: check if this works with Wayland
@@ -261,14 +465,16 @@ void displayWarning(const QString& message) {
 }
 
 QDir integratedAppImagesDestination() {
-    auto config = getConfig();
+    return integratedAppImagesDestination(getConfig());
+}
 
+QDir integratedAppImagesDestination(const std::shared_ptr<const ConfigSnapshot>& config) {
     if (config == nullptr)
         return DEFAULT_INTEGRATION_DESTINATION;
 
     static const QString keyName("AppImageLauncher/destination");
     if (config->contains(keyName))
-        return config->value(keyName).toString();
+        return expandTilde(config->value(keyName).toString());
 
     return DEFAULT_INTEGRATION_DESTINATION;
 }
@@ -313,15 +519,19 @@ public:
 QList<Mount> listMounts() {
     QList<Mount> mountedDirectories;
 
-    std::ifstream ifs("/proc/mounts");
+    // getmntent() takes care of decoding escaped characters like spaces in paths, which a simple split() doesn't
+    std::unique_ptr<FILE, int (*)(FILE*)> mountTable(setmntent("/proc/self/mounts", "r"), endmntent);
 
-    std::string _currentLine;
-    while (std::getline(ifs, _currentLine)) {
-        const auto currentLine = QString::fromStdString(_currentLine);
+    if (mountTable == nullptr) {
+        std::cerr << "Warning: could not read mount table" << std::endl;
+        return mountedDirectories;
+    }
 
-        const auto parts = currentLine.split(" ");
+    struct mntent entry{};
+    char buffer[4096];
 
-        mountedDirectories << Mount{parts[0], parts[1], parts[2], parts[3]};
+    while (getmntent_r(mountTable.get(), &entry, buffer, sizeof(buffer)) != nullptr) {
+        mountedDirectories << Mount{entry.mnt_fsname, entry.mnt_dir, entry.mnt_type, entry.mnt_opts};
     }
 
     return mountedDirectories;
@@ -404,12 +614,12 @@ QSet<QString> additionalAppImagesLocations(const bool includeAllMountPoints) {
     return additionalLocations;
 }
 
-bool shallMonitorMountedFilesystems(std::shared_ptr<QSettings> config) {
+bool shallMonitorMountedFilesystems(const std::shared_ptr<const ConfigSnapshot>& config) {
     return config != nullptr &&
            config->value("appimagelauncherd/monitor_mounted_filesystems", "false").toBool();
 }
 
-QDirSet getAdditionalDirectoriesFromConfig(const std::shared_ptr<QSettings>& config) {
+QDirSet getAdditionalDirectoriesFromConfig(const std::shared_ptr<const ConfigSnapshot>& config) {
     // getConfig might've returned a null pointer, therefore we have to check this before proceeding
     if (config == nullptr)
         return {};
@@ -442,9 +652,9 @@ QDirSet getAdditionalDirectoriesFromConfig(const std::shared_ptr<QSettings>& con
 
         const QDir dir(dirPath);
 
+        // the directory is included nevertheless, the file system watcher will pick it up once it has been created
         if (!dir.exists()) {
-            std::cerr << "Warning: could not find directory " << dirPath.toStdString() << ", skipping" << std::endl;
-            continue;
+            std::cerr << "Warning: could not find directory " << dirPath.toStdString() << std::endl;
         }
 
         additionalDirs.insert(dir);
@@ -453,7 +663,7 @@ QDirSet getAdditionalDirectoriesFromConfig(const std::shared_ptr<QSettings>& con
     return additionalDirs;
 }
 
-QDirSet daemonDirectoriesToWatch(const std::shared_ptr<QSettings>& config) {
+QDirSet daemonDirectoriesToWatch(const std::shared_ptr<const ConfigSnapshot>& config) {
     auto watchedDirectories = QDirSet();
 
     // of course we need to watch the main integration directory
@@ -514,62 +724,153 @@ QString buildPathToIntegratedAppImage(const QString& pathToAppImage) {
 }
 
 std::map<std::string, std::string> findCollisions(const QString& currentNameEntry) {
-    std::map<std::string, std::string> collisions{};
+    MetricsTimer timer("collisions.lookup");
 
-    // default locations of desktop files on systems
-    const auto directories = {
-        QString("/usr/share/applications/"),
-        QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/applications/"
-    };
+    // the index makes sure only desktop files which have changed since the last call are parsed
+    return DesktopFileNameIndex::instance()->findByNamePrefix(currentNameEntry);
+}
 
-    for (const auto& directory : directories) {
-        QDirIterator iterator(directory, QDirIterator::FollowSymlinks);
+// defined below
+QString which(const std::string& name);
 
-        while (iterator.hasNext()) {
-            const auto filename = iterator.next();
+// the parts of the data directory the desktop integration tools operate on
+static QString desktopIntegrationTreePath(DesktopIntegrationTree tree) {
+    const auto dataLocation = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
 
-            if (!QFileInfo(filename).isFile() || !filename.endsWith(".desktop"))
-                continue;
+    switch (tree) {
+        case APPLICATIONS_TREE:
+            return dataLocation + "/applications";
+        case ICONS_TREE:
+            return dataLocation + "/icons";
+        case MIME_TREE:
+            return dataLocation + "/mime";
+        default:
+            return "";
+    }
+}
 
-            std::shared_ptr<GKeyFile> desktopFile(g_key_file_new(), gKeyFileDeleter);
-            std::shared_ptr<GError*> error(nullptr, gErrorDeleter);
+static const DesktopIntegrationTree allDesktopIntegrationTrees[] = {APPLICATIONS_TREE, ICONS_TREE, MIME_TREE};
 
-            // if the key file parser can't load the file, it's most likely not a valid desktop file, so we just skip this file
-            if (!g_key_file_load_from_file(desktopFile.get(), filename.toStdString().c_str(), G_KEY_FILE_KEEP_TRANSLATIONS, error.get()))
-                continue;
+// the desktop integration trees the given files reside in
+static int desktopIntegrationTreesOf(const QStringList& paths) {
+    int trees = 0;
 
-            auto* nameEntry = g_key_file_get_string(desktopFile.get(), G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_NAME, error.get());
+    for (const auto tree : allDesktopIntegrationTrees) {
+        const auto treePath = desktopIntegrationTreePath(tree) + "/";
 
-            // invalid desktop file, needs to be skipped
-            if (nameEntry == nullptr)
-                continue;
-
-            if (QString(nameEntry).trimmed().startsWith(currentNameEntry.trimmed())) {
-                collisions[filename.toStdString()] = nameEntry;
+        for (const auto& path : paths) {
+            if (path.startsWith(treePath)) {
+                trees |= tree;
+                break;
             }
         }
     }
 
-    return collisions;
+    return trees;
 }
 
-bool updateDesktopDatabaseAndIconCaches() {
-    const auto dataLocation = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+// the desktop integration trees libappimage installs files into when registering an AppImage
+// every registration includes a desktop file and icons, but MIME definitions are installed only if the AppImage ships
+// any, which can be checked cheaply, as they are all stored in a single directory
+static int desktopIntegrationTreesOfRegistration(const QString& desktopFilePath) {
+    int trees = APPLICATIONS_TREE | ICONS_TREE;
+
+    // see RegistrationManifest::findFilesRelatedToDesktopFiles()
+    const auto prefix = QFileInfo(desktopFilePath).fileName().section('-', 0, 0);
+    const QDir mimePackagesDir(desktopIntegrationTreePath(MIME_TREE) + "/packages");
+
+    if (!prefix.startsWith("appimagekit_") || !mimePackagesDir.entryList({prefix + "*"}, QDir::Files).isEmpty())
+        trees |= MIME_TREE;
+
+    return trees;
+}
+
+bool updateDesktopDatabaseAndIconCaches(int trees) {
+    if (trees == 0) {
+        qDebug() << "no desktop integration trees changed, not updating desktop database and icon caches";
+        return true;
+    }
+
+    MetricsTimer timer("caches.refresh");
+
+    struct Command {
+        std::string name;
+        QStringList arguments;
+    };
 
-    const std::map<std::string, std::string> commands = {
-        {"update-desktop-database", dataLocation.toStdString() + "/applications"},
-        {"gtk-update-icon-cache-3.0", dataLocation.toStdString() + "/icons/hicolor/ -t"},
-        {"gtk-update-icon-cache", dataLocation.toStdString() + "/icons/hicolor/ -t"},
-        {"xdg-desktop-menu", "forceupdate"},
-        {"update-mime-database", dataLocation.toStdString() + "/mime "},
-        {"update-icon-caches", dataLocation.toStdString() + "/icons/"},
+    // commands operating on the same tree must not run in parallel, so they are grouped by tree
+    const std::map<DesktopIntegrationTree, std::vector<Command>> commandsPerTree = {
+        {APPLICATIONS_TREE, {
+            {"update-desktop-database", {desktopIntegrationTreePath(APPLICATIONS_TREE)}},
+            {"xdg-desktop-menu", {"forceupdate"}},
+        }},
+        {ICONS_TREE, {
+            {"gtk-update-icon-cache-3.0", {desktopIntegrationTreePath(ICONS_TREE) + "/hicolor/", "-t"}},
+            {"gtk-update-icon-cache", {desktopIntegrationTreePath(ICONS_TREE) + "/hicolor/", "-t"}},
+            {"update-icon-caches", {desktopIntegrationTreePath(ICONS_TREE) + "/"}},
+        }},
+        {MIME_TREE, {
+            {"update-mime-database", {desktopIntegrationTreePath(MIME_TREE)}},
+        }},
     };
 
-    for (const auto& command : commands) {
-        // only call if the command exists
-        if (system(("which " + command.first + " 2>&1 1>/dev/null").c_str()) == 0) {
+    // looking up the tools is rather expensive, and they're unlikely to be (un)installed while we're running
+    static const auto toolPaths = []() {
+        std::map<std::string, QString> paths;
+
+        for (const auto name : {"update-desktop-database", "xdg-desktop-menu", "gtk-update-icon-cache-3.0",
+                                "gtk-update-icon-cache", "update-icon-caches", "update-mime-database"}) {
+            // only use the command if it exists
+            const auto path = which(name);
+
+            if (!path.isEmpty())
+                paths[name] = path;
+        }
+
+        return paths;
+    }();
+
+    // the commands of all selected trees are run in parallel in waves, i.e., the n-th command of every tree is
+    // launched once all the (n-1)-th commands have finished
+    std::vector<std::vector<Command>> queues;
+
+    for (const auto& pair : commandsPerTree) {
+        if (!(trees & pair.first))
+            continue;
+
+        std::vector<Command> queue;
+
+        for (const auto& command : pair.second) {
+            if (toolPaths.find(command.name) != toolPaths.end())
+                queue.push_back(command);
+        }
+
+        queues.push_back(queue);
+    }
+
+    for (size_t wave = 0;; ++wave) {
+        std::vector<std::shared_ptr<QProcess>> processes;
+
+        for (const auto& queue : queues) {
+            if (wave >= queue.size())
+                continue;
+
+            const auto& command = queue[wave];
+
+            std::shared_ptr<QProcess> process(new QProcess);
+            // the tools' output is not of any interest to us, but should not be lost either
+            process->setProcessChannelMode(QProcess::ForwardedChannels);
+            process->start(toolPaths.at(command.name), command.arguments);
+
+            processes.push_back(process);
+        }
+
+        if (processes.empty())
+            break;
+
+        for (const auto& process : processes) {
             // exit codes are not evaluated intentionally
-            system((command.first + " " + command.second).c_str());
+            process->waitForFinished(-1);
         }
     }
 
@@ -615,7 +916,157 @@ QString privateLibDirPath(const QString& srcSubdirName) {
 }
 #endif
 
+// translations of the names of the desktop actions AppImageLauncher adds to the desktop files, per locale
+struct DesktopActionNameTranslations {
+    QMap<QString, QString> remove;
+    QMap<QString, QString> update;
+};
+
+// the translations are loaded from the JSON file(s) the first time they are needed, and then shared by all
+// integrations performed by this process
+static const DesktopActionNameTranslations& desktopActionNameTranslations() {
+    // initialization of function-local statics is threadsafe
+    static const auto translations = []() {
+        DesktopActionNameTranslations rv;
+
+#ifdef ENABLE_UPDATE_HELPER
+        QDirIterator i18nDirIterator(TranslationManager::getTranslationDir());
+
+        while(i18nDirIterator.hasNext()) {
+            const auto& filePath = i18nDirIterator.next();
+            const auto& fileName = QFileInfo(filePath).fileName();
+
+            if (!QFileInfo(filePath).isFile() || !(fileName.startsWith("desktopfiles.") && fileName.endsWith(".json")))
+                continue;
+
+            // check whether filename's format is alright, otherwise parsing the locale might try to access a
+            // non-existing (or the wrong) member
+            auto splitFilename = fileName.split(".");
+
+            if (splitFilename.size() != 3)
+                continue;
+
+            // parse locale from filename
+            auto locale = splitFilename[1];
+
+            QFile jsonFile(filePath);
+
+            if (!jsonFile.open(QIODevice::ReadOnly)) {
+                displayWarning(QMessageBox::tr("Could not parse desktop file translations:\nCould not open file for reading:\n\n%1").arg(fileName));
+                continue;
+            }
+
+            // TODO: need to make sure that this doesn't try to read huge files at once
+            auto data = jsonFile.readAll();
+
+            QJsonParseError parseError{};
+            auto jsonDoc = QJsonDocument::fromJson(data, &parseError);
+
+            // show warning on syntax errors and continue
+            if (parseError.error != QJsonParseError::NoError || jsonDoc.isNull() || !jsonDoc.isObject()) {
+                displayWarning(QMessageBox::tr("Could not parse desktop file translations:\nInvalid syntax:\n\n%1").arg(parseError.errorString()));
+                continue;
+            }
+
+            auto jsonObj = jsonDoc.object();
+
+            for (const auto& key : jsonObj.keys()) {
+                auto value = jsonObj[key].toString();
+
+                if (key.startsWith("Desktop Action update")) {
+                    qDebug() << "update: adding" << value << "for locale" << locale;
+                    rv.update[locale] = value;
+                } else if (key.startsWith("Desktop Action remove")) {
+                    qDebug() << "remove: adding" << value << "for locale" << locale;
+                    rv.remove[locale] = value;
+                }
+            }
+        }
+#endif
+
+        return rv;
+    }();
+
+    return translations;
+}
+
 bool installDesktopFileAndIcons(const QString& pathToAppImage, bool resolveCollisions) {
+    AppImageHandle appImage(pathToAppImage);
+    return installDesktopFileAndIcons(appImage, resolveCollisions);
+}
+
+// replaces the desktop file atomically (i.e., readers see either the old or the new version, never a partial one), and
+// makes it executable ("trustworthy" to some DEs) in the same go
+// while a DesktopIntegrationBatch is active, syncing the file to disk is deferred to the end of the batch
+static bool writeDesktopFile(const QString& path, GKeyFile* desktopFile) {
+    gsize length = 0;
+    std::unique_ptr<gchar, void (*)(gpointer)> data(g_key_file_to_data(desktopFile, &length, nullptr), g_free);
+
+    if (data == nullptr)
+        return false;
+
+    const auto stdPath = path.toStdString();
+
+    // keep the permissions of the existing file, but make sure it's executable (see makeExecutable())
+    mode_t mode = 0644;
+    {
+        struct stat fileStat{};
+
+        if (stat(stdPath.c_str(), &fileStat) == 0)
+            mode = fileStat.st_mode & 07777;
+
+        if ((mode & 0111) == 0)
+            mode |= 0111;
+    }
+
+    // the temporary file must be in the same directory, as rename() doesn't work across file systems
+    auto tempPath = stdPath + ".XXXXXX";
+
+    const auto fd = mkostemp(&tempPath[0], O_CLOEXEC);
+
+    if (fd < 0) {
+        const auto error = errno;
+        std::cerr << "Failed to create temporary file for " << stdPath << ": " << strerror(error) << std::endl;
+        return false;
+    }
+
+    bool success = fchmod(fd, mode) == 0;
+
+    for (gsize written = 0; success && written < length;) {
+        const auto rv = write(fd, data.get() + written, length - written);
+
+        if (rv < 0) {
+            if (errno == EINTR)
+                continue;
+
+            success = false;
+        } else {
+            written += rv;
+        }
+    }
+
+    if (success && !DesktopIntegrationBatch::deferSync(path))
+        success = fsync(fd) == 0;
+
+    success = close(fd) == 0 && success;
+
+    if (success)
+        success = rename(tempPath.c_str(), stdPath.c_str()) == 0;
+
+    if (!success) {
+        const auto error = errno;
+        std::cerr << "Failed to write " << stdPath << ": " << strerror(error) << std::endl;
+        unlink(tempPath.c_str());
+    } else {
+        DesktopIntegrationBatch::markTreesChanged(desktopIntegrationTreesOf({path}));
+    }
+
+    return success;
+}
+
+bool installDesktopFileAndIcons(AppImageHandle& appImage, bool resolveCollisions) {
+    const auto& pathToAppImage = appImage.path();
+
     if (appimage_register_in_system(pathToAppImage.toStdString().c_str(), false) != 0) {
         displayError(QObject::tr("Failed to register AppImage in system via libappimage"));
         return false;
@@ -635,6 +1086,9 @@ bool installDesktopFileAndIcons(const QString& pathToAppImage, bool resolveColli
         return false;
     }
 
+    // existing files are overwritten in place, which the cache tools don't necessarily notice, so they have to be run
+    DesktopIntegrationBatch::markTreesChanged(desktopIntegrationTreesOfRegistration(desktopFilePath));
+
     /* write AppImageLauncher specific entries to desktop file
      *
      * unfortunately, QSettings doesn't work as a desktop file reader/writer, and libqtxdg isn't really meant to be
@@ -671,7 +1125,7 @@ bool installDesktopFileAndIcons(const QString& pathToAppImage, bool resolveColli
         auto collisions = findCollisions(nameEntry);
 
         // make sure to remove own entry
-        collisions.erase(collisions.find(desktopFilePath));
+        collisions.erase(desktopFilePath);
 
         if (!collisions.empty()) {
             // collisions are resolved like in the filesystem: a monotonically increasing number in brackets is
@@ -723,65 +1177,11 @@ bool installDesktopFileAndIcons(const QString& pathToAppImage, bool resolveColli
 
     std::vector<std::string> desktopActions = {"Remove"};
 
-    // load translations from JSON file(s)
-    QMap<QString, QString> removeActionNameTranslations;
-
+    // translations for the desktop actions' names
+    const auto& actionNameTranslations = desktopActionNameTranslations();
+    const auto& removeActionNameTranslations = actionNameTranslations.remove;
 #ifdef ENABLE_UPDATE_HELPER
-    QMap<QString, QString> updateActionNameTranslations;
-
-    {
-        QDirIterator i18nDirIterator(TranslationManager::getTranslationDir());
-
-        while(i18nDirIterator.hasNext()) {
-            const auto& filePath = i18nDirIterator.next();
-            const auto& fileName = QFileInfo(filePath).fileName();
-
-            if (!QFileInfo(filePath).isFile() || !(fileName.startsWith("desktopfiles.") && fileName.endsWith(".json")))
-                continue;
-
-            // check whether filename's format is alright, otherwise parsing the locale might try to access a
-            // non-existing (or the wrong) member
-            auto splitFilename = fileName.split(".");
-
-            if (splitFilename.size() != 3)
-                continue;
-
-            // parse locale from filename
-            auto locale = splitFilename[1];
-
-            QFile jsonFile(filePath);
-
-            if (!jsonFile.open(QIODevice::ReadOnly)) {
-                displayWarning(QMessageBox::tr("Could not parse desktop file translations:\nCould not open file for reading:\n\n%1").arg(fileName));
-            }
-
-            // TODO: need to make sure that this doesn't try to read huge files at once
-            auto data = jsonFile.readAll();
-
-            QJsonParseError parseError{};
-            auto jsonDoc = QJsonDocument::fromJson(data, &parseError);
-
-            // show warning on syntax errors and continue
-            if (parseError.error != QJsonParseError::NoError || jsonDoc.isNull() || !jsonDoc.isObject()) {
-                displayWarning(QMessageBox::tr("Could not parse desktop file translations:\nInvalid syntax:\n\n%1").arg(parseError.errorString()));
-            }
-
-            auto jsonObj = jsonDoc.object();
-
-            for (const auto& key : jsonObj.keys()) {
-                auto value = jsonObj[key].toString();
-                auto splitKey = key.split("/");
-
-                if (key.startsWith("Desktop Action update")) {
-                    qDebug() << "update: adding" << value << "for locale" << locale;
-                    updateActionNameTranslations[locale] = value;
-                } else if (key.startsWith("Desktop Action remove")) {
-                    qDebug() << "remove: adding" << value << "for locale" << locale;
-                    removeActionNameTranslations[locale] = value;
-                }
-            }
-        }
-    }
+    const auto& updateActionNameTranslations = actionNameTranslations.update;
 #endif
 
 #ifndef BUILD_LITE
@@ -819,13 +1219,28 @@ bool installDesktopFileAndIcons(const QString& pathToAppImage, bool resolveColli
         }
     }
 
+    // see AppImageMetadata::hasUpdateInformation
+    int hasUpdateInformation = -1;
+
 #ifdef ENABLE_UPDATE_HELPER
     // add Update action
     {
-        appimage::update::Updater updater(pathToAppImage.toStdString());
+        // constructing an Updater just to read the update information is rather expensive, therefore the result is
+        // memoized in the metadata index, and reused as long as the AppImage doesn't change
+        {
+            AppImageMetadata metadata;
+
+            if (AppImageMetadataIndex::instance()->lookup(pathToAppImage, metadata))
+                hasUpdateInformation = metadata.hasUpdateInformation;
+        }
+
+        if (hasUpdateInformation < 0) {
+            appimage::update::Updater updater(pathToAppImage.toStdString());
+            hasUpdateInformation = updater.updateInformation().empty() ? 0 : 1;
+        }
 
         // but only if there's update information
-        if (!updater.updateInformation().empty()) {
+        if (hasUpdateInformation > 0) {
             // section needs to be announced in desktop actions list
             desktopActions.emplace_back("Update");
 
@@ -869,22 +1284,46 @@ bool installDesktopFileAndIcons(const QString& pathToAppImage, bool resolveColli
     g_key_file_set_string(desktopFile.get(), G_KEY_FILE_DESKTOP_GROUP, "X-AppImageLauncher-Version", version.c_str());
 
     // save desktop file to disk
-    if (!g_key_file_save_to_file(desktopFile.get(), desktopFilePath, error.get())) {
-        handleError();
+    // TODO: handle making the file executable in libappimage
+    if (!writeDesktopFile(desktopFilePath, desktopFile.get())) {
+        displayError(QObject::tr("Failed to save desktop file"));
         return false;
     }
 
-    // make desktop file executable ("trustworthy" to some DEs)
-    // TODO: handle this in libappimage
-    makeExecutable(desktopFilePath);
+    // the Name entry might have been changed to resolve collisions
+    DesktopFileNameIndex::instance()->update(desktopFilePath);
+
+    // notify KDE/Plasma about icon change (once per batch, if there is one)
+    DesktopIntegrationBatch::notifyIconsChanged();
 
-    // notify KDE/Plasma about icon change
+    // remember the registration in the metadata index, so that the AppImage doesn't have to be inspected again as
+    // long as it doesn't change
     {
-        auto message = QDBusMessage::createSignal(QStringLiteral("/KIconLoader"), QStringLiteral("org.kde.KIconLoader"), QStringLiteral("iconChanged"));
-        message.setArguments({0});
-        QDBusConnection::sessionBus().send(message);
+        const auto index = AppImageMetadataIndex::instance();
+
+        AppImageMetadata metadata;
+
+        // if the existing entry is outdated, we must not reuse any of its values
+        if (!index->lookup(pathToAppImage, metadata)) {
+            metadata = AppImageMetadata{};
+            metadata.path = pathToAppImage;
+            metadata.type = appImage.type();
+        }
+
+        metadata.registered = true;
+        metadata.desktopFilePath = desktopFilePath;
+
+        if (hasUpdateInformation >= 0)
+            metadata.hasUpdateInformation = hasUpdateInformation;
+
+        index->update(metadata);
     }
 
+    // record which files belong to this AppImage, so they can be removed without searching for them later on
+    // within a batch, this is done once for all the AppImages when the batch ends
+    if (!RegistrationManifest::recordRegistration(pathToAppImage, desktopFilePath))
+        std::cerr << "Warning: failed to update registration manifest" << std::endl;
+
     return true;
 }
 
@@ -947,7 +1386,21 @@ IntegrationState integrateAppImage(const QString& pathToAppImage, const QString&
             if (messageBox->clickedButton() == messageBox->button(QMessageBox::Cancel))
                 return INTEGRATION_FAILED;
 
-            if (!QFile(pathToAppImage).copy(pathToIntegratedAppImage)) {
+            // copying large AppImages across file systems can take a while
+            QProgressDialog progressDialog(QObject::tr("Copying AppImage to target location..."), QString(), 0, 100);
+            progressDialog.setWindowModality(Qt::ApplicationModal);
+            progressDialog.setMinimumDuration(500);
+
+            auto updateProgress = [&progressDialog](qint64 bytesCopied, qint64 bytesTotal) {
+                progressDialog.setValue(bytesTotal > 0 ? static_cast<int>(bytesCopied * 100 / bytesTotal) : 100);
+                QApplication::processEvents();
+            };
+
+            const auto copied = copyAppImage(pathToAppImage, pathToIntegratedAppImage, updateProgress);
+
+            progressDialog.reset();
+
+            if (!copied) {
                 displayError("Failed to copy AppImage to target location");
                 return INTEGRATION_FAILED;
             }
@@ -960,69 +1413,128 @@ IntegrationState integrateAppImage(const QString& pathToAppImage, const QString&
     return INTEGRATION_SUCCESSFUL;
 }
 
-QString getAppImageDigestMd5(const QString& path) {
-    // try to read embedded MD5 digest
+// reads the digest embedded in the .digest_md5 section of a type 2 AppImage
+// returns false if the file can't be read, if no digest has been embedded, digest contains null bytes only
+static bool readEmbeddedDigestMd5(const QString& path, QByteArray& digest) {
     unsigned long offset = 0, length = 0;
 
-    // first of all, digest calculation is supported only for type 2
-    if (appimage_get_type(path.toStdString().c_str(), false) != 2)
-        return "";
-
     auto rv = appimage_get_elf_section_offset_and_length(path.toStdString().c_str(), ".digest_md5", &offset, &length);
 
-    QByteArray buffer(16, '\0');
+    digest = QByteArray(16, '\0');
 
     if (rv && offset != 0 && length != 0) {
         // open file and read digest from ELF header section
         QFile file(path);
 
         if (!file.open(QFile::ReadOnly))
-            return "";
+            return false;
 
         if (!file.seek(static_cast<qint64>(offset)))
-            return "";
+            return false;
 
-        if (!file.read(buffer.data(), buffer.size()))
-            return "";
+        if (!file.read(digest.data(), digest.size()))
+            return false;
 
         file.close();
     }
 
-    bool needToCalculateDigest;
+    return true;
+}
 
-    // there seem to be some AppImages out there who actually have the required section embedded, but it's empty
-    // therefore we make the assumption that a hash value of zeroes is probably incorrect and recalculate
-    // in the extremely rare case in which the AppImage's digest would *really* be that value, we'd waste a bit of
-    // computation time, but the chances are so low... who cares, right?
-    {
-        auto nonZeroCharacterFound = false;
+// there seem to be some AppImages out there who actually have the required section embedded, but it's empty
+// therefore we make the assumption that a hash value of zeroes is probably incorrect and recalculate
+// in the extremely rare case in which the AppImage's digest would *really* be that value, we'd waste a bit of
+// computation time, but the chances are so low... who cares, right?
+static bool isNullDigest(const QByteArray& digest) {
+    for (const char i : digest) {
+        if (i != '\0')
+            return false;
+    }
 
-        for (const char i : buffer) {
-            if (i != '\0') {
-                nonZeroCharacterFound = true;
-                break;
-            }
-        }
+    return true;
+}
+
+static QString hexlifyDigest(const QByteArray& digest) {
+    // create hexadecimal representation
+    auto hexDigest = appimage_hexlify(digest, static_cast<size_t>(digest.size()));
+
+    QString hexDigestStr(hexDigest);
+
+    free(hexDigest);
+
+    return hexDigestStr;
+}
+
+QString getAppImageDigestMd5(const QString& path) {
+    // calculating the digest requires reading the entire file, so we try really hard to avoid that
+    {
+        QString cachedDigest;
 
-        needToCalculateDigest = !nonZeroCharacterFound;
+        if (AppImageDigestCache::lookup(path, cachedDigest))
+            return cachedDigest;
     }
 
-    if (needToCalculateDigest) {
+    // first of all, digest calculation is supported only for type 2
+    if (appimage_get_type(path.toStdString().c_str(), false) != 2)
+        return "";
+
+    // try to read embedded MD5 digest
+    QByteArray buffer;
+
+    if (!readEmbeddedDigestMd5(path, buffer))
+        return "";
+
+    if (isNullDigest(buffer)) {
+        MetricsTimer timer("digest.compute");
+
         // calculate digest
-        if (!appimage_type2_digest_md5(path.toStdString().c_str(), buffer.data()))
+        if (!calculateAppImageDigestMd5(path, buffer))
             return "";
     }
 
-    // create hexadecimal representation
-    auto hexDigest = appimage_hexlify(buffer, static_cast<size_t>(buffer.size()));
-
-    QString hexDigestStr(hexDigest);
+    const auto hexDigestStr = hexlifyDigest(buffer);
 
-    free(hexDigest);
+    AppImageDigestCache::store(path, hexDigestStr);
 
     return hexDigestStr;
 }
 
+bool copyAppImage(const QString& pathToAppImage, const QString& destination, const FastCopyProgressCallback& progress) {
+    QString digest;
+
+    // the digest is calculated while copying only if it's neither cached nor embedded in the file
+    auto needToCalculateDigest = false;
+
+    if (!AppImageDigestCache::lookup(pathToAppImage, digest) &&
+        appimage_get_type(pathToAppImage.toStdString().c_str(), false) == 2) {
+        QByteArray embeddedDigest;
+
+        if (readEmbeddedDigestMd5(pathToAppImage, embeddedDigest)) {
+            if (isNullDigest(embeddedDigest)) {
+                needToCalculateDigest = true;
+            } else {
+                digest = hexlifyDigest(embeddedDigest);
+            }
+        }
+    }
+
+    QByteArray calculatedDigest;
+
+    if (!fastCopyFile(pathToAppImage, destination, progress, needToCalculateDigest ? &calculatedDigest : nullptr))
+        return false;
+
+    if (!calculatedDigest.isEmpty()) {
+        digest = hexlifyDigest(calculatedDigest);
+        AppImageDigestCache::store(pathToAppImage, digest);
+    }
+
+    // the copy is a new file, which the cache doesn't know yet
+    if (!digest.isEmpty())
+        AppImageDigestCache::store(destination, digest);
+
+    return true;
+}
+
 bool hasAlreadyBeenIntegrated(const QString& pathToAppImage) {
     return appimage_is_registered_in_system(pathToAppImage.toStdString().c_str());
 }
@@ -1031,7 +1543,49 @@ bool isInDirectory(const QString& pathToAppImage, const QDir& directory) {
     return directory == QFileInfo(pathToAppImage).absoluteDir();
 }
 
+// removes the given desktop file and all other files libappimage has installed alongside
+static void removeDesktopIntegrationFiles(const QString& desktopFilePath, const QStringList& otherFilePaths, bool verbose) {
+    if (verbose)
+        std::cout << "Removing desktop file: " << desktopFilePath.toStdString() << std::endl;
+
+    QFile::remove(desktopFilePath);
+
+    for (const auto& path : otherFilePaths) {
+        if (verbose)
+            std::cout << "Removing file: " << path.toStdString() << std::endl;
+
+        QFile::remove(path);
+    }
+
+    DesktopIntegrationBatch::markTreesChanged(desktopIntegrationTreesOf(QStringList{desktopFilePath} + otherFilePaths));
+}
+
 bool cleanUpOldDesktopIntegrationResources(bool verbose) {
+    MetricsTimer timer("cleanup");
+
+    // first, we handle all AppImages whose registration has been recorded in the manifest
+    // this requires neither parsing the desktop files nor searching for related files
+    QSet<QString> knownDesktopFiles;
+    QStringList staleAppImages;
+
+    for (const auto& entry : RegistrationManifest::entries()) {
+        if (QFile::exists(entry.appImagePath)) {
+            knownDesktopFiles.insert(entry.desktopFilePath);
+            continue;
+        }
+
+        if (verbose)
+            std::cout << "AppImage no longer exists, cleaning up resources: " << entry.appImagePath.toStdString() << std::endl;
+
+        removeDesktopIntegrationFiles(entry.desktopFilePath, entry.otherFilePaths, verbose);
+        staleAppImages << entry.appImagePath;
+    }
+
+    if (!RegistrationManifest::remove(staleAppImages))
+        std::cerr << "Warning: failed to update registration manifest" << std::endl;
+
+    // desktop files which are not in the manifest have been created by other tools or older versions of
+    // AppImageLauncher, so we have to inspect them
     auto dirPath = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/applications";
 
     auto directory = QDir(dirPath);
@@ -1041,9 +1595,22 @@ bool cleanUpOldDesktopIntegrationResources(bool verbose) {
 
     directory.setNameFilters(filters);
 
-    for (auto desktopFilePath : directory.entryList()) {
-        desktopFilePath = dirPath + "/" + desktopFilePath;
+    QStringList unknownDesktopFiles;
+
+    for (const auto& fileName : directory.entryList()) {
+        const auto desktopFilePath = dirPath + "/" + fileName;
+
+        if (!knownDesktopFiles.contains(desktopFilePath))
+            unknownDesktopFiles << desktopFilePath;
+    }
+
+    // the icons directories are searched once for all the desktop files
+    const auto relatedFilesByDesktopFile = RegistrationManifest::findFilesRelatedToDesktopFiles(unknownDesktopFiles);
 
+    // the registrations are recorded all at once after the loop
+    QList<RegistrationManifest::Entry> entriesToRecord;
+
+    for (const auto& desktopFilePath : unknownDesktopFiles) {
         std::shared_ptr<GKeyFile> desktopFile(g_key_file_new(), [](GKeyFile* p) {
             g_key_file_free(p);
         });
@@ -1078,6 +1645,8 @@ bool cleanUpOldDesktopIntegrationResources(bool verbose) {
             appImagePath = QString(execValue.get()).split(" ").first();
         }
 
+        const auto relatedFiles = relatedFilesByDesktopFile.value(desktopFilePath);
+
         // now, check whether AppImage exists
         // FIXME: the split command for the Exec value might not work if there's a space in the filename
         // we really need a parser that understands the desktop file escaping
@@ -1085,30 +1654,21 @@ bool cleanUpOldDesktopIntegrationResources(bool verbose) {
             if (verbose)
                 std::cout << "AppImage no longer exists, cleaning up resources: " << appImagePath.toStdString() << std::endl;
 
-            if (verbose)
-                std::cout << "Removing desktop file: " << desktopFilePath.toStdString() << std::endl;
-
-            QFile(desktopFilePath).remove();
-
-            // TODO: clean up related resources such as icons or MIME definitions
-
-            auto* iconValue = g_key_file_get_string(desktopFile.get(), G_KEY_FILE_DESKTOP_GROUP, G_KEY_FILE_DESKTOP_KEY_ICON, nullptr);
-
-            if (iconValue != nullptr) {
-                const auto dataLocation = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
-                const auto iconsPath = QString::fromStdString(dataLocation.toStdString() + "/share/icons/");
-
-                for (QDirIterator it(iconsPath, QDirIterator::Subdirectories); it.hasNext();) {
-                    auto path = it.next();
+            removeDesktopIntegrationFiles(desktopFilePath, relatedFiles, verbose);
+        } else {
+            // record the registration, so we don't have to inspect this desktop file ever again
+            RegistrationManifest::Entry entry;
+            entry.appImagePath = appImagePath;
+            entry.desktopFilePath = desktopFilePath;
+            entry.otherFilePaths = relatedFiles;
 
-                    if (QFileInfo(path).completeBaseName().startsWith(iconValue)) {
-                        QFile::remove(path);
-                    }
-                }
-            }
+            entriesToRecord << entry;
         }
     }
 
+    if (!RegistrationManifest::record(entriesToRecord))
+        std::cerr << "Warning: failed to update registration manifest" << std::endl;
+
     return true;
 }
 
@@ -1122,6 +1682,28 @@ time_t getMTime(const QString& path) {
     return st.st_mtim.tv_sec;
 }
 
+bool desktopFileIsUpToDate(const QString& desktopFilePath) {
+    // the daemon restarts itself when its binary changes, and the other tools are short-lived, so it is safe to
+    // look up the binary's modification time only once
+    static const auto ownBinaryMTime = []() -> time_t {
+        struct stat st{};
+        if (stat(getOwnBinaryPath().get(), &st) != 0)
+            return -1;
+        return st.st_mtim.tv_sec;
+    }();
+
+    if (ownBinaryMTime < 0 || desktopFilePath.isEmpty())
+        return false;
+
+    struct stat st{};
+
+    // a missing desktop file is not an error here, it just needs to be (re-)created
+    if (stat(desktopFilePath.toStdString().c_str(), &st) != 0)
+        return false;
+
+    return st.st_mtim.tv_sec > ownBinaryMTime;
+}
+
 bool desktopFileHasBeenUpdatedSinceLastUpdate(const QString& pathToAppImage) {
     const auto ownBinaryPath = getOwnBinaryPath();
 
@@ -1138,8 +1720,40 @@ bool desktopFileHasBeenUpdatedSinceLastUpdate(const QString& pathToAppImage) {
 }
 
 bool isAppImage(const QString& path) {
-    const auto type = appimage_get_type(path.toUtf8(), false);
-    return type > 0 && type <= 2;
+    // the handle checks the magic bytes before involving libappimage
+    return AppImageHandle(path).isAppImage();
+}
+
+bool isIncompleteDownload(const QString& path) {
+    static const char* const suffixes[] = {".part", ".crdownload", ".download", ".partial"};
+
+    for (const auto* suffix : suffixes) {
+        if (path.endsWith(suffix, Qt::CaseInsensitive))
+            return true;
+    }
+
+    return false;
+}
+
+bool requestTrashBinCleanUpFromDaemon() {
+    auto bus = QDBusConnection::sessionBus();
+
+    if (!bus.isConnected() || bus.interface() == nullptr)
+        return false;
+
+    if (!bus.interface()->isServiceRegistered(APPIMAGELAUNCHERD_DBUS_SERVICE))
+        return false;
+
+    auto message = QDBusMessage::createMethodCall(
+        APPIMAGELAUNCHERD_DBUS_SERVICE, APPIMAGELAUNCHERD_DBUS_PATH, APPIMAGELAUNCHERD_DBUS_INTERFACE, "ReclaimTrash"
+    );
+
+    message.setAutoStartService(false);
+
+    // the call returns right away, the daemon removes the files at its own pace
+    // the tools calling this usually exit right after, so the call mustn't just be queued
+    const auto reply = bus.call(message, QDBus::Block, 2000);
+    return reply.type() == QDBusMessage::ReplyMessage;
 }
 
 QString which(const std::string& name) {
@@ -1274,11 +1888,42 @@ QString pathToPrivateDataDirectory() {
 }
 
 bool unregisterAppImage(const QString& pathToAppImage) {
+    // the files have to be looked at before libappimage removes them
+    int changedTrees = ALL_DESKTOP_INTEGRATION_TREES;
+    {
+        std::unique_ptr<char, void (*)(void*)> desktopFilePath(
+            appimage_registered_desktop_file_path(pathToAppImage.toStdString().c_str(), nullptr, false), free
+        );
+
+        if (desktopFilePath != nullptr)
+            changedTrees = desktopIntegrationTreesOfRegistration(desktopFilePath.get());
+    }
+
     auto rv = appimage_unregister_in_system(pathToAppImage.toStdString().c_str(), false);
 
     if (rv != 0)
         return false;
 
+    DesktopIntegrationBatch::markTreesChanged(changedTrees);
+
+    // the AppImage itself has not changed, so the rest of the entry remains valid
+    {
+        const auto index = AppImageMetadataIndex::instance();
+
+        AppImageMetadata metadata;
+
+        if (index->lookup(pathToAppImage, metadata)) {
+            metadata.registered = false;
+            metadata.desktopFilePath.clear();
+            index->update(metadata);
+        } else {
+            index->remove(pathToAppImage);
+        }
+    }
+
+    // libappimage has removed the files already
+    RegistrationManifest::remove({pathToAppImage});
+
     return true;
 }
 
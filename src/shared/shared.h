@@ -3,6 +3,7 @@
 #pragma once
 
 // system headers
+#include <map>
 #include <string>
 #include <memory>
 
@@ -10,8 +11,11 @@
 #include <QDir>
 #include <QString>
 #include <QSettings>
+#include <QVariantMap>
 
 // local headers
+#include "appimagehandle.h"
+#include "fastcopy.h"
 #include "types.h"
 
 enum IntegrationState {
@@ -24,6 +28,11 @@ enum IntegrationState {
 // currently hardcoded, can not be changed by users
 static const auto DEFAULT_INTEGRATION_DESTINATION = QString(getenv("HOME")) + "/Applications/";
 
+// names under which appimagelauncherd is reachable on the session bus
+#define APPIMAGELAUNCHERD_DBUS_SERVICE "org.appimagelauncher.Daemon"
+#define APPIMAGELAUNCHERD_DBUS_PATH "/org/appimagelauncher/Daemon"
+#define APPIMAGELAUNCHERD_DBUS_INTERFACE "org.appimagelauncher.Daemon"
+
 // little convenience method to display warnings
 void displayWarning(const QString& message);
 
@@ -48,15 +57,28 @@ QString privateLibDirPath(const QString& srcSubdirName);
 // set resolveCollisions to false in order to leave the Name entries as-is
 bool installDesktopFileAndIcons(const QString& pathToAppImage, bool resolveCollisions = true);
 
+// same as above, but reuses the information about the AppImage which has been extracted via the handle before
+bool installDesktopFileAndIcons(AppImageHandle& appImage, bool resolveCollisions = true);
+
 // update AppImage's existing desktop file with AppImageLauncher specific entries
 // this alias for installDesktopFileAndIcons does not perform any collision detection and resolving
 bool updateDesktopFileAndIcons(const QString& pathToAppImage);
 
+// parts of the user's data directory modified by the desktop integration
+enum DesktopIntegrationTree {
+    APPLICATIONS_TREE = 1 << 0,
+    ICONS_TREE = 1 << 1,
+    MIME_TREE = 1 << 2,
+    ALL_DESKTOP_INTEGRATION_TREES = APPLICATIONS_TREE | ICONS_TREE | MIME_TREE,
+};
+
 // update desktop database and icon caches of desktop environments
 // this makes sure that:
 //   - outdated entries are removed from the launcher
 //   - icons of freshly integrated AppImages are displayed in the launcher
-bool updateDesktopDatabaseAndIconCaches();
+// only the caches for the given trees are updated, which allows callers to skip the tools if nothing has changed (see
+// DesktopIntegrationBatch::changedTrees())
+bool updateDesktopDatabaseAndIconCaches(int trees = ALL_DESKTOP_INTEGRATION_TREES);
 
 // integrates an AppImage using a standard workflow used across all AppImageLauncher applications
 IntegrationState integrateAppImage(const QString& pathToAppImage, const QString& pathToIntegratedAppImage);
@@ -71,26 +93,70 @@ void createConfigFile(int askToMove, const QString& destination, int enableDaemo
 // replaces ~ character in paths with real home directory, if necessary and possible
 QString expandTilde(QString path);
 
+// immutable copy of the values in the config file
+// unlike QSettings, it can be shared between threads safely, and never writes back to the file
+class ConfigSnapshot {
+public:
+    ConfigSnapshot() = default;
+    explicit ConfigSnapshot(QVariantMap values);
+
+    // reads all values from the given settings
+    static std::shared_ptr<const ConfigSnapshot> fromSettings(const QSettings& settings);
+
+public:
+    bool contains(const QString& key) const;
+    QVariant value(const QString& key, const QVariant& defaultValue = QVariant()) const;
+
+private:
+    QVariantMap values;
+};
+
 // load config file and return it
-std::shared_ptr<QSettings> getConfig();
+// the config is read once and cached for the entire process, the snapshot is replaced as soon as the file changes
+// values are returned as they are stored in the file, callers have to expand ~ in paths themselves
+std::shared_ptr<const ConfigSnapshot> getConfig();
+
+// read the config file without caching it
+// meant for short-lived processes which need the config only once, as opposed to getConfig(), no inotify watch is set up
+std::shared_ptr<const ConfigSnapshot> readConfigFile();
+
+// counter which is incremented whenever the config snapshot is replaced, useful to cache values derived from it
+quint64 configGeneration();
+
+// force the config file to be read again on the next access
+void invalidateConfig();
 
 // return directory into which the integrated AppImages will be moved
 QDir integratedAppImagesDestination();
+QDir integratedAppImagesDestination(const std::shared_ptr<const ConfigSnapshot>& config);
 
 // additional directories to monitor for AppImages, and to permit AppImages to be within (i.e., shall not ask whether
 // to move to the main location, if they're in one of these, it's all good)
 QSet<QString> additionalAppImagesLocations(bool includeValidMountPoints = false);
 
+// whether the daemon shall watch the Applications directories on all mounted filesystems
+bool shallMonitorMountedFilesystems(const std::shared_ptr<const ConfigSnapshot>& config);
+
+// additional directories to watch the user has configured in the config file
+QDirSet getAdditionalDirectoriesFromConfig(const std::shared_ptr<const ConfigSnapshot>& config);
+
 // calculate list of directories the daemon has to watch
 // AppImages inside there should furthermore not be moved out of there and into the main integration directory
-QDirSet daemonDirectoriesToWatch(const std::shared_ptr<QSettings>& config = nullptr);
+QDirSet daemonDirectoriesToWatch(const std::shared_ptr<const ConfigSnapshot>& config = nullptr);
 
 // build path to standard location for integrated AppImages
 QString buildPathToIntegratedAppImage(const QString& pathToAppImage);
 
+// copies an AppImage (e.g., when it can't be moved across file systems) using fastCopyFile()
+// the digest of the copy is stored in the digest cache right away, if it has to be calculated, this happens while
+// copying, so the file is read only once
+bool copyAppImage(const QString& pathToAppImage, const QString& destination,
+                  const FastCopyProgressCallback& progress = nullptr);
+
 // get AppImage MD5 digest
 // extracts the digest embedded in the file
 // if no such digest has been embedded, it calculates it using libappimage
+// results are cached (see AppImageDigestCache), so repeated calls for unchanged files are cheap
 QString getAppImageDigestMd5(const QString& path);
 
 // checks whether AppImage has been integrated already
@@ -108,9 +174,17 @@ std::shared_ptr<char> getOwnBinaryPath();
 // returns true if AppImageLauncher was updated since the desktop file for a given AppImage has been updated last
 bool desktopFileHasBeenUpdatedSinceLastUpdate(const QString& pathToAppImage);
 
+// returns true if the given desktop file exists and has been updated since AppImageLauncher was updated last
+// unlike desktopFileHasBeenUpdatedSinceLastUpdate, this does not require libappimage to look up the desktop file
+bool desktopFileIsUpToDate(const QString& desktopFilePath);
+
 // checks whether a file is an AppImage
 bool isAppImage(const QString& path);
 
+// checks whether the filename is one used by browsers and download managers for downloads in progress
+// those files are renamed once the download is complete, so they don't need to be inspected
+bool isIncompleteDownload(const QString& path);
+
 // when a file doesn't belong to the current user, this method shows a dialog asking whether to relaunch as that user
 // this can be used when e.g., updating AppImages owned by root or other users
 // uses pkexec, gksudo, gksu etc., whatever is available
@@ -131,3 +205,7 @@ QIcon loadIconWithFallback(const QString& iconName);
 
 // sets up paths to fallback icons bundled with AppImageLauncher
 void setUpFallbackIconPaths(QWidget*);
+
+// asks appimagelauncherd to clean up the trash bin in the background
+// returns false if the daemon isn't running, in which case the caller has to clean up the trash bin by itself
+bool requestTrashBinCleanUpFromDaemon();
@@ -0,0 +1,159 @@
+// library headers
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// local headers
+#include "shared.h"
+
+class ConfigTest : public QObject {
+    Q_OBJECT
+
+private:
+    QTemporaryDir tempDir;
+
+    static QString configFilePath() {
+        return QStandardPaths::writableLocation(QStandardPaths::ConfigLocation) + "/appimagelauncher.cfg";
+    }
+
+    // most editors replace the file rather than modifying it
+    static bool replaceConfigFile(const QByteArray& contents) {
+        QSaveFile file(configFilePath());
+        return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size() && file.commit();
+    }
+
+    static bool modifyConfigFile(const QByteArray& contents) {
+        QFile file(configFilePath());
+        return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(contents) == contents.size();
+    }
+
+    static QByteArray readConfigFile() {
+        QFile file(configFilePath());
+
+        if (!file.open(QIODevice::ReadOnly))
+            return {};
+
+        return file.readAll();
+    }
+
+private slots:
+    void initTestCase() {
+        QVERIFY(tempDir.isValid());
+
+        // the config location is looked up again on every access, so the cache follows the change
+        qputenv("XDG_CONFIG_HOME", tempDir.path().toUtf8());
+        QCOMPARE(QFileInfo(configFilePath()).absolutePath(), QFileInfo(tempDir.path()).absoluteFilePath());
+    }
+
+    void init() {
+        QFile::remove(configFilePath());
+        invalidateConfig();
+    }
+
+    void testMissingFile() {
+        QVERIFY(getConfig() == nullptr);
+        QCOMPARE(integratedAppImagesDestination().absolutePath(), QDir(DEFAULT_INTEGRATION_DESTINATION).absolutePath());
+    }
+
+    void testSnapshotIsCached() {
+        QVERIFY(replaceConfigFile("[AppImageLauncher]\nask_to_move = false\n"));
+
+        const auto config = getConfig();
+        const auto generation = configGeneration();
+
+        QVERIFY(config != nullptr);
+        QVERIFY(config->contains("AppImageLauncher/ask_to_move"));
+        QCOMPARE(config->value("AppImageLauncher/ask_to_move").toBool(), false);
+        QCOMPARE(config->value("AppImageLauncher/enable_daemon", "true").toBool(), true);
+
+        // as long as the file doesn't change, neither does the snapshot
+        QCOMPARE(getConfig(), config);
+        QCOMPARE(configGeneration(), generation);
+    }
+
+    void testReplacedFileInvalidatesSnapshot() {
+        QVERIFY(replaceConfigFile("[AppImageLauncher]\nask_to_move = false\n"));
+
+        const auto config = getConfig();
+        const auto generation = configGeneration();
+        QVERIFY(config != nullptr);
+
+        QVERIFY(replaceConfigFile("[AppImageLauncher]\nask_to_move = true\n"));
+
+        const auto newConfig = getConfig();
+        QVERIFY(newConfig != config);
+        QVERIFY(configGeneration() > generation);
+        QCOMPARE(newConfig->value("AppImageLauncher/ask_to_move").toBool(), true);
+
+        // snapshots handed out before are immutable
+        QCOMPARE(config->value("AppImageLauncher/ask_to_move").toBool(), false);
+    }
+
+    void testModifiedFileInvalidatesSnapshot() {
+        QVERIFY(modifyConfigFile("[appimagelauncherd]\nwatch_subdirectories_depth = 1\n"));
+        QCOMPARE(getConfig()->value("appimagelauncherd/watch_subdirectories_depth").toInt(), 1);
+
+        QVERIFY(modifyConfigFile("[appimagelauncherd]\nwatch_subdirectories_depth = 2\n"));
+        QCOMPARE(getConfig()->value("appimagelauncherd/watch_subdirectories_depth").toInt(), 2);
+    }
+
+    void testRemovedFileInvalidatesSnapshot() {
+        QVERIFY(replaceConfigFile("[AppImageLauncher]\nask_to_move = false\n"));
+        QVERIFY(getConfig() != nullptr);
+
+        QVERIFY(QFile::remove(configFilePath()));
+        QVERIFY(getConfig() == nullptr);
+    }
+
+    void testUnrelatedFilesDontInvalidateSnapshot() {
+        QVERIFY(replaceConfigFile("[AppImageLauncher]\nask_to_move = false\n"));
+
+        const auto config = getConfig();
+        const auto generation = configGeneration();
+
+        QFile otherFile(tempDir.filePath("other.cfg"));
+        QVERIFY(otherFile.open(QIODevice::WriteOnly));
+        otherFile.write("something");
+        otherFile.close();
+
+        QCOMPARE(getConfig(), config);
+        QCOMPARE(configGeneration(), generation);
+    }
+
+    void testInvalidateConfig() {
+        QVERIFY(replaceConfigFile("[AppImageLauncher]\nask_to_move = false\n"));
+
+        const auto config = getConfig();
+        const auto generation = configGeneration();
+
+        invalidateConfig();
+
+        QVERIFY(getConfig() != config);
+        QCOMPARE(configGeneration(), generation + 1);
+    }
+
+    void testTildeIsExpandedOnRead() {
+        const QByteArray contents("[AppImageLauncher]\ndestination = ~/Applications-test\n");
+        QVERIFY(replaceConfigFile(contents));
+
+        const auto config = getConfig();
+        const auto generation = configGeneration();
+
+        // the snapshot contains the value as it's stored in the file
+        QCOMPARE(config->value("AppImageLauncher/destination").toString(), QString("~/Applications-test"));
+        QCOMPARE(integratedAppImagesDestination().absolutePath(), QDir::homePath() + "/Applications-test");
+
+        // reading the config must never write to the file, which would trigger the watch
+        QCOMPARE(readConfigFile(), contents);
+        QCOMPARE(getConfig(), config);
+        QCOMPARE(configGeneration(), generation);
+    }
+};
+
+QTEST_GUILESS_MAIN(ConfigTest)
+
+#include "test_config.moc"
@@ -0,0 +1,113 @@
+// system headers
+#include <algorithm>
+extern "C" {
+    #include <appimage/appimage.h>
+}
+
+// library headers
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// local headers
+#include "digest.h"
+
+// must match the values in digest.cpp
+static constexpr qint64 CHUNK_SIZE = 4096;
+static constexpr qint64 READ_BLOCK_SIZE = 4 * 1024 * 1024;
+
+class DigestTest : public QObject {
+    Q_OBJECT
+
+private:
+    QTemporaryDir tempDir;
+
+    // libappimage calculates the digest of any ELF file, so the test binary serves as the runtime
+    // the file is extended with some data, so it ends at the given offset from a chunk boundary
+    QString createElfFile(qint64 minimumSize, qint64 remainder) {
+        QFile binary(QCoreApplication::applicationFilePath());
+
+        if (!binary.open(QIODevice::ReadOnly))
+            return {};
+
+        auto data = binary.readAll();
+
+        auto size = std::max(minimumSize, static_cast<qint64>(data.size()));
+        size = (size + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE + remainder;
+
+        // the padding must not be mistaken for actual null bytes at the end of the file
+        for (int i = 0; data.size() < size; ++i) {
+            data.append(static_cast<char>('a' + i % 26));
+        }
+
+        const auto path = tempDir.filePath(QString("elf-%1-%2").arg(minimumSize).arg(remainder));
+
+        QFile file(path);
+
+        if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+            return {};
+
+        return path;
+    }
+
+    static QByteArray libappimageDigest(const QString& path) {
+        char digest[16];
+
+        if (!appimage_type2_digest_md5(path.toStdString().c_str(), digest))
+            return {};
+
+        return QByteArray(digest, sizeof(digest));
+    }
+
+private slots:
+    void initTestCase() {
+        QVERIFY(tempDir.isValid());
+    }
+
+    void testMatchesLibappimage_data() {
+        QTest::addColumn<qint64>("minimumSize");
+        QTest::addColumn<qint64>("remainder");
+
+        // sizes which aren't multiples of the chunk size require the last chunk to be padded
+        QTest::newRow("one byte into the last chunk") << qint64(0) << qint64(1);
+        QTest::newRow("half a chunk") << qint64(0) << CHUNK_SIZE / 2;
+        QTest::newRow("one byte short of a chunk") << qint64(0) << CHUNK_SIZE - 1;
+        QTest::newRow("across read blocks") << READ_BLOCK_SIZE + 1 << qint64(17);
+    }
+
+    void testMatchesLibappimage() {
+        QFETCH(qint64, minimumSize);
+        QFETCH(qint64, remainder);
+
+        const auto path = createElfFile(minimumSize, remainder);
+        QVERIFY(!path.isEmpty());
+        QCOMPARE(QFileInfo(path).size() % CHUNK_SIZE, remainder);
+
+        const auto expected = libappimageDigest(path);
+        QCOMPARE(expected.size(), 16);
+
+        QByteArray digest;
+        QVERIFY(calculateAppImageDigestMd5(path, digest));
+        QCOMPARE(digest.toHex(), expected.toHex());
+
+        // the incremental variant receives the data in arbitrary portions
+        AppImageDigestMd5Calculator calculator(path);
+        QVERIFY(calculator.isValid());
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+
+        while (!file.atEnd()) {
+            auto data = file.read(1000);
+            calculator.addData(data.data(), data.size());
+        }
+
+        QCOMPARE(calculator.result().toHex(), expected.toHex());
+    }
+};
+
+QTEST_GUILESS_MAIN(DigestTest)
+
+#include "test_digest.moc"
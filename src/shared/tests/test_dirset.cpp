@@ -0,0 +1,126 @@
+// system headers
+#include <algorithm>
+#include <iterator>
+
+// library headers
+#include <QDir>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// local headers
+#include "types.h"
+
+class DirSetTest : public QObject {
+    Q_OBJECT
+
+private:
+    QTemporaryDir tempDir;
+
+    static QStringList paths(const QDirSet& dirs) {
+        QStringList rv;
+
+        for (const auto& dir : dirs) {
+            rv << QDirSet::keyFor(dir);
+        }
+
+        return rv;
+    }
+
+private slots:
+    void initTestCase() {
+        QVERIFY(tempDir.isValid());
+        QVERIFY(QDir(tempDir.path()).mkpath("a"));
+        QVERIFY(QDir(tempDir.path()).mkpath("b"));
+        QVERIFY(QFile::link(tempDir.filePath("a"), tempDir.filePath("link-to-a")));
+    }
+
+    void testInsertDeduplicatesEquivalentPaths() {
+        QDirSet dirs;
+
+        QVERIFY(dirs.insert(QDir(tempDir.filePath("a"))).second);
+
+        // trailing slashes, redundant components and symlinks resolve to the same directory
+        QVERIFY(!dirs.insert(QDir(tempDir.filePath("a/"))).second);
+        QVERIFY(!dirs.insert(QDir(tempDir.filePath("b/../a"))).second);
+        QVERIFY(!dirs.insert(QDir(tempDir.filePath("link-to-a"))).second);
+
+        QCOMPARE(dirs.size(), size_t(1));
+        QVERIFY(dirs.contains(QDir(tempDir.filePath("link-to-a"))));
+    }
+
+    void testNonExistingDirectories() {
+        QDirSet dirs;
+
+        // directories which don't exist (yet) are keyed by their cleaned paths
+        QVERIFY(dirs.insert(QDir(tempDir.filePath("missing"))).second);
+        QVERIFY(!dirs.insert(QDir(tempDir.filePath("a/../missing/"))).second);
+
+        QVERIFY(dirs.contains(QDir(tempDir.filePath("missing"))));
+        QVERIFY(dirs.containsKey(QDirSet::keyFor(QDir(tempDir.filePath("missing")))));
+        QVERIFY(!dirs.contains(QDir(tempDir.filePath("a"))));
+    }
+
+    void testIterationIsSorted() {
+        const QDirSet dirs{QDir(tempDir.filePath("b")), QDir(tempDir.filePath("missing")), QDir(tempDir.filePath("a"))};
+
+        auto expected = paths(dirs);
+        expected.sort();
+
+        QCOMPARE(paths(dirs), expected);
+        QCOMPARE(dirs.size(), size_t(3));
+    }
+
+    void testFindAndErase() {
+        QDirSet dirs{QDir(tempDir.filePath("a")), QDir(tempDir.filePath("b"))};
+
+        QVERIFY(dirs.find(QDir(tempDir.filePath("missing"))) == dirs.end());
+
+        const auto it = dirs.find(QDir(tempDir.filePath("link-to-a")));
+        QVERIFY(it != dirs.end());
+
+        dirs.erase(it);
+
+        QCOMPARE(dirs.size(), size_t(1));
+        QVERIFY(!dirs.contains(QDir(tempDir.filePath("a"))));
+        QVERIFY(dirs.contains(QDir(tempDir.filePath("b"))));
+    }
+
+    void testRemoveIf() {
+        QDirSet dirs{QDir(tempDir.filePath("a")), QDir(tempDir.filePath("b")), QDir(tempDir.filePath("missing"))};
+
+        dirs.removeIf([](const QDir& dir) {
+            return !dir.exists();
+        });
+
+        QCOMPARE(dirs, (QDirSet{QDir(tempDir.filePath("a")), QDir(tempDir.filePath("b"))}));
+
+        // the keys must have been kept in sync with the directories
+        QVERIFY(dirs.contains(QDir(tempDir.filePath("b"))));
+        QVERIFY(!dirs.contains(QDir(tempDir.filePath("missing"))));
+    }
+
+    void testDifference() {
+        const QDirSet dirs{QDir(tempDir.filePath("a")), QDir(tempDir.filePath("b")), QDir(tempDir.filePath("missing"))};
+        const QDirSet other{QDir(tempDir.filePath("link-to-a")), QDir(tempDir.filePath("other"))};
+
+        const auto difference = dirs.difference(other);
+
+        QCOMPARE(difference, (QDirSet{QDir(tempDir.filePath("b")), QDir(tempDir.filePath("missing"))}));
+        QVERIFY(dirs.difference(dirs).empty());
+        QCOMPARE(QDirSet{}.difference(dirs), QDirSet{});
+    }
+
+    void testInserter() {
+        const QDirSet source{QDir(tempDir.filePath("a")), QDir(tempDir.filePath("b"))};
+
+        QDirSet dirs{QDir(tempDir.filePath("link-to-a"))};
+        std::copy(source.begin(), source.end(), std::inserter(dirs, dirs.end()));
+
+        QCOMPARE(dirs, source);
+    }
+};
+
+QTEST_GUILESS_MAIN(DirSetTest)
+
+#include "test_dirset.moc"
@@ -0,0 +1,231 @@
+// library headers
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// local headers
+#include "desktopintegrationbatch.h"
+#include "registrationmanifest.h"
+
+// libappimage's naming scheme, see RegistrationManifest::findFilesRelatedToDesktopFile()
+static const QString PREFIX_A = "appimagekit_0123456789abcdef0123456789abcdef";
+static const QString PREFIX_B = "appimagekit_fedcba9876543210fedcba9876543210";
+
+class RegistrationManifestTest : public QObject {
+    Q_OBJECT
+
+private:
+    QTemporaryDir tempDir;
+
+    static QString dataLocation() {
+        return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    }
+
+    static QString desktopFilePath(const QString& prefix) {
+        return dataLocation() + "/applications/" + prefix + "-test.desktop";
+    }
+
+    static bool createFile(const QString& path) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly);
+    }
+
+    static RegistrationManifest::Entry makeEntry(const QString& appImagePath, const QString& prefix,
+                                                 const QStringList& otherFilePaths = {}) {
+        RegistrationManifest::Entry entry;
+        entry.appImagePath = appImagePath;
+        entry.desktopFilePath = desktopFilePath(prefix);
+        entry.otherFilePaths = otherFilePaths;
+        return entry;
+    }
+
+    static QMap<QString, RegistrationManifest::Entry> entriesByAppImage() {
+        QMap<QString, RegistrationManifest::Entry> rv;
+
+        for (const auto& entry : RegistrationManifest::entries()) {
+            rv.insert(entry.appImagePath, entry);
+        }
+
+        return rv;
+    }
+
+    // bypasses the buffer, unlike entries()
+    static QStringList appImagesInManifestFile() {
+        QFile file(RegistrationManifest::manifestFilePath());
+
+        if (!file.open(QIODevice::ReadOnly))
+            return {};
+
+        return QJsonDocument::fromJson(file.readAll()).object()["registrations"].toObject().keys();
+    }
+
+private slots:
+    void initTestCase() {
+        QVERIFY(tempDir.isValid());
+        qputenv("XDG_DATA_HOME", tempDir.path().toUtf8());
+        QVERIFY(RegistrationManifest::manifestFilePath().startsWith(tempDir.path()));
+    }
+
+    void init() {
+        QFile::remove(RegistrationManifest::manifestFilePath());
+        QDir(dataLocation() + "/icons").removeRecursively();
+        QDir(dataLocation() + "/mime").removeRecursively();
+    }
+
+    void testRecordInsertsAndReplaces() {
+        QVERIFY(RegistrationManifest::entries().isEmpty());
+
+        QVERIFY(RegistrationManifest::record(makeEntry("/a.AppImage", PREFIX_A, {"/icon-a"})));
+        QVERIFY(RegistrationManifest::record(makeEntry("/b.AppImage", PREFIX_B)));
+
+        auto entries = entriesByAppImage();
+        QCOMPARE(entries.size(), 2);
+        QCOMPARE(entries["/a.AppImage"].desktopFilePath, desktopFilePath(PREFIX_A));
+        QCOMPARE(entries["/a.AppImage"].otherFilePaths, QStringList{"/icon-a"});
+
+        // an AppImage has a single entry at most
+        QVERIFY(RegistrationManifest::record(makeEntry("/a.AppImage", PREFIX_A, {"/new-icon-a"})));
+
+        entries = entriesByAppImage();
+        QCOMPARE(entries.size(), 2);
+        QCOMPARE(entries["/a.AppImage"].otherFilePaths, QStringList{"/new-icon-a"});
+        QCOMPARE(entries["/b.AppImage"].desktopFilePath, desktopFilePath(PREFIX_B));
+    }
+
+    void testRecordMultipleMergesWithFile() {
+        QVERIFY(RegistrationManifest::record(makeEntry("/a.AppImage", PREFIX_A, {"/icon-a"})));
+
+        const QList<RegistrationManifest::Entry> newEntries{
+            makeEntry("/a.AppImage", PREFIX_A, {"/new-icon-a"}),
+            makeEntry("/b.AppImage", PREFIX_B),
+        };
+        QVERIFY(RegistrationManifest::record(newEntries));
+
+        const auto entries = entriesByAppImage();
+        QCOMPARE(entries.keys(), (QStringList{"/a.AppImage", "/b.AppImage"}));
+        QCOMPARE(entries["/a.AppImage"].otherFilePaths, QStringList{"/new-icon-a"});
+
+        QVERIFY(RegistrationManifest::record(QList<RegistrationManifest::Entry>{}));
+        QCOMPARE(entriesByAppImage().size(), 2);
+    }
+
+    void testRemove() {
+        QVERIFY(RegistrationManifest::record(makeEntry("/a.AppImage", PREFIX_A)));
+        QVERIFY(RegistrationManifest::record(makeEntry("/b.AppImage", PREFIX_B)));
+
+        QVERIFY(RegistrationManifest::remove({"/a.AppImage", "/unknown.AppImage"}));
+        QCOMPARE(entriesByAppImage().keys(), QStringList{"/b.AppImage"});
+
+        QVERIFY(RegistrationManifest::remove({}));
+        QVERIFY(RegistrationManifest::remove({"/unknown.AppImage"}));
+        QCOMPARE(entriesByAppImage().keys(), QStringList{"/b.AppImage"});
+    }
+
+    void testCorruptManifestIsDiscarded() {
+        QVERIFY(createFile(RegistrationManifest::manifestFilePath()));
+
+        QFile file(RegistrationManifest::manifestFilePath());
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write("{ not json");
+        file.close();
+
+        QVERIFY(RegistrationManifest::entries().isEmpty());
+
+        QVERIFY(RegistrationManifest::record(makeEntry("/a.AppImage", PREFIX_A)));
+        QCOMPARE(entriesByAppImage().keys(), QStringList{"/a.AppImage"});
+    }
+
+    void testFindRelatedFiles() {
+        const auto iconA = dataLocation() + "/icons/hicolor/48x48/apps/" + PREFIX_A + "_test.png";
+        const auto scalableIconA = dataLocation() + "/icons/hicolor/scalable/apps/" + PREFIX_A + "_test.svg";
+        const auto mimeA = dataLocation() + "/mime/packages/" + PREFIX_A + "-test.xml";
+        const auto iconB = dataLocation() + "/icons/hicolor/48x48/apps/" + PREFIX_B + "_test.png";
+        const auto unrelatedIcon = dataLocation() + "/icons/hicolor/48x48/apps/test.png";
+
+        for (const auto& path : {iconA, scalableIconA, mimeA, iconB, unrelatedIcon}) {
+            QVERIFY(createFile(path));
+        }
+
+        const auto otherDesktopFile = dataLocation() + "/applications/test.desktop";
+
+        const auto related = RegistrationManifest::findFilesRelatedToDesktopFiles(
+            {desktopFilePath(PREFIX_A), desktopFilePath(PREFIX_B), otherDesktopFile}
+        );
+
+        auto relatedToA = related.value(desktopFilePath(PREFIX_A));
+        relatedToA.sort();
+        auto expectedA = QStringList{iconA, scalableIconA, mimeA};
+        expectedA.sort();
+
+        QCOMPARE(relatedToA, expectedA);
+        QCOMPARE(related.value(desktopFilePath(PREFIX_B)), QStringList{iconB});
+        QVERIFY(!related.contains(otherDesktopFile));
+
+        // the single desktop file variant must yield the same results
+        auto singleA = RegistrationManifest::findFilesRelatedToDesktopFile(desktopFilePath(PREFIX_A));
+        singleA.sort();
+        QCOMPARE(singleA, expectedA);
+    }
+
+    void testRegistrationsAreBufferedWithinBatch() {
+        const auto iconA = dataLocation() + "/icons/hicolor/48x48/apps/" + PREFIX_A + "_test.png";
+        QVERIFY(createFile(iconA));
+
+        {
+            DesktopIntegrationBatch batch;
+
+            QVERIFY(RegistrationManifest::recordRegistration("/a.AppImage", desktopFilePath(PREFIX_A)));
+            QVERIFY(RegistrationManifest::recordRegistration("/b.AppImage", desktopFilePath(PREFIX_B)));
+
+            // nested batches don't flush the buffer
+            {
+                DesktopIntegrationBatch nestedBatch;
+                QVERIFY(nestedBatch.commit());
+            }
+
+            QVERIFY(appImagesInManifestFile().isEmpty());
+
+            QVERIFY(batch.commit());
+        }
+
+        QCOMPARE(appImagesInManifestFile(), (QStringList{"/a.AppImage", "/b.AppImage"}));
+
+        const auto entries = entriesByAppImage();
+        QCOMPARE(entries["/a.AppImage"].otherFilePaths, QStringList{iconA});
+        QVERIFY(entries["/b.AppImage"].otherFilePaths.isEmpty());
+    }
+
+    void testRegistrationsAreWrittenRightAwayWithoutBatch() {
+        QVERIFY(!DesktopIntegrationBatch::isActive());
+
+        QVERIFY(RegistrationManifest::recordRegistration("/a.AppImage", desktopFilePath(PREFIX_A)));
+        QCOMPARE(appImagesInManifestFile(), QStringList{"/a.AppImage"});
+    }
+
+    void testBufferedRegistrationsAreVisible() {
+        DesktopIntegrationBatch batch;
+
+        QVERIFY(RegistrationManifest::recordRegistration("/a.AppImage", desktopFilePath(PREFIX_A)));
+        QVERIFY(RegistrationManifest::recordRegistration("/b.AppImage", desktopFilePath(PREFIX_B)));
+
+        // removing a buffered registration must prevent it from being written later on
+        QVERIFY(RegistrationManifest::remove({"/b.AppImage"}));
+
+        QCOMPARE(entriesByAppImage().keys(), QStringList{"/a.AppImage"});
+
+        QVERIFY(batch.commit());
+        QCOMPARE(appImagesInManifestFile(), QStringList{"/a.AppImage"});
+    }
+};
+
+QTEST_GUILESS_MAIN(RegistrationManifestTest)
+
+#include "test_registrationmanifest.moc"
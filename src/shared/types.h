@@ -1,16 +1,171 @@
 #pragma once
 
 // system headers
-#include <set>
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
+#include <vector>
 
 // library headers
 #include <QDir>
+#include <QString>
 
-struct QDirComparator {
+/**
+ * Set of directories, keyed by their canonical paths.
+ *
+ * The keys are calculated once when a directory is inserted, so that comparisons are cheap string comparisons.
+ * Directories which don't exist (yet) cannot be canonicalized, their cleaned absolute paths are used instead.
+ *
+ * The entries are kept in a sorted vector. This allows for calculating differences between sets in linear time, and
+ * iterating over the directories in a stable order.
+ */
+class QDirSet {
 public:
-    size_t operator()(const QDir& a, const QDir& b) const {
-        return a.absolutePath() < b.absolutePath();
+    typedef QDir value_type;
+    typedef std::vector<QDir>::const_iterator const_iterator;
+    typedef const_iterator iterator;
+
+private:
+    // kept in sync: keys[i] is the key of dirs[i]
+    std::vector<QString> keys;
+    std::vector<QDir> dirs;
+
+public:
+    static QString keyFor(const QDir& dir) {
+        auto key = dir.canonicalPath();
+
+        if (key.isEmpty())
+            key = QDir::cleanPath(dir.absolutePath());
+
+        return key;
     }
-};
 
-typedef std::set<QDir, QDirComparator> QDirSet;
+public:
+    QDirSet() = default;
+
+    QDirSet(std::initializer_list<QDir> dirs) {
+        for (const auto& dir : dirs) {
+            insert(dir);
+        }
+    }
+
+private:
+    std::vector<QString>::const_iterator lowerBound(const QString& key) const {
+        return std::lower_bound(keys.begin(), keys.end(), key);
+    }
+
+    const_iterator iteratorAt(std::vector<QString>::const_iterator keyIt) const {
+        return dirs.begin() + std::distance(keys.begin(), keyIt);
+    }
+
+public:
+    // returns the position of the directory, and whether it has been inserted (i.e., wasn't contained before)
+    std::pair<iterator, bool> insert(const QDir& dir) {
+        const auto key = keyFor(dir);
+        const auto keyIt = lowerBound(key);
+        const auto index = std::distance(keys.cbegin(), keyIt);
+
+        if (keyIt != keys.end() && *keyIt == key)
+            return std::make_pair(dirs.cbegin() + index, false);
+
+        keys.insert(keys.begin() + index, key);
+        dirs.insert(dirs.begin() + index, dir);
+
+        return std::make_pair(dirs.cbegin() + index, true);
+    }
+
+    // for compatibility with std::inserter, the hint is ignored
+    iterator insert(const_iterator, const QDir& dir) {
+        return insert(dir).first;
+    }
+
+    iterator find(const QDir& dir) const {
+        const auto key = keyFor(dir);
+        const auto keyIt = lowerBound(key);
+
+        if (keyIt == keys.end() || *keyIt != key)
+            return end();
+
+        return iteratorAt(keyIt);
+    }
+
+    bool contains(const QDir& dir) const {
+        return find(dir) != end();
+    }
+
+    // looks up a key previously calculated with keyFor()
+    bool containsKey(const QString& key) const {
+        return std::binary_search(keys.begin(), keys.end(), key);
+    }
+
+    iterator erase(const_iterator it) {
+        const auto index = std::distance(dirs.cbegin(), it);
+
+        keys.erase(keys.begin() + index);
+        return dirs.erase(dirs.begin() + index);
+    }
+
+    // removes all directories for which the predicate returns true
+    template<typename Predicate>
+    void removeIf(Predicate predicate) {
+        std::vector<QString> remainingKeys;
+        std::vector<QDir> remainingDirs;
+
+        for (size_t i = 0; i < dirs.size(); ++i) {
+            if (!predicate(dirs[i])) {
+                remainingKeys.push_back(keys[i]);
+                remainingDirs.push_back(dirs[i]);
+            }
+        }
+
+        keys.swap(remainingKeys);
+        dirs.swap(remainingDirs);
+    }
+
+    // directories contained in this set, but not in the other one, calculated in linear time
+    QDirSet difference(const QDirSet& other) const {
+        QDirSet rv;
+
+        size_t i = 0, j = 0;
+
+        while (i < keys.size()) {
+            if (j >= other.keys.size() || keys[i] < other.keys[j]) {
+                // the result is built in order, so we can simply append
+                rv.keys.push_back(keys[i]);
+                rv.dirs.push_back(dirs[i]);
+                ++i;
+            } else if (other.keys[j] < keys[i]) {
+                ++j;
+            } else {
+                ++i;
+                ++j;
+            }
+        }
+
+        return rv;
+    }
+
+    const_iterator begin() const {
+        return dirs.begin();
+    }
+
+    const_iterator end() const {
+        return dirs.end();
+    }
+
+    bool empty() const {
+        return dirs.empty();
+    }
+
+    size_t size() const {
+        return dirs.size();
+    }
+
+    bool operator==(const QDirSet& other) const {
+        return keys == other.keys;
+    }
+
+    bool operator!=(const QDirSet& other) const {
+        return !(*this == other);
+    }
+};
@@ -1,12 +1,12 @@
 // system includes
 #include <iostream>
+#include <vector>
 #include <sys/stat.h>
 
 // library includes
 #include <QDateTime>
 #include <QDir>
-#include <QDirIterator>
-#include <appimage/appimage.h>
+#include <QFileInfo>
 
 // local includes
 #include "trashbin.h"
@@ -16,25 +16,96 @@ class TrashBin::PrivateData {
     public:
         const QDir dir;
 
+        RetentionPolicy policy;
+
     public:
         PrivateData() : dir(integratedAppImagesDestination().path() + "/.trash") {
             // make sure trash directory exists
             QDir(integratedAppImagesDestination().path()).mkdir(".trash");
+
+            const auto config = getConfig();
+
+            if (config != nullptr) {
+                bool ok = false;
+
+                const auto maxAgeDays = config->value("appimagelauncherd/trash_max_age_days").toLongLong(&ok);
+                if (ok)
+                    policy.maxAge = maxAgeDays < 0 ? -1 : maxAgeDays * 24 * 60 * 60;
+
+                const auto maxSizeMiB = config->value("appimagelauncherd/trash_max_size_mib").toLongLong(&ok);
+                if (ok)
+                    policy.maxTotalSize = maxSizeMiB < 0 ? -1 : maxSizeMiB * 1024 * 1024;
+            }
         }
 
-        bool canBeCleanedUp(const QString& path) {
-            return true;
+        // disposed files are named <timestamp>_<original filename>, see disposeAppImage()
+        // returns an invalid QDateTime for other files
+        static QDateTime disposalTime(const QString& fileName) {
+            const auto separatorIndex = fileName.indexOf('_');
+
+            if (separatorIndex <= 0)
+                return {};
+
+            return QDateTime::fromString(fileName.left(separatorIndex), Qt::ISODate);
+        }
+
+        QStringList expiredFiles() {
+            // the timestamps sort chronologically, so the files are listed oldest first
+            const auto entries = dir.entryInfoList(QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot, QDir::Name);
+
+            struct TrashedFile {
+                QString path;
+                QDateTime disposalTime;
+                qint64 size;
+            };
+
+            std::vector<TrashedFile> files;
+            qint64 totalSize = 0;
+
+            for (const auto& entry : entries) {
+                // files not put there by us are left alone
+                const auto time = disposalTime(entry.fileName());
+
+                if (!time.isValid())
+                    continue;
+
+                files.push_back({entry.absoluteFilePath(), time, entry.size()});
+                totalSize += entry.size();
+            }
+
+            const auto now = QDateTime::currentDateTime();
+
+            QStringList rv;
+
+            for (const auto& file : files) {
+                const auto tooOld = policy.maxAge >= 0 && file.disposalTime.secsTo(now) >= policy.maxAge;
+                const auto tooLarge = policy.maxTotalSize >= 0 && totalSize > policy.maxTotalSize;
+
+                if (!tooOld && !tooLarge)
+                    continue;
+
+                rv << file.path;
+                totalSize -= file.size;
+            }
+
+            return rv;
         }
 };
 
-TrashBin::TrashBin() {
-    d = new PrivateData();
-}
+TrashBin::TrashBin() : d(std::make_shared<PrivateData>()) {}
 
 QString TrashBin::path() {
     return d->dir.path();
 }
 
+const TrashBin::RetentionPolicy& TrashBin::retentionPolicy() {
+    return d->policy;
+}
+
+void TrashBin::setRetentionPolicy(const RetentionPolicy& policy) {
+    d->policy = policy;
+}
+
 bool TrashBin::disposeAppImage(const QString& pathToAppImage) {
     if (!QFile(pathToAppImage).exists()) {
         std::cerr << "No such file or directory: " << pathToAppImage.toStdString() << std::endl;
@@ -59,30 +130,42 @@ bool TrashBin::disposeAppImage(const QString& pathToAppImage) {
     return true;
 }
 
+QStringList TrashBin::expiredFiles() {
+    return d->expiredFiles();
+}
+
 bool TrashBin::cleanUp() {
-    for (QDirIterator iterator(d->dir, QDirIterator::FollowSymlinks); iterator.hasNext();) {
-        auto currentPath = iterator.next();
+    cleanUpIncrementally(-1);
+    return true;
+}
 
-        if (!QFileInfo(currentPath).isFile())
-            continue;
+int TrashBin::cleanUpIncrementally(int maxFiles) {
+    const auto files = expiredFiles();
 
-        if (appimage_get_type(currentPath.toStdString().c_str(), false) <= 0)
-            continue;
+    int removedCount = 0;
+    int failedCount = 0;
 
-        if (!d->canBeCleanedUp(currentPath)) {
-            std::cerr << "Cannot clean up AppImage yet: " << currentPath.toStdString() << std::endl;
-            continue;
-        }
+    for (const auto& currentPath : files) {
+        // files which can't be removed count towards the limit, too, otherwise they'd be retried over and over
+        if (maxFiles >= 0 && removedCount + failedCount >= maxFiles)
+            break;
 
         std::cerr << "Removing AppImage: " << currentPath.toStdString() << std::endl;
 
-        // silently ignore if files can not be removed
-        // they shall be removed on subsequent runs
+        QFile file(currentPath);
+
+        // failures are not fatal, the files shall be removed on subsequent runs
         // if this won't happen and the trash directory will only get bigger at some point, we might need to
         // reconsider this decision
-        if (!QFile(currentPath).remove())
+        if (!file.remove()) {
+            std::cerr << "Failed to remove AppImage: " << file.errorString().toStdString() << std::endl;
+            ++failedCount;
             continue;
+        }
+
+        ++removedCount;
     }
 
-    return true;
+    // the failed ones are retried once the next run is due rather than right away
+    return files.size() - removedCount - failedCount;
 }
@@ -1,25 +1,53 @@
 // system includes
+#include <memory>
+
+// library includes
 #include <QString>
+#include <QStringList>
 
 #pragma once
 
 class TrashBin {
+    public:
+        // decides when files in the trash bin are removed
+        // a file is removed once it's older than the max age, or as long as the trash bin exceeds the max total size
+        // (oldest files first)
+        struct RetentionPolicy {
+            // seconds, 0 removes files right away, < 0 disables the limit
+            qint64 maxAge = 0;
+            // bytes, < 0 disables the limit
+            qint64 maxTotalSize = -1;
+        };
+
     private:
         class PrivateData;
-        PrivateData* d;
+        std::shared_ptr<PrivateData> d;
 
     public:
+        // the retention policy is read from the config file (see appimagelauncherd/trash_max_age_days and
+        // appimagelauncherd/trash_max_size_mib)
         TrashBin();
 
     public:
         QString path();
 
+        const RetentionPolicy& retentionPolicy();
+        void setRetentionPolicy(const RetentionPolicy& policy);
+
     public:
         // move AppImage into trash bin directory
         bool disposeAppImage(const QString& pathToAppImage);
 
-        // check all AppImages in trash bin whether they can be removed
+        // files which shall be removed according to the retention policy, oldest first
+        // only the filenames (which contain the time of disposal) and stat() are used, the files are not opened
+        QStringList expiredFiles();
+
+        // removes all expired files
         // this function should be called regularly to make sure the files in the trash bin are cleaned up as soon
         // as possible
         bool cleanUp();
+
+        // tries to remove up to maxFiles expired files, returns the number of expired files which haven't been tried yet
+        // removing large files may take a while, this allows callers to spread the work over multiple runs
+        int cleanUpIncrementally(int maxFiles);
 };
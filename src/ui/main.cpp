@@ -29,31 +29,16 @@ extern "C" {
 }
 
 // local headers
+#include "appimagehandle.h"
+#include "metadataindex.h"
 #include "shared.h"
 #include "trashbin.h"
 #include "translationmanager.h"
 #include "first-run.h"
 
-// Runs an AppImage. Returns suitable exit code for main application.
-int runAppImage(const QString& pathToAppImage, unsigned long argc, char** argv) {
-    // needs to be converted to std::string to be able to use c_str()
-    // when using QString and then .toStdString().c_str(), the std::string instance will be an rvalue, and the
-    // pointer returned by c_str() will be invalid
-    auto fullPathToAppImage = QFileInfo(pathToAppImage).absoluteFilePath();
-
-    auto type = appimage_get_type(fullPathToAppImage.toStdString().c_str(), false);
-    if (type < 1 || type > 3) {
-        displayError(QObject::tr("AppImageLauncher does not support type %1 AppImages at the moment.").arg(type));
-        return 1;
-    }
-
-    // first of all, chmod +x the AppImage registerFile
-    // be happy the registerFile is executable already
-    if (!makeExecutable(fullPathToAppImage)) {
-        displayError(QObject::tr("Could not make AppImage executable: %1").arg(fullPathToAppImage));
-        return 1;
-    }
-
+// Replaces the current process with the given AppImage, which must be an executable AppImage of a supported type.
+// Returns only if that fails, errors are reported on stderr, so this can be called before Qt has been initialized.
+int execAppImage(const QString& pathToAppImage, unsigned long argc, char** argv) {
     // suppress desktop integration script etc.
     setenv("DESKTOPINTEGRATION", "AppImageLauncher", true);
 
@@ -94,6 +79,29 @@ int runAppImage(const QString& pathToAppImage, unsigned long argc, char** argv)
     return 1;
 }
 
+// Runs an AppImage. Returns suitable exit code for main application.
+int runAppImage(const QString& pathToAppImage, unsigned long argc, char** argv) {
+    // needs to be converted to std::string to be able to use c_str()
+    // when using QString and then .toStdString().c_str(), the std::string instance will be an rvalue, and the
+    // pointer returned by c_str() will be invalid
+    auto fullPathToAppImage = QFileInfo(pathToAppImage).absoluteFilePath();
+
+    auto type = appimage_get_type(fullPathToAppImage.toStdString().c_str(), false);
+    if (type < 1 || type > 3) {
+        displayError(QObject::tr("AppImageLauncher does not support type %1 AppImages at the moment.").arg(type));
+        return 1;
+    }
+
+    // first of all, chmod +x the AppImage registerFile
+    // be happy the registerFile is executable already
+    if (!makeExecutable(fullPathToAppImage)) {
+        displayError(QObject::tr("Could not make AppImage executable: %1").arg(fullPathToAppImage));
+        return 1;
+    }
+
+    return execAppImage(pathToAppImage, argc, argv);
+}
+
 // factory method to build and return a suitable Qt application instance
 // it remembers a previously created instance, and will return it if available
 // otherwise a new one is created and configure
@@ -137,7 +145,89 @@ QCoreApplication* getApp(char** argv) {
     return app;
 }
 
+// checks whether the AppImage passed on the commandline can be run right away, i.e., before setting up Qt, loading
+// translations, cleaning up etc.
+// this is the case for AppImages which have been integrated already, whose desktop files are current and which reside
+// in one of the integration directories, as the regular code path would just run those without any interaction
+// the decision is made from the AppImage's entry in the metadata index, the config file and a few cheap calls to
+// stat(), the AppImage itself is never opened
+// in case of any doubt, the regular code path is taken
+bool canRunAppImageRightAway(int argc, char** argv, QString& pathToAppImage) {
+    if (argc <= 1 || getenv("APPIMAGELAUNCHER_DISABLE") != nullptr)
+        return false;
+
+    // AppImageLauncher's own options are handled by the regular code path
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--appimagelauncher-", strlen("--appimagelauncher-")) == 0)
+            return false;
+    }
+
+    pathToAppImage = QDir(QString(argv[1])).absolutePath();
+
+    const QFileInfo fileInfo(pathToAppImage);
+
+    // runAppImage() would have to display an error if it needed to make the AppImage executable and failed
+    if (fileInfo.isSymLink() || !fileInfo.isExecutable())
+        return false;
+
+    // the entry is valid only as long as the file's stat data matches, which also means its type is still correct
+    // only this entry is needed, so there's no need to load the entire index
+    AppImageMetadata metadata;
+
+    if (!AppImageMetadataIndex::lookupInFile(AppImageMetadataIndex::defaultIndexFilePath(), pathToAppImage, metadata))
+        return false;
+
+    if (!metadata.registered || metadata.type < 1 || metadata.type > 2)
+        return false;
+
+    // in case there was an update of AppImageLauncher, the regular code path updates the desktop file
+    if (!desktopFileIsUpToDate(metadata.desktopFilePath))
+        return false;
+
+    // without a config file, the first run dialog has to be shown
+    // the config is needed only once, so it doesn't need to be cached
+    const auto config = readConfigFile();
+
+    if (config == nullptr)
+        return false;
+
+    // if the daemon has been disabled, the regular code path stops the service
+    // if it's enabled, the service has been enabled already when the AppImage was integrated
+    if (config->contains("AppImageLauncher/enable_daemon") && !config->value("AppImageLauncher/enable_daemon").toBool())
+        return false;
+
+    // AppImages outside the integration directories result in a question whether to move them
+    // the Applications directories on mounted filesystems are left to the regular code path, as looking them up
+    // requires parsing the mount table
+    auto directoriesNotToAskAboutMovingFor = getAdditionalDirectoriesFromConfig(config);
+    directoriesNotToAskAboutMovingFor.insert(integratedAppImagesDestination(config));
+
+    for (const auto& additionalLocation : additionalAppImagesLocations()) {
+        directoriesNotToAskAboutMovingFor.insert(QDir(additionalLocation));
+    }
+
+    for (const auto& dir : directoriesNotToAskAboutMovingFor) {
+        if (isInDirectory(pathToAppImage, dir))
+            return true;
+    }
+
+    return false;
+}
+
 int main(int argc, char** argv) {
+    // most of the time, AppImageLauncher is invoked for AppImages which have been integrated already
+    // those can be run without ever initializing Qt, which saves a lot of time
+    {
+        QString pathToAppImage;
+
+        // the type is known from the index, and the AppImage is executable already, therefore it can be run without
+        // any further checks
+        if (canRunAppImageRightAway(argc, argv, pathToAppImage)) {
+            std::vector<char*> appImageArgv(argv + 1, argv + argc);
+            return execAppImage(pathToAppImage, appImageArgv.size(), appImageArgv.data());
+        }
+    }
+
     // create a suitable application object (either graphical (QApplication) or headless (QCoreApplication))
     // Use a fake argc value to avoid QApplication from modifying the arguments
     QCoreApplication* app = getApp(argv);
@@ -152,7 +242,8 @@ int main(int argc, char** argv) {
     }
 
     // clean up trash directory
-    {
+    // the daemon takes care of this in the background, if it isn't running, it has to be done here
+    if (!requestTrashBinCleanUpFromDaemon()) {
         TrashBin bin;
         if (!bin.cleanUp()) {
             displayError(QObject::tr("Failed to clean up AppImage trash bin: %1").arg(bin.path()));
@@ -225,7 +316,10 @@ int main(int argc, char** argv) {
         return runAppImage(pathToAppImage, appImageArgv.size(), appImageArgv.data());
     }
 
-    const auto type = appimage_get_type(pathToAppImage.toStdString().c_str(), false);
+    // the information needed below is extracted lazily, and at most once
+    AppImageHandle appImage(pathToAppImage);
+
+    const auto type = appImage.type();
 
     if (type <= 0 || type > 2) {
         displayError(QObject::tr("Not an AppImage: %1").arg(pathToAppImage));
@@ -286,7 +380,7 @@ int main(int argc, char** argv) {
     }
 
     // check for X-AppImage-Integrate=false
-    auto shallNotBeIntegrated = appimage_shall_not_be_integrated(pathToAppImage.toStdString().c_str());
+    auto shallNotBeIntegrated = appImage.shallNotBeIntegrated();
     if (shallNotBeIntegrated < 0)
         std::cerr << "AppImageLauncher error: appimage_shall_not_be_integrated() failed (returned " << shallNotBeIntegrated << ")" << std::endl;
     else if (shallNotBeIntegrated > 0)
@@ -297,7 +391,7 @@ int main(int argc, char** argv) {
         return runAppImage(pathToAppImage, appImageArgv.size(), appImageArgv.data());
 
     // ignore terminal apps (fixes #2)
-    auto isTerminalApp = appimage_is_terminal_app(pathToAppImage.toStdString().c_str());
+    auto isTerminalApp = appImage.isTerminalApp();
     if (isTerminalApp < 0)
         std::cerr << "AppImageLauncher error: appimage_is_terminal_app() failed (returned " << isTerminalApp << ")" << std::endl;
     else if (isTerminalApp > 0)
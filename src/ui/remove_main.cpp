@@ -124,7 +124,8 @@ int main(int argc, char** argv) {
     // run clean up cycle for trash bin
     // if the current AppImage is ready to be deleted, this call will immediately remove it from the system
     // otherwise, it'll be cleaned up at some subsequent run of AppImageLauncher or the removal tool
-    if (!bin.cleanUp()) {
+    // removing large AppImages takes a while, so if the daemon is running, it is left to the daemon
+    if (!requestTrashBinCleanUpFromDaemon() && !bin.cleanUp()) {
         QMessageBox::critical(
                 nullptr,
                 QObject::tr("Error"),
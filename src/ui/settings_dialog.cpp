@@ -100,10 +100,10 @@ void SettingsDialog::addDirectoryToWatchToListView(const QString& dirPath) {
 void SettingsDialog::loadSettings() {
     settingsFile = getConfig();
 
-    // make sure settingsFile is populated, even if it's just an empty settings object
+    // make sure settingsFile is populated, even if it's just an empty snapshot
     // this prevents segfaults when querying data from it
     if (settingsFile == nullptr) {
-        settingsFile.reset(new QSettings{});
+        settingsFile = std::make_shared<const ConfigSnapshot>();
     }
 
     const auto daemonIsEnabled = settingsFile->value("AppImageLauncher/enable_daemon", "true").toBool();
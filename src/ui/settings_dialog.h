@@ -6,9 +6,10 @@
 // libraries
 #include <QDialog>
 #include <QListWidgetItem>
-#include <QSettings>
 
 
+class ConfigSnapshot;
+
 namespace Ui {
     class SettingsDialog;
 }
@@ -39,5 +40,5 @@ private:
     void addDirectoryToWatchToListView(const QString& dirPath);
 
     Ui::SettingsDialog* ui;
-    std::shared_ptr<QSettings> settingsFile;
+    std::shared_ptr<const ConfigSnapshot> settingsFile;
 };